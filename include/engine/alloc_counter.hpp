@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+namespace eng {
+
+// Built with ENG_COUNT_ALLOCATIONS, alloc_counter.cpp replaces the global operator new and counts every call, from
+// any thread. The difference of two counts around a frame is how often it went to the heap.
+bool allocation_counting_enabled();
+// always 0 without ENG_COUNT_ALLOCATIONS
+uint64_t heap_allocation_count();
+
+}
\ No newline at end of file
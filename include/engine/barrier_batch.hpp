@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace eng {
+
+// Collects synchronization2 barriers and records all of them with one pipelineBarrier2 on flush(), so the gpu drains
+// once for everything that has to wait at that point instead of once per barrier. Barriers on the same image range
+// with the same layouts, or on the same buffer range, are merged into one with the union of their masks, and every
+// global barrier goes into a single one. A barrier that transitions an image range a pending barrier transitions too
+// has to come after it, so the pending ones are flushed first then.
+class BarrierBatch {
+public:
+    struct Stats {
+        uint32_t flushes{0}; // pipelineBarrier2 calls
+        uint32_t image_barriers{0}, buffer_barriers{0}, memory_barriers{0};
+        uint32_t merged{0}; // added, but went into a barrier that was already pending
+    };
+
+    explicit BarrierBatch(vk::CommandBuffer cmd, std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+    BarrierBatch(const BarrierBatch&) = delete;
+    BarrierBatch& operator=(const BarrierBatch&) = delete;
+
+    void image(const vk::ImageMemoryBarrier2 &barrier);
+    void buffer(const vk::BufferMemoryBarrier2 &barrier);
+    void memory(const vk::MemoryBarrier2 &barrier);
+    // records what's pending, nothing when there isn't anything
+    void flush();
+
+    bool empty() const { return _images.empty() && _buffers.empty() && !_has_memory; }
+    vk::CommandBuffer command_buffer() const { return _cmd; }
+    const Stats& stats() const { return _stats; }
+
+private:
+    vk::CommandBuffer _cmd;
+    std::pmr::vector<vk::ImageMemoryBarrier2> _images;
+    std::pmr::vector<vk::BufferMemoryBarrier2> _buffers;
+    vk::MemoryBarrier2 _memory;
+    bool _has_memory{false};
+    Stats _stats;
+};
+
+}
\ No newline at end of file
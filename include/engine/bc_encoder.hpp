@@ -0,0 +1,27 @@
+#pragma once
+
+#include <engine/texture_format.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace eng {
+
+// CPU block compressor used by the texture_cooker tool.
+// Every encode_* function takes a 4x4 block of RGBA8 texels (row-major, 64 bytes).
+class BCEncoder {
+public:
+    static void encode_bc1(const uint8_t *rgba, uint8_t *out);  // 8 bytes, opaque
+    static void encode_bc3(const uint8_t *rgba, uint8_t *out);  // 16 bytes
+    static void encode_bc5(const uint8_t *rgba, uint8_t *out);  // 16 bytes, red and green channels
+    static void encode_bc7(const uint8_t *rgba, uint8_t *out);  // 16 bytes, mode 6
+
+    // Compresses a whole RGBA8 image. Edge blocks are padded by clamping to the last row/column.
+    static std::vector<std::byte> compress(CookedTextureFormat format, const uint8_t *rgba, uint32_t width, uint32_t height);
+
+private:
+    static void _encode_bc4(const uint8_t *rgba, uint32_t channel, uint8_t *out);
+};
+
+}
@@ -1,8 +1,10 @@
 #pragma once
 
-#include <engine/handle.hpp>
+#include <engine/handle_pool.hpp>
 #include <engine/commandpool.hpp>
 
+#include <functional>
+
 #include <vulkan/vulkan.hpp>
 #include <vma/vma.h>
 
@@ -10,15 +12,15 @@ namespace eng {
 
 class Queue;
 
-struct Buffer : public Handle<Buffer> {
+struct Buffer {
     Buffer() = default;
     Buffer(vk::Buffer buffer, vk::BufferUsageFlags usage, VmaAllocation allocation, std::span<const uint32_t> queue_families) 
-        : Handle(GENERATE_HANDLE), buffer(buffer), usage(usage), allocation(allocation), queue_families(queue_families.begin(), queue_families.end()) { }
+        : buffer(buffer), usage(usage), allocation(allocation), queue_families(queue_families.begin(), queue_families.end()) { }
     
     Buffer(const Buffer&) = delete;
     Buffer& operator=(const Buffer&) = delete;
     
-    Buffer(Buffer &&other) noexcept : Handle(std::move(other)) {
+    Buffer(Buffer &&other) noexcept {
         buffer = other.buffer;
         usage = other.usage;
         allocation = other.allocation;
@@ -31,7 +33,6 @@ struct Buffer : public Handle<Buffer> {
         other.capacity = 0;
     }
     Buffer& operator=(Buffer &&other) noexcept {
-        Handle::operator=(std::move(other));
         buffer = other.buffer;
         usage = other.usage;
         allocation = other.allocation;
@@ -62,6 +63,16 @@ public:
 
     [[nodiscard]] Handle<Buffer> allocate(const vk::BufferCreateInfo &buffer_ci, const VmaAllocationCreateInfo &allocation_ci, std::span<const std::byte> data = {});
     [[nodiscard]] bool insert(Handle<Buffer> dst, size_t offset, std::span<const std::byte> data);
+    // `write` fills `size` bytes of mapped memory (the buffer itself or a staging buffer) that then land at `offset`.
+    [[nodiscard]] bool insert(Handle<Buffer> dst, size_t offset, size_t size, const std::function<void(std::byte*)> &write);
+    // records the copy into `cmd` instead of submitting it and waiting. the staging buffer
+    // is kept until evict() is called with a completed frame number of at least `frame`.
+    [[nodiscard]] bool insert(Handle<Buffer> dst, size_t offset, size_t size, const std::function<void(std::byte*)> &write, vk::CommandBuffer cmd, uint64_t frame);
+    // a buffer of `capacity` bytes with the usage of `handle`, which gets what `handle` holds copied over in `cmd`. `handle`
+    // is freed like a staging buffer, once evict() is called with `frame`. empty when it couldn't be made, `handle` stays then
+    [[nodiscard]] Handle<Buffer> grow(Handle<Buffer> handle, size_t capacity, const VmaAllocationCreateInfo &allocation_ci, vk::CommandBuffer cmd, uint64_t frame);
+    // frees staging buffers of inserts recorded up to `completed_frame`, and the buffers grow() replaced
+    void evict(uint64_t completed_frame);
     [[nodiscard]] bool append(Handle<Buffer> dst, std::span<const std::byte> data);
     [[nodiscard]] bool transfer(Handle<Buffer> src, Handle<Buffer> dst);
     [[nodiscard]] bool transfer_and_free(Handle<Buffer> src, Handle<Buffer> dst);
@@ -71,9 +82,13 @@ public:
     [[nodiscard]] size_t size(Handle<Buffer> handle) const;
     [[nodiscard]] size_t capacity(Handle<Buffer> handle) const;
     [[nodiscard]] void* get_mapped_data(Handle<Buffer> handle) const;
+    // makes host writes to mapped memory visible to the device, nothing to do when the memory is host coherent
+    void flush(Handle<Buffer> handle, size_t offset, size_t size) const;
+    [[nodiscard]] vk::MemoryPropertyFlags memory_properties(Handle<Buffer> handle) const;
 
 private:
     VmaAllocationInfo _vma_allocinfo(Handle<Buffer> handle) const;
+    Handle<Buffer> _allocate_staging(size_t size, const std::function<void(std::byte*)> &write);
 
     vk::Device _device;
     VmaAllocator _allocator{};
@@ -81,7 +96,8 @@ private:
     CommandPool _pool{};
     vk::CommandBuffer _buffer;
 
-    std::unordered_map<Handle<Buffer>, Buffer> _buffers;
+    HandlePool<Buffer> _buffers;
+    std::vector<std::pair<Handle<Buffer>, uint64_t>> _released;
     // std::unordered_map<Handle<Buffer>, Signal<Handle<Buffer>>> _resize_callbacks;
 };
 
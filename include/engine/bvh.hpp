@@ -0,0 +1,118 @@
+#pragma once
+
+#include <engine/frustum.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace eng {
+
+// empty while min > max
+struct Aabb {
+    void grow(const Aabb &other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+    bool empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    // what the surface area heuristic weighs with, half of the surface area
+    float half_area() const {
+        if(empty()) { return 0.0f; }
+        const auto d = max - min;
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+
+    glm::vec3 min{std::numeric_limits<float>::max()}, max{std::numeric_limits<float>::lowest()};
+};
+
+struct Ray {
+    glm::vec3 origin{0.0f}, direction{0.0f, 0.0f, 1.0f};
+    float max_distance{std::numeric_limits<float>::max()}; // in lengths of direction
+};
+
+struct BvhRayHit {
+    uint32_t object{0};
+    float distance{0.0f}; // where the ray enters the object's box, 0 when it starts inside
+};
+
+// Dynamic bounding volume hierarchy over the boxes of objects identified by the caller's ids (instance indices).
+// Every node holds the boxes of up to WIDTH children, each another node or an object, as separate arrays per
+// component so a single simd test covers all of them. build() splits by the surface area heuristic, insert()
+// descends to where the box grows the tree the least. update() only moves an object's box, the nodes above it
+// are fixed up by the next refit().
+class Bvh {
+public:
+    static constexpr uint32_t WIDTH = 4;
+    // frustum queries of trees with at least this many objects split into subtrees below the top levels,
+    // which are queried on all cores
+    static constexpr size_t PARALLEL_OBJECTS = 1 << 14;
+    static constexpr size_t PARALLEL_SUBTREES = 64;
+
+    // replaces everything, object i gets bounds[i]
+    void build(std::span<const Aabb> bounds);
+    void clear();
+    void insert(uint32_t object, const Aabb &bounds);
+    void remove(uint32_t object);
+    void update(uint32_t object, const Aabb &bounds);
+    void refit();
+
+    bool contains(uint32_t object) const { return object < object_nodes.size() && object_nodes[object] != INVALID; }
+    size_t size() const { return object_count; }
+    size_t node_count() const { return nodes.size() - free_nodes.size(); }
+    Aabb bounds() const;
+
+    // append the objects whose boxes are at least partly inside, in no particular order
+    void query(const Frustum &frustum, std::vector<uint32_t> &objects) const;
+    void query(const Aabb &box, std::vector<uint32_t> &objects) const;
+    // the object whose box the ray enters first
+    std::optional<BvhRayHit> raycast(const Ray &ray) const;
+
+private:
+    static constexpr uint32_t INVALID = ~0u;
+    static constexpr uint32_t OBJECT_BIT = 1u << 31; // children with it set are objects, nodes otherwise
+
+    // the first `count` slots are used
+    struct alignas(64) Node {
+        float min_x[WIDTH], min_y[WIDTH], min_z[WIDTH];
+        float max_x[WIDTH], max_y[WIDTH], max_z[WIDTH];
+        uint32_t children[WIDTH];
+        uint32_t parent{INVALID};
+        uint8_t parent_slot{0}, count{0};
+        bool dirty{false}; // a box below changed since the last refit
+    };
+
+    uint32_t build_node(std::span<uint32_t> objects, std::span<const Aabb> bounds, std::span<const glm::vec3> centers);
+    uint32_t allocate_node();
+    void set_slot(uint32_t node, uint32_t slot, const Aabb &box, uint32_t child);
+    Aabb slot_bounds(uint32_t node, uint32_t slot) const;
+    Aabb node_bounds(uint32_t node) const;
+    // recompute the boxes of the parents of `node` up to the root
+    void refit_parents(uint32_t node);
+    void refit_node(uint32_t node);
+    void collect(uint32_t node, std::vector<uint32_t> &objects) const;
+    void query_subtree(uint32_t top, const Frustum &frustum, std::vector<uint32_t> &objects, std::vector<uint32_t> &stack) const;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> free_nodes;
+    uint32_t root{INVALID};
+    // where each object is, INVALID when it isn't in the tree
+    std::vector<uint32_t> object_nodes;
+    std::vector<uint8_t> object_slots;
+    size_t object_count{0};
+    // kept between queries so the per frame ones don't allocate, which means one query at a time.
+    // the parallel frustum query has a stack and an output per subtree, fully inside ones are collected without testing
+    struct Subtree {
+        uint32_t node;
+        bool inside;
+    };
+    mutable std::vector<uint32_t> query_stack;
+    mutable std::vector<Subtree> query_subtrees, query_next_subtrees;
+    mutable std::vector<std::vector<uint32_t>> subtree_stacks, subtree_objects;
+};
+
+}
\ No newline at end of file
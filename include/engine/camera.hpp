@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace eng {
+
+// A perspective camera with reversed depth: the near plane lands at depth 1 and the far plane is at infinity, at 0.
+// Matches the depth attachment, which is cleared to 0 and tested with greater or equal. Right handed, y is up
+// and the camera looks down -z before it's rotated; clip space y points down like Vulkan's.
+struct Camera {
+    glm::mat4 view() const;
+    glm::mat4 projection(float aspect) const;
+    glm::mat4 clip_from_world(float aspect) const { return projection(aspect) * view(); }
+    glm::vec3 forward() const;
+    glm::vec3 right() const;
+    // world space direction of the ray through a point of the image, in -1 to 1 with y down
+    glm::vec3 ray_direction(const glm::vec2 &ndc, float aspect) const;
+    // pixels one world unit covers at a distance of one unit, for an image `height` pixels tall
+    float pixels_per_unit(float height) const;
+    // moved back along forward() until a sphere of `radius` around `center` fits the vertical field of view
+    void frame(const glm::vec3 &center, float radius);
+
+    glm::vec3 position{0.0f, 0.0f, 3.0f};
+    float yaw{0.0f}, pitch{0.0f}; // radians, turning around y and then around x
+    float fov_y{glm::radians(60.0f)};
+    float near_plane{0.05f};
+};
+
+}
\ No newline at end of file
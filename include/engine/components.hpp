@@ -0,0 +1,37 @@
+#pragma once
+
+#include <engine/bvh.hpp>
+#include <engine/scene_graph.hpp>
+
+#include <cstdint>
+
+namespace eng {
+
+// components of everything drawn, an entity per mesh of every added model. see Renderer::renderables.
+// the one with vulkan handles, Material, is in renderer.hpp
+struct Transform {
+    SceneGraph::Node node{SceneGraph::NO_NODE}; // places the mesh in the world
+};
+
+struct MeshRef {
+    uint32_t mesh_idx{0};
+    uint32_t lod{0}; // picked by select_lods, kept between frames for the hysteresis
+};
+
+// world space box of the mesh, moved along by update_transforms
+struct WorldBounds {
+    Aabb box;
+};
+
+// where this frame's culling put the draws of the instance
+struct Visibility {
+    // where cull_meshlets put the draws of the meshlets, drawn whole with drawIndexed when it's NO_MESHLET_DRAWS
+    static constexpr uint32_t NO_MESHLET_DRAWS = ~0u;
+    uint32_t meshlet_draw_slot{NO_MESHLET_DRAWS}, first_meshlet_draw{0};
+    // where cull_occlusion compacted the draws of this instance and the ones after it of the same mesh and pipeline.
+    // those after it have an instance_draw_count of 0 and are drawn along with it, NO_INSTANCE_DRAWS ones with drawIndexed
+    static constexpr uint32_t NO_INSTANCE_DRAWS = ~0u;
+    uint32_t instance_draw_slot{NO_INSTANCE_DRAWS}, first_instance_draw{0}, instance_draw_count{0};
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define ENG_CPU_X86
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#endif
+
+namespace eng {
+
+#ifdef ENG_CPU_X86
+inline bool cpu_has_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if(info[0] < 7) { return false; }
+    __cpuid(info, 1);
+    // the os has to save the ymm registers too
+    if(!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6) { return false; }
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#else
+inline bool cpu_has_avx2() { return false; }
+#endif
+
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+namespace eng {
+
+// Picks the render scale that keeps the gpu time of a frame within a budget. The time of a frame goes roughly with
+// its pixels, so with the square of the scale, and the scale that would just fit is the measured one times the square
+// root of budget over time. It moves only part of the way there every frame: the time that comes in is of a frame
+// recorded frames_in_flight frames ago, jumping straight to the target would overshoot and oscillate.
+class DynamicResolution {
+public:
+    // below the budget by this much, so the noise of single frames doesn't push it over
+    static constexpr float HEADROOM = 0.9f;
+    // of the way to the target per frame
+    static constexpr float RATE = 0.25f;
+    // targets closer than this to the current scale are ignored, the size of the render area doesn't wander then
+    static constexpr float DEADBAND = 0.02f;
+
+    // gpu_ms is the time of a frame rendered at measured_scale. returns the scale to render the next frame at
+    float update(float gpu_ms, float measured_scale, float budget_ms, float min_scale, float max_scale);
+    float scale() const { return _scale; }
+
+private:
+    float _scale{1.0f};
+};
+
+}
\ No newline at end of file
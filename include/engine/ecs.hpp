@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace eng {
+
+struct Entity {
+    static constexpr uint32_t NO_INDEX = ~0u;
+    explicit operator bool() const { return index != NO_INDEX; }
+    bool operator==(const Entity&) const = default;
+
+    uint32_t index{NO_INDEX};
+    uint32_t generation{0}; // bumped whenever the index is reused, so a destroyed entity's copies don't find the new one
+};
+
+using ComponentId = uint32_t;
+inline constexpr ComponentId MAX_COMPONENTS = 64;
+using ComponentMask = std::bitset<MAX_COMPONENTS>;
+
+namespace detail {
+    ComponentId register_component(size_t size);
+    size_t component_size(ComponentId id);
+}
+
+// components are plain data, archetypes move them around with memcpy and never run a destructor
+template<typename T> ComponentId component_id() {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "components have to be plain data");
+    static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "component columns are only aligned as far as operator new does");
+    static const ComponentId id = detail::register_component(sizeof(T));
+    return id;
+}
+
+template<typename... Ts> ComponentMask component_mask() {
+    ComponentMask mask;
+    (mask.set(component_id<Ts>()), ...);
+    return mask;
+}
+
+// All entities with exactly the same components. Every component is an array of its own with a row per entity, so
+// going over a component of all of them reads nothing else. Removing a row moves the last one into its place.
+class Archetype {
+public:
+    explicit Archetype(const ComponentMask &mask);
+
+    const ComponentMask& mask() const { return component_mask; }
+    size_t size() const { return row_entities.size(); }
+    std::span<const Entity> entities() const { return row_entities; }
+    template<typename T> bool has() const { return component_mask.test(component_id<T>()); }
+    // a row per entity, empty when the archetype doesn't have T. good until rows are added or removed
+    template<typename T> std::span<T> column() {
+        const auto c = column_of[component_id<T>()];
+        if(c == NO_COLUMN) { return {}; }
+        return {reinterpret_cast<T*>(columns[c].data()), size()};
+    }
+    template<typename T> std::span<const T> column() const {
+        const auto c = column_of[component_id<T>()];
+        if(c == NO_COLUMN) { return {}; }
+        return {reinterpret_cast<const T*>(columns[c].data()), size()};
+    }
+
+private:
+    friend class EntityRegistry;
+    static constexpr uint8_t NO_COLUMN = 0xFF;
+
+    // the new row's components are zeroed
+    uint32_t append(Entity entity);
+    // returns the entity the last row belonged to, which is now at `row`, or no entity when `row` was the last
+    Entity remove(uint32_t row);
+    std::byte* at(ComponentId id, uint32_t row) { return columns[column_of[id]].data() + row * column_sizes[column_of[id]]; }
+    // row i becomes what was row order[i]
+    void reorder(std::span<const uint32_t> order);
+
+    ComponentMask component_mask;
+    std::vector<Entity> row_entities;
+    std::vector<std::vector<std::byte>> columns; // by component id
+    std::vector<uint32_t> column_sizes;
+    std::array<uint8_t, MAX_COMPONENTS> column_of;
+};
+
+// Entities and their components, kept in an archetype per set of components. Adding or removing a component moves the
+// entity's row to another archetype, which is what makes iterating cheap: a query only visits archetypes that have all
+// of its components and walks their columns front to back.
+class EntityRegistry {
+public:
+    Entity create();
+    // all of its components go with it
+    void destroy(Entity entity);
+    bool alive(Entity entity) const {
+        return entity.index < records.size() && records[entity.index].generation == entity.generation && records[entity.index].archetype != NO_ARCHETYPE;
+    }
+    size_t size() const { return records.size() - free_indices.size(); }
+
+    // overwrites the component when the entity already has one. nullptr when the entity is gone, otherwise good until
+    // the next add or remove
+    template<typename T> T* add(Entity entity, const T &component = {}) {
+        const auto id = component_id<T>();
+        if(!alive(entity)) { return nullptr; }
+        auto &record = records[entity.index];
+        if(!archetype_list[record.archetype]->component_mask.test(id)) {
+            auto mask = archetype_list[record.archetype]->component_mask;
+            move(entity, archetype_index(mask.set(id)));
+        }
+        auto *data = archetype_list[record.archetype]->at(id, record.row);
+        return new(data) T{component};
+    }
+    template<typename T> void remove(Entity entity) {
+        const auto id = component_id<T>();
+        if(!alive(entity)) { return; }
+        auto mask = archetype_list[records[entity.index].archetype]->component_mask;
+        if(!mask.test(id)) { return; }
+        move(entity, archetype_index(mask.reset(id)));
+    }
+    template<typename T> bool has(Entity entity) const {
+        return alive(entity) && archetype_list[records[entity.index].archetype]->component_mask.test(component_id<T>());
+    }
+    // nullptr when the entity is gone or doesn't have one
+    template<typename T> T* get(Entity entity) {
+        if(!has<T>(entity)) { return nullptr; }
+        const auto &record = records[entity.index];
+        return reinterpret_cast<T*>(archetype_list[record.archetype]->at(component_id<T>(), record.row));
+    }
+
+    // the archetype of exactly these components, nullptr when no entity ever had just those
+    template<typename... Ts> Archetype* find() {
+        const auto it = archetype_of.find(component_mask<Ts...>());
+        return it == archetype_of.end() ? nullptr : archetype_list[it->second].get();
+    }
+    // same, made when there's none yet. archetypes stay where they are, so it can be kept around
+    template<typename... Ts> Archetype& archetype() { return *archetype_list[archetype_index(component_mask<Ts...>())]; }
+    // fn(Archetype&) for every archetype with at least these components
+    template<typename... Ts, typename Fn> void each_archetype(Fn &&fn) {
+        const auto mask = component_mask<Ts...>();
+        for(auto &archetype : archetype_list) {
+            if(archetype->size() > 0 && (archetype->component_mask & mask) == mask) { fn(*archetype); }
+        }
+    }
+    // fn(Entity, Ts&...) for every entity with at least these components. fn mustn't create or destroy entities or
+    // add or remove components
+    template<typename... Ts, typename Fn> void each(Fn &&fn) {
+        each_archetype<Ts...>([&fn](Archetype &archetype) {
+            const auto entities = archetype.entities();
+            const std::tuple<Ts*...> columns{archetype.column<Ts>().data()...};
+            for(size_t row=0; row<entities.size(); ++row) {
+                std::apply([&](auto*... column) { fn(entities[row], column[row]...); }, columns);
+            }
+        });
+    }
+    // stable sorts the rows of the archetype, less(a, b) compares rows a and b as they were before the sort
+    template<typename Less> void sort(Archetype &archetype, Less &&less) {
+        std::vector<uint32_t> order(archetype.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), less);
+        reorder(archetype, order);
+    }
+
+private:
+    static constexpr uint32_t NO_ARCHETYPE = ~0u;
+
+    struct Record {
+        uint32_t generation{0};
+        uint32_t archetype{NO_ARCHETYPE}; // NO_ARCHETYPE while the index is free
+        uint32_t row{0};
+    };
+
+    // creates it when there's none with these components yet
+    uint32_t archetype_index(const ComponentMask &mask);
+    // copies the components both archetypes have, the ones only the new one has are zeroed
+    void move(Entity entity, uint32_t archetype);
+    void reorder(Archetype &archetype, std::span<const uint32_t> order);
+
+    std::vector<Record> records; // by entity index
+    std::vector<uint32_t> free_indices;
+    std::vector<std::unique_ptr<Archetype>> archetype_list;
+    std::unordered_map<ComponentMask, uint32_t> archetype_of;
+};
+
+}
\ No newline at end of file
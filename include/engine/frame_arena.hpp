@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace eng {
+
+// Bump allocator for things that live for one frame. Allocating moves a pointer, freeing does nothing, reset() takes
+// everything back at once when the frame's fence has signaled. Running out of room adds a block, the next reset()
+// swaps all of them for one that fits the whole frame, so a frame that doesn't need more than the last one doesn't
+// go to the heap at all.
+class FrameArena {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+
+    explicit FrameArena(size_t capacity = DEFAULT_CAPACITY);
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // never nullptr, alignment has to be a power of two
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    // uninitialized, so only for types without constructors that matter
+    template<typename T> std::span<T> allocate_array(size_t count) {
+        static_assert(std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>, "the arena never runs constructors or destructors");
+        return {static_cast<T*>(allocate(count * sizeof(T), alignof(T))), count};
+    }
+    // everything allocated so far is gone
+    void reset();
+
+    // for std::pmr containers, deallocating through it is a no-op
+    std::pmr::memory_resource* resource() { return &_resource; }
+    // bytes handed out since the last reset, including what alignment skipped
+    size_t used() const { return _used; }
+    size_t capacity() const;
+    // how many times a block came from the heap, which stops going up once the arena is big enough
+    uint64_t block_allocations() const { return _block_allocations; }
+
+private:
+    class Resource final : public std::pmr::memory_resource {
+    public:
+        explicit Resource(FrameArena &arena) : arena(arena) { }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override { return arena.allocate(bytes, alignment); }
+        void do_deallocate(void*, size_t, size_t) override { }
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+        FrameArena &arena;
+    };
+
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size{0};
+    };
+
+    void add_block(size_t size);
+
+    std::vector<Block> _blocks; // allocations go into the last one
+    size_t _offset{0}; // into the last block
+    size_t _used{0};
+    uint64_t _block_allocations{0};
+    Resource _resource{*this};
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace eng {
+
+// Frame timings, and when to sample the input of the next frame so that it is as fresh as it can be. The renderer
+// reports when a frame's input was sampled, when it was submitted, how long the gpu took on it and when it was seen
+// done. From that the pacer predicts when the gpu gets through what is queued, and input_delay() is how long to sleep
+// so recording the next frame finishes right then instead of a frame or two early and waiting in the queue.
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // in milliseconds, smoothed over the last frames
+    struct Stats {
+        float frame{0.0f}; // between the input samples of two frames
+        float cpu{0.0f}; // input sample to submit
+        float gpu{0.0f}; // first to last command, 0 when the device has no timestamps
+        float wait{0.0f}; // the frame limiter and input_delay() together
+        // input sample to seeing the frame presented, or its fence signaled without present wait. an upper bound
+        // when the frame was done before the renderer looked
+        float latency{0.0f};
+    };
+
+    // leaves room for the prediction being off by a bit
+    static constexpr auto MARGIN = std::chrono::microseconds{500};
+    // never sleeps longer than this, whatever the prediction says
+    static constexpr auto MAX_DELAY = std::chrono::milliseconds{50};
+
+    // zero while the gpu is predicted to be done with everything submitted before the cpu is done recording
+    Clock::duration input_delay(Clock::time_point now) const;
+
+    void sampled(uint64_t frame, Clock::time_point at);
+    void submitted(uint64_t frame, Clock::time_point at);
+    void gpu_time(float ms);
+    void waited(Clock::duration duration);
+    // presented, or its fence signaled without present wait
+    void done(uint64_t frame, Clock::time_point at);
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    struct Record {
+        uint64_t frame{~0ull};
+        Clock::time_point sampled;
+    };
+
+    Record* record(uint64_t frame);
+    static void smooth(float &average, float ms);
+
+    std::array<Record, 8> _records{}; // more than any queue depth, indexed with the frame number
+    Stats _stats;
+    Clock::time_point _last_sample{};
+    Clock::time_point _gpu_free{}; // when the gpu is predicted to be done with what was submitted so far
+    uint64_t _last_submitted{~0ull};
+    float _last_gpu{0.0f}, _last_cpu{0.0f};
+};
+
+}
\ No newline at end of file
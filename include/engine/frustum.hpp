@@ -0,0 +1,18 @@
+#pragma once
+
+#include <array>
+
+#include <glm/glm.hpp>
+
+namespace eng {
+
+// left, right, top, bottom, near, far; normalized and pointing inwards
+struct Frustum {
+    // Gribb & Hartmann, for a 0 to 1 depth range. a matrix without depth (z always 0) gives
+    // zero near and far planes, which let everything through
+    static Frustum from_matrix(const glm::mat4 &clip_from_world);
+
+    std::array<glm::vec4, 6> planes{};
+};
+
+}
\ No newline at end of file
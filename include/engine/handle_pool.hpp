@@ -0,0 +1,99 @@
+#pragma once
+
+#include <engine/handle.hpp>
+
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace eng {
+
+// Slot map. The values are kept packed in one array, each slot says where its value is and which generation of it is
+// there. Looking up is two array reads and a compare, erasing moves the last value into the hole and bumps the slot's
+// generation, so older handles to it come back empty. Freed slots are reused last in, first out.
+template<typename T> class HandlePool {
+public:
+    static_assert(std::is_trivially_copyable_v<Handle<T>> && sizeof(Handle<T>) == 8);
+
+    template<typename... Args> Handle<T> emplace(Args&&... args) {
+        uint32_t index;
+        if(!free_slots.empty()) {
+            index = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            index = (uint32_t)slots.size();
+            slots.push_back(Slot{});
+        }
+        auto &slot = slots[index];
+        slot.value = (uint32_t)values.size();
+        values.emplace_back(std::forward<Args>(args)...);
+        value_slots.push_back(index);
+        return Handle<T>{index, slot.generation};
+    }
+    Handle<T> insert(T &&value) { return emplace(std::move(value)); }
+
+    // false when the handle was stale already
+    bool erase(Handle<T> handle) {
+        if(!contains(handle)) { return false; }
+        auto &slot = slots[handle.index];
+        const auto last = (uint32_t)values.size() - 1;
+        if(slot.value != last) {
+            values[slot.value] = std::move(values[last]);
+            value_slots[slot.value] = value_slots[last];
+            slots[value_slots[last]].value = slot.value;
+        }
+        values.pop_back();
+        value_slots.pop_back();
+        // generation 0 is what null handles have
+        if(++slot.generation == 0) { slot.generation = 1; }
+        free_slots.push_back(handle.index);
+        return true;
+    }
+    void clear() {
+        for(const auto index : value_slots) {
+            if(++slots[index].generation == 0) { slots[index].generation = 1; }
+            free_slots.push_back(index);
+        }
+        values.clear();
+        value_slots.clear();
+    }
+
+    bool contains(Handle<T> handle) const { return handle.index < slots.size() && slots[handle.index].generation == handle.generation && handle; }
+    // nullptr for stale and null handles
+    T* get(Handle<T> handle) { return contains(handle) ? &values[slots[handle.index].value] : nullptr; }
+    const T* get(Handle<T> handle) const { return contains(handle) ? &values[slots[handle.index].value] : nullptr; }
+    // throws std::out_of_range for stale and null handles, like the maps the pool replaces
+    T& at(Handle<T> handle) {
+        if(!contains(handle)) { throw std::out_of_range{"stale or null handle"}; }
+        return values[slots[handle.index].value];
+    }
+    const T& at(Handle<T> handle) const {
+        if(!contains(handle)) { throw std::out_of_range{"stale or null handle"}; }
+        return values[slots[handle.index].value];
+    }
+
+    size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+    // all values in no particular order, which changes with every erase
+    std::span<T> dense() { return values; }
+    std::span<const T> dense() const { return values; }
+    auto begin() { return values.begin(); }
+    auto end() { return values.end(); }
+    auto begin() const { return values.begin(); }
+    auto end() const { return values.end(); }
+
+private:
+    struct Slot {
+        uint32_t value{0};
+        uint32_t generation{1};
+    };
+
+    std::vector<T> values;
+    std::vector<uint32_t> value_slots; // the slot of every value
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+};
+
+}
\ No newline at end of file
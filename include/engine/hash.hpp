@@ -0,0 +1,57 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <span>
+
+namespace eng {
+
+// XXH64. Fast enough to hash whole texture files and decoded images on load.
+class Hash {
+public:
+    static uint64_t bytes(std::span<const std::byte> data, uint64_t seed = 0) noexcept {
+        const auto *p = reinterpret_cast<const uint8_t*>(data.data());
+        const auto *end = p + data.size();
+        uint64_t h;
+
+        if(data.size() >= 32) {
+            uint64_t v[4]{seed + P1 + P2, seed + P2, seed, seed - P1};
+            for(; p + 32 <= end; p += 32) {
+                for(int i=0; i<4; ++i) { v[i] = _round(v[i], _read64(p + i*8)); }
+            }
+            h = std::rotl(v[0], 1) + std::rotl(v[1], 7) + std::rotl(v[2], 12) + std::rotl(v[3], 18);
+            for(auto e : v) { h = (h ^ _round(0, e)) * P1 + P4; }
+        } else {
+            h = seed + P5;
+        }
+
+        h += data.size();
+        for(; p + 8 <= end; p += 8) { h = std::rotl(h ^ _round(0, _read64(p)), 27) * P1 + P4; }
+        if(p + 4 <= end) {
+            uint32_t k;
+            memcpy(&k, p, 4);
+            h = std::rotl(h ^ (k * P1), 23) * P2 + P3;
+            p += 4;
+        }
+        for(; p < end; ++p) { h = std::rotl(h ^ (*p * P5), 11) * P1; }
+
+        h ^= h >> 33; h *= P2;
+        h ^= h >> 29; h *= P3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    template<typename T> static uint64_t combine(uint64_t seed, const T &value) noexcept {
+        return bytes(std::as_bytes(std::span{&value, 1}), seed);
+    }
+
+private:
+    static constexpr uint64_t P1 = 0x9E3779B185EBCA87ull, P2 = 0xC2B2AE3D27D4EB4Full, P3 = 0x165667B19E3779F9ull, P4 = 0x85EBCA77C2B2AE63ull, P5 = 0x27D4EB2F165667C5ull;
+
+    static uint64_t _read64(const uint8_t *p) noexcept { uint64_t v; memcpy(&v, p, 8); return v; }
+    static uint64_t _round(uint64_t acc, uint64_t input) noexcept { return std::rotl(acc + input * P2, 31) * P1; }
+};
+
+}
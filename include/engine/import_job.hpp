@@ -0,0 +1,38 @@
+#pragma once
+
+#include <engine/model_loader.hpp>
+
+#include <filesystem>
+#include <future>
+
+namespace eng {
+
+// Imports and cooks a geometry on a worker thread. The owner polls it once per frame,
+// takes the geometry when it is ready and does the upload stage itself.
+class ImportJob {
+public:
+    // meshes that are not already cooked are packed into `layout`
+    ImportJob(std::filesystem::path path, const VertexLayout &layout);
+    ImportJob(const ImportJob&) = delete;
+    ImportJob& operator=(const ImportJob&) = delete;
+    // cancels the job and waits for the worker to notice
+    ~ImportJob() noexcept;
+
+    const std::filesystem::path& path() const noexcept { return _path; }
+    ImportStage stage() const noexcept { return _progress.stage; }
+    float fraction() const noexcept { return _progress.fraction; }
+    void cancel() noexcept { _progress.cancel = true; }
+
+    // true once the worker is done, whether it succeeded or not
+    bool ready() const;
+    // moves the cooked geometry out and enters the upload stage. empty if the import failed or was cancelled.
+    Geometry take();
+    void finish() noexcept { _progress.stage = ImportStage::Done; }
+
+private:
+    std::filesystem::path _path;
+    ImportProgress _progress;
+    std::future<Geometry> _result;
+};
+
+}
\ No newline at end of file
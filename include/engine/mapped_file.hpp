@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace eng {
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path &path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile& operator=(MappedFile &&other) noexcept;
+    ~MappedFile() noexcept;
+
+    explicit operator bool() const noexcept { return !!_data; }
+
+    std::span<const std::byte> data() const noexcept { return {_data, _size}; }
+    size_t size() const noexcept { return _size; }
+
+private:
+    void _unmap() noexcept;
+
+    const std::byte *_data{};
+    size_t _size{0};
+#ifdef _WIN32
+    void *_file{}, *_mapping{};
+#endif
+};
+
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <engine/vertex_layout.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <string_view>
+
+namespace eng {
+
+// Cooked geometry container (.emesh), written by the mesh_cooker tool.
+// Layout: CookedMeshHeader | CookedMeshEntry[mesh_count] | string table | vertex data | index data | meshlets | nodes
+// Vertex data is interleaved in the vertex layout stored in the header (position, normal, texture coords,
+// possibly quantized) and index data is relative to each mesh's first vertex, so both can be copied to the gpu as they are.
+struct CookedMeshHeader {
+    static constexpr uint32_t MAGIC = 0x48534d45; // "EMSH"
+    static constexpr uint32_t VERSION = 5;
+    static constexpr uint32_t DATA_ALIGNMENT = 16;
+
+    uint32_t magic{MAGIC};
+    uint32_t version{VERSION};
+    uint32_t mesh_count{0};
+    uint32_t vertex_stride{0};
+    VertexAttributeFormat vertex_formats[VertexLayout::LocationCount]{};
+    uint8_t _pad[8 - VertexLayout::LocationCount]{};
+    uint64_t strings_offset{0}, strings_size{0};
+    uint64_t vertex_offset{0}, vertex_size{0};
+    uint64_t index_offset{0}, index_size{0};
+    uint64_t meshlet_offset{0}, meshlet_size{0};
+    uint64_t node_offset{0}, node_size{0};
+};
+
+struct CookedMeshLod {
+    uint32_t first_index{0}, index_count{0}; // relative to the entry's first index
+    float error{0.0f};
+    uint32_t first_meshlet{0}, meshlet_count{0}; // relative to the entry's first meshlet
+};
+
+struct CookedMeshlet {
+    float center[3]{};
+    float radius{0.0f};
+    float cone_axis[3]{};
+    float cone_cutoff{1.0f};
+    uint32_t first_index{0}, index_count{0}; // relative to the entry's first index
+};
+
+// GeometryNode
+struct CookedMeshNode {
+    static constexpr uint32_t NO_PARENT = ~0u;
+
+    float transform[16]{}; // column major, relative to the parent
+    uint32_t parent{NO_PARENT}; // an earlier node
+    uint32_t first_mesh{0}, mesh_count{0};
+    uint32_t _pad{0};
+};
+
+struct CookedMeshEntry {
+    static constexpr uint32_t NO_STRING = ~0u;
+    static constexpr uint32_t MAX_LODS = 8;
+
+    uint32_t first_vertex{0}, vertex_count{0};
+    uint32_t first_index{0}, index_count{0};
+    // offsets into the string table, paths are relative to the .emesh file
+    uint32_t diffuse_texture{NO_STRING}, normal_texture{NO_STRING};
+    float aabb_min[3]{}, aabb_max[3]{};
+    // range quantized texture coords are relative to
+    float uv_min[2]{}, uv_max[2]{};
+    // 0 when the entry's indices are a single level of detail
+    uint32_t lod_count{0};
+    CookedMeshLod lods[MAX_LODS]{};
+    uint32_t first_meshlet{0}, meshlet_count{0};
+};
+
+struct CookedMesh {
+    CookedMeshHeader header;
+    std::span<const CookedMeshEntry> entries;
+    std::span<const char> strings;
+    std::span<const std::byte> vertices;
+    std::span<const uint32_t> indices;
+    std::span<const CookedMeshlet> meshlets;
+    std::span<const CookedMeshNode> nodes;
+    VertexLayout layout;
+
+    std::string_view string(uint32_t offset) const {
+        if(offset == CookedMeshEntry::NO_STRING || offset >= strings.size()) { return {}; }
+        return std::string_view{strings.data() + offset};
+    }
+};
+
+// Returns false if the file is not a valid .emesh container. On success every span points into `file`,
+// which has to be suitably aligned (memory mappings always are).
+inline bool parse_cooked_mesh(std::span<const std::byte> file, CookedMesh &out) {
+    if(file.size() < sizeof(CookedMeshHeader)) { return false; }
+    memcpy(&out.header, file.data(), sizeof(CookedMeshHeader));
+    const auto &h = out.header;
+    if(h.magic != CookedMeshHeader::MAGIC || h.version != CookedMeshHeader::VERSION) { return false; }
+    out.layout = VertexLayout::make(h.vertex_formats[VertexLayout::Position], h.vertex_formats[VertexLayout::Normal], h.vertex_formats[VertexLayout::TextureCoords]);
+    if(!out.layout.valid() || out.layout.stride != h.vertex_stride) { return false; }
+
+    const auto entries_end = sizeof(CookedMeshHeader) + (uint64_t)h.mesh_count * sizeof(CookedMeshEntry);
+    if(entries_end > file.size()
+        || h.strings_offset + h.strings_size > file.size()
+        || h.vertex_offset + h.vertex_size > file.size()
+        || h.index_offset + h.index_size > file.size()
+        || h.meshlet_offset + h.meshlet_size > file.size()
+        || h.node_offset + h.node_size > file.size()
+        || h.vertex_offset % CookedMeshHeader::DATA_ALIGNMENT != 0
+        || h.index_offset % CookedMeshHeader::DATA_ALIGNMENT != 0
+        || h.meshlet_offset % CookedMeshHeader::DATA_ALIGNMENT != 0
+        || h.node_offset % CookedMeshHeader::DATA_ALIGNMENT != 0
+        || (h.strings_size > 0 && file[h.strings_offset + h.strings_size - 1] != std::byte{0})) {
+        return false;
+    }
+
+    out.entries = {reinterpret_cast<const CookedMeshEntry*>(file.data() + sizeof(CookedMeshHeader)), h.mesh_count};
+    out.strings = {reinterpret_cast<const char*>(file.data() + h.strings_offset), h.strings_size};
+    out.vertices = file.subspan(h.vertex_offset, h.vertex_size);
+    out.indices = {reinterpret_cast<const uint32_t*>(file.data() + h.index_offset), h.index_size / sizeof(uint32_t)};
+    out.meshlets = {reinterpret_cast<const CookedMeshlet*>(file.data() + h.meshlet_offset), h.meshlet_size / sizeof(CookedMeshlet)};
+    out.nodes = {reinterpret_cast<const CookedMeshNode*>(file.data() + h.node_offset), h.node_size / sizeof(CookedMeshNode)};
+
+    for(const auto &e : out.entries) {
+        if(((uint64_t)e.first_vertex + e.vertex_count) * h.vertex_stride > h.vertex_size) { return false; }
+        if((uint64_t)e.first_index + e.index_count > out.indices.size()) { return false; }
+        // relative to the entry's vertices, and narrowed to the smallest index type that holds vertex_count - 1 on upload
+        for(const auto index : out.indices.subspan(e.first_index, e.index_count)) {
+            if(index >= e.vertex_count) { return false; }
+        }
+        if(e.lod_count > CookedMeshEntry::MAX_LODS) { return false; }
+        if((uint64_t)e.first_meshlet + e.meshlet_count > out.meshlets.size()) { return false; }
+        for(auto i=0u; i<e.lod_count; ++i) {
+            if((uint64_t)e.lods[i].first_index + e.lods[i].index_count > e.index_count) { return false; }
+            if((uint64_t)e.lods[i].first_meshlet + e.lods[i].meshlet_count > e.meshlet_count) { return false; }
+        }
+        for(const auto &m : out.meshlets.subspan(e.first_meshlet, e.meshlet_count)) {
+            if((uint64_t)m.first_index + m.index_count > e.index_count) { return false; }
+        }
+    }
+    for(auto i=0u; i<out.nodes.size(); ++i) {
+        const auto &n = out.nodes[i];
+        if(n.parent != CookedMeshNode::NO_PARENT && n.parent >= i) { return false; }
+        if((uint64_t)n.first_mesh + n.mesh_count > h.mesh_count) { return false; }
+    }
+    return true;
+}
+
+}
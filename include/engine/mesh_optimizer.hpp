@@ -0,0 +1,92 @@
+#pragma once
+
+#include <engine/model.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace eng {
+
+// Post-transform vertex cache efficiency of an index buffer, measured with a simulated FIFO cache.
+// ACMR: transformed vertices per triangle, 0.5 at best for big regular meshes, 3 at worst.
+// ATVR: transformed vertices per referenced vertex, 1 at best.
+struct VertexCacheStats {
+    size_t triangles{0}, vertices{0}, transformed{0};
+
+    float acmr() const { return triangles ? (float)transformed / triangles : 0.0f; }
+    float atvr() const { return vertices ? (float)transformed / vertices : 0.0f; }
+    VertexCacheStats& operator+=(const VertexCacheStats &s) {
+        triangles += s.triangles;
+        vertices += s.vertices;
+        transformed += s.transformed;
+        return *this;
+    }
+};
+
+// the cache stats are of the full detail level
+struct MeshOptimizationReport {
+    VertexCacheStats before, after;
+    size_t vertices_before{0}, vertices_after{0}; // differ by the welded and unreferenced vertices
+    std::array<size_t, MESH_MAX_LODS> lod_triangles{};
+    size_t meshlets{0}; // of all levels
+
+    MeshOptimizationReport& operator+=(const MeshOptimizationReport &r) {
+        before += r.before;
+        after += r.after;
+        vertices_before += r.vertices_before;
+        vertices_after += r.vertices_after;
+        for(auto i=0u; i<MESH_MAX_LODS; ++i) { lod_triangles[i] += r.lod_triangles[i]; }
+        meshlets += r.meshlets;
+        return *this;
+    }
+};
+
+struct MeshOptimizerOptions {
+    bool weld{true};
+    bool overdraw{true};
+    // how much worse than the vertex cache optimized order the overdraw order may get, in ACMR
+    float overdraw_threshold{1.05f};
+    // levels of detail including the full one, each with about lod_ratio of the triangles of the one before.
+    // the chain ends early when a level can't get below lod_max_error (relative to the mesh's extent).
+    uint32_t lod_count{6};
+    float lod_ratio{0.5f};
+    float lod_max_error{0.05f};
+    float lod_attribute_weight{0.01f};
+    bool meshlets{true};
+};
+
+// Reorders (and welds) the triangles and vertices of meshes still in SoA form, see optimize() for the order of the passes.
+// Only the index and vertex order changes, so the rendered result is the same.
+class MeshOptimizer {
+public:
+    static constexpr uint32_t CACHE_SIZE = 16;
+
+    // welding, level of detail generation, vertex cache, overdraw and vertex fetch optimization, in that order,
+    // then the meshlets are cut from the final triangle order.
+    // packed (cooked) meshes are left alone.
+    static MeshOptimizationReport optimize(Mesh &mesh, const MeshOptimizerOptions &options = {});
+
+    static VertexCacheStats analyze_vertex_cache(std::span<const uint32_t> indices, size_t vertex_count, uint32_t cache_size = CACHE_SIZE);
+
+    // merges vertices whose position, normal and texture coords are bitwise equal
+    static void weld_vertices(Mesh &mesh);
+    // tipsify (Sander et al. 2007). if `clusters` is given, it gets the first triangle of every run
+    // that starts with a cold cache, which optimize_overdraw can then move around freely.
+    static void optimize_vertex_cache(std::span<uint32_t> indices, size_t vertex_count, std::vector<uint32_t> *clusters = nullptr, uint32_t cache_size = CACHE_SIZE);
+    // splits the clusters further wherever that costs less than `threshold` in ACMR and sorts them so
+    // the ones facing outward of the mesh are drawn first, as they are the likeliest to occlude the rest
+    static void optimize_overdraw(std::span<uint32_t> indices, std::span<const glm::vec3> positions, const std::vector<uint32_t> &clusters, float threshold, uint32_t cache_size = CACHE_SIZE);
+    // appends the simplified levels of detail to the indices, see MeshSimplifier
+    static void build_lods(Mesh &mesh, const MeshOptimizerOptions &options);
+    // orders the vertices by first use in the index buffer and drops unreferenced ones
+    static void optimize_vertex_fetch(Mesh &mesh);
+    // splits every level into runs of consecutive triangles of at most MESHLET_MAX_VERTICES vertices and
+    // MESHLET_MAX_TRIANGLES triangles, with their bounding sphere and normal cone. greedy, so it relies on the
+    // vertex cache order keeping neighbouring triangles together.
+    static void build_meshlets(Mesh &mesh);
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <engine/model.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace eng {
+
+// Quadric error edge collapse (Garland & Heckbert) that only moves vertices onto their neighbours,
+// so the simplified index buffer still indexes the mesh's own vertices.
+// Vertices sharing a position but not their other attributes (uv and hard normal seams) collapse together
+// and only along the seam, borders only along the border; anything more complicated stays where it is.
+class MeshSimplifier {
+public:
+    struct Result {
+        std::vector<uint32_t> indices;
+        float error{0.0f}; // largest deviation introduced, relative to the mesh's extent
+    };
+
+    // simplifies the triangles in `indices` (a subset of the mesh's) until there are at most `target_index_count` indices
+    // left or any further collapse would deviate by more than `target_error` (relative to the extent).
+    // `attribute_weight` scales how much normal and uv differences along an edge add to its collapse error.
+    static Result simplify(const Mesh &mesh, std::span<const uint32_t> indices, size_t target_index_count, float target_error, float attribute_weight);
+
+    // the largest side of the mesh's bounding box, what errors are relative to
+    static float extent(const Mesh &mesh);
+};
+
+}
\ No newline at end of file
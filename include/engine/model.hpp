@@ -1,9 +1,11 @@
 #pragma once
 
-#include <engine/handle.hpp>
+#include <engine/vertex_layout.hpp>
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <span>
 #include <unordered_map>
 
 #include <glm/glm.hpp>
@@ -14,6 +16,34 @@ enum class TextureType : uint8_t{
     None, Diffuse, Normal
 };
 
+// interleaved, unquantized position, normal and texture coords (VertexLayout::full())
+inline constexpr uint32_t MESH_VERTEX_STRIDE = sizeof(glm::vec3) + sizeof(glm::vec3) + sizeof(glm::vec2);
+static_assert(VertexLayout::full().stride == MESH_VERTEX_STRIDE);
+
+inline constexpr uint32_t MESH_MAX_LODS = 8;
+// what a mesh shader workgroup usually handles, the culling works with the same sizes
+inline constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+inline constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// a range of a mesh's indices drawing it at a lower level of detail, using the same vertices
+struct MeshLod {
+    uint32_t first_index{0}, index_count{0};
+    float error{0.0f}; // how far the simplified surface strays from the full one at most, in object space units
+    uint32_t first_meshlet{0}, meshlet_count{0}; // the level's triangles split up, in Mesh::meshlets
+};
+
+// a run of consecutive triangles of a mesh touching at most MESHLET_MAX_VERTICES vertices, culled as a whole.
+// the cone bounds the normals of all its triangles: seen from anywhere in direction d with
+// dot(d, cone_axis) >= cone_cutoff * length(d) + radius (d pointing from the eye to the center), they all face away.
+// a cutoff of 1 means the normals are too spread out for that.
+struct Meshlet {
+    glm::vec3 center{0.0f};
+    float radius{0.0f};
+    glm::vec3 cone_axis{0.0f, 0.0f, 1.0f};
+    float cone_cutoff{1.0f};
+    uint32_t first_index{0}, index_count{0}; // relative to the mesh's indices
+};
+
 struct MeshMaterial {
     std::string shader_name;
     std::unordered_map<TextureType, std::string> texture_paths;
@@ -25,20 +55,51 @@ struct Mesh {
     std::vector<glm::vec3> vertex_positions;
     std::vector<glm::vec3> vertex_normals;
     std::vector<glm::vec2> vertex_texture_coords;
+    VertexBounds bounds;
+
+    // set instead of the vectors above for cooked meshes:
+    // already interleaved vertices and indices, pointing into Geometry::source.
+    std::span<const std::byte> packed_vertices;
+    std::span<const uint32_t> packed_indices;
+    uint32_t packed_vertex_count{0};
+    VertexLayout packed_layout{VertexLayout::full()};
+
+    // finest first, all stored one after another in the indices. empty when there is just the one level of all indices
+    std::vector<MeshLod> lods;
+    // in the order of the levels, none crosses from one level into the next
+    std::vector<Meshlet> meshlets;
+
+    size_t vertex_count() const { return packed_vertices.empty() ? vertex_positions.size() : packed_vertex_count; }
+    size_t index_count() const { return packed_indices.empty() ? vertex_indices.size() : packed_indices.size(); }
+    size_t lod_count() const { return lods.empty() ? 1 : lods.size(); }
+    MeshLod lod(size_t level) const { return lods.empty() ? MeshLod{0, (uint32_t)index_count(), 0.0f, 0, (uint32_t)meshlets.size()} : lods.at(level); }
+};
+
+// a node of the imported scene, placing meshes [first_mesh, first_mesh + mesh_count) of the geometry
+struct GeometryNode {
+    static constexpr uint32_t NO_PARENT = ~0u;
+    glm::mat4 transform{1.0f}; // relative to the parent
+    uint32_t parent{NO_PARENT}; // always comes before the node
+    uint32_t first_mesh{0}, mesh_count{0};
 };
 
-struct Geometry : public Handle<Geometry> {
-    Geometry() : Handle(GENERATE_HANDLE) { }
-    explicit Geometry(const std::vector<Mesh>& meshes): Handle(HandleGenerator<Geometry>::generate()), meshes(meshes) { }
-    explicit Geometry(std::vector<Mesh>&& meshes): Handle(HandleGenerator<Geometry>::generate()), meshes(std::move(meshes)) { }
+struct Geometry {
+    Geometry() = default;
+    explicit Geometry(const std::vector<Mesh>& meshes): meshes(meshes) { }
+    explicit Geometry(std::vector<Mesh>&& meshes): meshes(std::move(meshes)) { }
 
     std::vector<Mesh> meshes;
+    // depth first, every mesh is in exactly one. empty when the meshes are all placed as they are
+    std::vector<GeometryNode> nodes;
+    // keeps the packed data of cooked meshes alive, either a file mapping or a buffer made by GeometryImporter::cook
+    std::shared_ptr<const void> source;
 };
 
 struct Model {
     // in the future, it may be neccessary to change this pointer
     // into something mutable for i.e. mesh morphing?
     const Geometry *geometry{};
+    glm::mat4 transform{1.0f}; // where the geometry's nodes are placed in the world
 };
 
 }
\ No newline at end of file
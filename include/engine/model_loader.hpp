@@ -1,7 +1,9 @@
 #pragma once
 
 #include <engine/model.hpp>
+#include <engine/mesh_optimizer.hpp>
 
+#include <atomic>
 #include <filesystem>
 
 // assimp has faulty headers which 
@@ -10,18 +12,42 @@
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
+#include <assimp/ProgressHandler.hpp>
 
 namespace eng {
 
+enum class ImportStage : uint8_t {
+    Queued, Parse, Convert, Optimize, Cook, Upload, Done, Cancelled, Failed
+};
+
+// shared between an import running on another thread and whoever displays or cancels it
+struct ImportProgress {
+    std::atomic<ImportStage> stage{ImportStage::Queued};
+    std::atomic<float> fraction{0.0f}; // of the current stage
+    std::atomic_bool cancel{false};
+};
+
 class GeometryImporter {
 public:
-    static Geometry import(const std::filesystem::path &path);
+    // .emesh files made by mesh_cooker are memory mapped, everything else goes through assimp.
+    // if `progress` is given, it is updated during parsing and conversion and its cancel flag
+    // is honored, in which case an empty Geometry is returned.
+    static Geometry import(const std::filesystem::path &path, ImportProgress *progress = nullptr);
+    // runs MeshOptimizer over every not yet packed mesh, in parallel. returns the totals of all meshes.
+    static MeshOptimizationReport optimize(Geometry &geometry, const MeshOptimizerOptions &options = {}, ImportProgress *progress = nullptr);
+    // interleaves every not yet packed mesh into one buffer owned by the geometry, in the given layout,
+    // and releases the separate vertex attribute vectors.
+    static void cook(Geometry &geometry, const VertexLayout &layout, ImportProgress *progress = nullptr);
 
 private:
+    static Geometry _import_cooked(const std::filesystem::path &path);
+
     GeometryImporter(const aiScene *scene, const std::string &base_path): scene(scene), base_path(base_path) {}
 
-    void _parse_aiscene_nodes_rec(const aiNode *ai, Geometry &geometry);
-    Mesh _parse_aimesh(const aiMesh *ai);
+    // collects the nodes and their meshes depth-first, in the order they end up in Geometry::nodes and Geometry::meshes
+    void _gather_aiscene_nodes_rec(const aiNode *ai, uint32_t parent, std::vector<const aiMesh*> &meshes, std::vector<GeometryNode> &nodes) const;
+    // only reads the scene, safe to call from several threads at once
+    Mesh _parse_aimesh(const aiMesh *ai) const;
 
     const aiScene *scene{};
     std::string base_path;
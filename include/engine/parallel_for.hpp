@@ -0,0 +1,27 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace eng {
+
+// calls `fn(i)` for every i in [0, count) across all cores. workers pull the next index
+// from a shared counter, as the work per index (a mesh, a chunk of instances) varies a lot.
+template<typename Fn> void parallel_for(size_t count, Fn &&fn) {
+    std::atomic_size_t next{0};
+    const auto work = [&] {
+        for(auto i = next++; i < count; i = next++) { fn(i); }
+    };
+
+    const auto worker_count = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), count);
+    std::vector<std::future<void>> workers;
+    for(auto i=1u; i<worker_count; ++i) { workers.push_back(std::async(std::launch::async, work)); }
+    work();
+    for(auto &w : workers) { w.get(); }
+}
+
+}
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include <engine/vertex_layout.hpp>
+
 namespace eng {
 
 class Shader;
@@ -22,11 +24,13 @@ struct PipelineSetLayout {
 struct PipelineLayout {
     PipelineLayout(
         vk::PipelineLayout layout,
-        const std::vector<vk::DescriptorSetLayout> &desc_set_layout_handles
-    ): layout(layout), desc_set_layout_handles(desc_set_layout_handles) {}
+        const std::vector<vk::DescriptorSetLayout> &desc_set_layout_handles,
+        const std::vector<vk::PushConstantRange> &push_constant_ranges
+    ): layout(layout), desc_set_layout_handles(desc_set_layout_handles), push_constant_ranges(push_constant_ranges) {}
 
     vk::PipelineLayout layout;
     std::vector<vk::DescriptorSetLayout> desc_set_layout_handles;
+    std::vector<vk::PushConstantRange> push_constant_ranges;
 };
 
 struct Pipeline {
@@ -43,10 +47,18 @@ struct Pipeline {
     const std::vector<Shader> *shaders{};
 };
 
+// a single compute shader makes a compute pipeline, everything but the shaders is then ignored
 struct PipelineConfig {
     const std::vector<Shader>* shaders; 
     std::vector<vk::DynamicState> dynamic_states;
     std::vector<vk::VertexInputBindingDescription> input_bindings;
+    // formats and offsets of the vertex shader inputs; when empty they are deduced
+    // from the shader as tightly packed 32 bit floats.
+    VertexLayout vertex_layout{};
+    // attachments of the rendering the pipeline is used in. with a depth format, depth is tested and
+    // written, reversed: cleared to 0 and nearer is greater.
+    std::vector<vk::Format> color_formats;
+    vk::Format depth_format{vk::Format::eUndefined};
 };
 
 
@@ -59,6 +71,7 @@ public:
     
 private:
     Pipeline _build_pipeline(const PipelineConfig &config);
+    Pipeline _build_compute_pipeline(const PipelineConfig &config);
     vk::PipelineLayout _find_or_build_pipeline_layout(const PipelineConfig &config);
     const std::vector<vk::DescriptorSetLayoutBinding>& _get_set_layout_bindings(vk::DescriptorSetLayout dsl) const;
     bool _are_pipeline_set_layouts_compatible(const std::vector<vk::DescriptorSetLayoutBinding> &set_a, const std::vector<vk::DescriptorSetLayoutBinding> &set_b) const;
@@ -2,6 +2,7 @@
 
 #include <mutex>
 #include <future>
+#include <span>
 
 namespace eng {
 
@@ -17,9 +18,12 @@ public:
 
     operator bool() const noexcept { return !!_queue; }
     
-    [[nodiscard]] std::pair<bool, std::future<void>> submit_async(std::vector<vk::SubmitInfo> submits, vk::Fence fence = nullptr);
+    // the submits are copied, they don't have to outlive the call
+    [[nodiscard]] std::pair<bool, std::future<void>> submit_async(std::span<const vk::SubmitInfo> submits, vk::Fence fence = nullptr);
+    [[nodiscard]] std::pair<bool, std::future<void>> submit_async(const vk::SubmitInfo &info, vk::Fence fence = nullptr) { return submit_async(std::span{&info, 1}, fence); }
 
-    [[nodiscard]] bool submit(const std::vector<vk::SubmitInfo> submits, vk::Fence fence = nullptr);
+    [[nodiscard]] bool submit(std::span<const vk::SubmitInfo> submits, vk::Fence fence = nullptr);
+    [[nodiscard]] bool submit(const vk::SubmitInfo &info, vk::Fence fence = nullptr) { return submit(std::span{&info, 1}, fence); }
     
     void wait_idle() const { _queue.waitIdle(); }
 
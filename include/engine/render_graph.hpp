@@ -0,0 +1,230 @@
+#pragma once
+
+#include <engine/barrier_batch.hpp>
+#include <engine/frame_arena.hpp>
+
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vma/vma.h>
+
+namespace eng {
+
+// how a pass uses a resource: the stages it does it in, what they access and, for images, the layout they need it in
+struct RenderGraphAccess {
+    vk::PipelineStageFlags2 stages{};
+    vk::AccessFlags2 access{};
+    vk::ImageLayout layout{vk::ImageLayout::eUndefined};
+};
+
+// what passes are declared with. buffers ignore the layout
+namespace rg {
+    inline constexpr RenderGraphAccess color_attachment{vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite, vk::ImageLayout::eColorAttachmentOptimal};
+    inline constexpr RenderGraphAccess depth_attachment{vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests, vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite, vk::ImageLayout::eDepthAttachmentOptimal};
+    inline constexpr RenderGraphAccess fragment_sampled{vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead, vk::ImageLayout::eShaderReadOnlyOptimal};
+    inline constexpr RenderGraphAccess compute_sampled{vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead, vk::ImageLayout::eShaderReadOnlyOptimal};
+    inline constexpr RenderGraphAccess compute_sampled_general{vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead, vk::ImageLayout::eGeneral};
+    inline constexpr RenderGraphAccess compute_read{vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead, vk::ImageLayout::eGeneral};
+    inline constexpr RenderGraphAccess compute_storage{vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead | vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite, vk::ImageLayout::eGeneral};
+    inline constexpr RenderGraphAccess indirect_read{vk::PipelineStageFlagBits2::eDrawIndirect, vk::AccessFlagBits2::eIndirectCommandRead};
+    // fillBuffer and clearColorImage
+    inline constexpr RenderGraphAccess clear{vk::PipelineStageFlagBits2::eClear, vk::AccessFlagBits2::eTransferWrite, vk::ImageLayout::eTransferDstOptimal};
+    inline constexpr RenderGraphAccess blit_src{vk::PipelineStageFlagBits2::eBlit, vk::AccessFlagBits2::eTransferRead, vk::ImageLayout::eTransferSrcOptimal};
+    inline constexpr RenderGraphAccess blit_dst{vk::PipelineStageFlagBits2::eBlit, vk::AccessFlagBits2::eTransferWrite, vk::ImageLayout::eTransferDstOptimal};
+    // nothing after it in the command buffer waits, the present waits for the submit's semaphore
+    inline constexpr RenderGraphAccess present{vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, vk::ImageLayout::ePresentSrcKHR};
+}
+
+// what the next use of a resource has to wait for. imported resources keep theirs across frames, a default one is a
+// resource nothing has used yet
+struct RenderGraphState {
+    // the last write or layout transition, and the stages and accesses it was made visible to since
+    vk::PipelineStageFlags2 write_stages{};
+    vk::AccessFlags2 write_access{};
+    vk::PipelineStageFlags2 visible_stages{};
+    vk::AccessFlags2 visible_access{};
+    // reads since the last write, which the next write waits for
+    vk::PipelineStageFlags2 read_stages{};
+    vk::ImageLayout layout{vk::ImageLayout::eUndefined};
+};
+
+// a transient image, made by the graph and only valid while it executes
+struct RenderGraphImageDesc {
+    vk::Format format{vk::Format::eUndefined};
+    vk::Extent2D extent{};
+    vk::ImageUsageFlags usage{};
+    vk::ImageAspectFlags aspect{vk::ImageAspectFlagBits::eColor};
+};
+
+struct RenderGraphImage {
+    explicit operator bool() const { return index != ~0u; }
+    uint32_t index{~0u};
+};
+
+struct RenderGraphBuffer {
+    explicit operator bool() const { return index != ~0u; }
+    uint32_t index{~0u};
+};
+
+struct RenderGraphStats {
+    uint32_t passes{0}, culled_passes{0};
+    uint32_t transients{0}, aliased_transients{0}; // aliased ones share their memory with a transient used before them
+};
+
+// Keeps the images and memory of the graphs' transients across frames. A graph with the same transients as one
+// before it gets the same images, so they are only made when the targets change, and a set that isn't used anymore
+// is destroyed KEEP_FRAMES after its last use, which lets the renderer go back and forth between two graphs for free.
+class RenderGraphCache {
+public:
+    static constexpr uint64_t KEEP_FRAMES = 120;
+
+    RenderGraphCache() = default;
+    RenderGraphCache(vk::Device device, VmaAllocator allocator) noexcept : _device{device}, _allocator{allocator} { }
+    RenderGraphCache(const RenderGraphCache&) = delete;
+    RenderGraphCache& operator=(const RenderGraphCache&) = delete;
+    RenderGraphCache(RenderGraphCache &&other) noexcept;
+    RenderGraphCache& operator=(RenderGraphCache &&other) noexcept;
+    ~RenderGraphCache() noexcept;
+
+    // destroys the sets last used by a frame at least KEEP_FRAMES before `completed_frame`
+    void evict(uint64_t completed_frame);
+    // bytes of device memory of every set kept
+    vk::DeviceSize memory() const;
+
+private:
+    friend class RenderGraph;
+
+    struct Image {
+        vk::Image image;
+        vk::ImageView view;
+        VmaAllocation allocation{}; // its own, when its group's memory couldn't be shared
+    };
+    // the transients that never overlap, one after the other in the same memory
+    struct Group {
+        VmaAllocation allocation{};
+        RenderGraphState state; // of whichever image used it last
+    };
+    struct Set {
+        uint64_t signature{0};
+        std::vector<Image> images;
+        std::vector<Group> groups;
+        uint64_t last_used{0};
+        vk::DeviceSize memory{0};
+    };
+
+    // images in the order of descs, images[i] in group groups[i]
+    Set* get(uint64_t signature, std::span<const RenderGraphImageDesc> descs, std::span<const uint32_t> groups, uint32_t group_count, uint64_t frame);
+    void destroy(Set &set);
+
+    vk::Device _device;
+    VmaAllocator _allocator{};
+    std::vector<Set> _sets;
+};
+
+// Records a frame from passes that declare what they read and write. execute() drops the passes whose results nobody
+// reads, puts the transients whose passes don't overlap into the same memory and, before every pass, flushes one batch
+// of the layout transitions and dependencies its uses need, from what the resources were last used as.
+// Lives for one frame in its arena, a pass's record callback is kept there too and so must not need destroying.
+class RenderGraph {
+public:
+    class PassBuilder {
+    public:
+        PassBuilder& read(RenderGraphImage image, const RenderGraphAccess &access) { _graph->use(_pass, image.index, access, false); return *this; }
+        PassBuilder& write(RenderGraphImage image, const RenderGraphAccess &access) { _graph->use(_pass, image.index, access, true); return *this; }
+        PassBuilder& read(RenderGraphBuffer buffer, const RenderGraphAccess &access) { _graph->use(_pass, buffer.index, access, false); return *this; }
+        PassBuilder& write(RenderGraphBuffer buffer, const RenderGraphAccess &access) { _graph->use(_pass, buffer.index, access, true); return *this; }
+        // kept even when nothing reads what it writes
+        PassBuilder& side_effects();
+
+    private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph &graph, uint32_t pass) : _graph{&graph}, _pass{pass} { }
+
+        RenderGraph *_graph;
+        uint32_t _pass;
+    };
+
+    RenderGraph(FrameArena &arena, RenderGraphCache &cache);
+
+    // `state` is where the resource was left by whatever used it last and is updated by execute(). nullptr when nothing
+    // before or after the graph uses it, what it holds is thrown away then and passes that only write to it are culled
+    RenderGraphImage import_image(vk::Image image, vk::ImageView view, const vk::ImageSubresourceRange &range, RenderGraphState *state = nullptr);
+    RenderGraphBuffer import_buffer(vk::Buffer buffer, RenderGraphState *state = nullptr);
+    // starts out undefined in every frame
+    RenderGraphImage create_image(const RenderGraphImageDesc &desc);
+    // the image is transitioned to `access` after the last pass, e.g. for presenting it
+    void set_final_access(RenderGraphImage image, const RenderGraphAccess &access);
+
+    // the uses are declared on what's returned, before the next pass is added. `record` is called with the
+    // command buffer by execute(), unless the pass was culled
+    template<typename F> PassBuilder add_pass(std::string_view name, F &&record) {
+        using Record = std::remove_cvref_t<F>;
+        static_assert(std::is_trivially_destructible_v<Record>, "the arena never runs destructors");
+        auto *callable = new(_arena->allocate(sizeof(Record), alignof(Record))) Record{std::forward<F>(record)};
+        return add_pass(name, callable, [](void *c, vk::CommandBuffer cmd) { (*static_cast<Record*>(c))(cmd); });
+    }
+
+    // records into the batch's command buffer, with whatever was pending in it going into the first pass's barrier.
+    // false when the transients couldn't be made, nothing is recorded then
+    [[nodiscard]] bool execute(BarrierBatch &barriers, uint64_t frame);
+
+    // valid from execute() on, which is when the passes are recorded
+    vk::Image image(RenderGraphImage image) const { return _resources.at(image.index).image; }
+    vk::ImageView view(RenderGraphImage image) const { return _resources.at(image.index).view; }
+    vk::Buffer buffer(RenderGraphBuffer buffer) const { return _resources.at(buffer.index).buffer; }
+    const RenderGraphStats& stats() const { return _stats; }
+
+private:
+    using RecordFn = void(*)(void *callable, vk::CommandBuffer cmd);
+
+    struct Resource {
+        vk::Image image;
+        vk::ImageView view;
+        vk::ImageSubresourceRange range;
+        vk::Buffer buffer;
+        RenderGraphImageDesc desc; // of transients
+        RenderGraphState state;
+        RenderGraphState *imported_state{nullptr};
+        RenderGraphAccess final_access;
+        bool is_image{false}, transient{false}, has_final_access{false};
+        bool live{false}; // read by a pass that isn't culled, or after the graph
+        bool started{false}; // transients, from their first use on
+        uint32_t first_use{~0u}, last_use{0}; // passes, of transients
+        uint32_t group{~0u}; // in the cache set, of transients
+    };
+    struct Use {
+        uint32_t resource{0};
+        RenderGraphAccess access;
+        bool write{false};
+    };
+    struct Pass {
+        std::string_view name;
+        void *callable{nullptr};
+        RecordFn record{nullptr};
+        uint32_t first_use{0}, use_count{0};
+        bool side_effects{false}, culled{false};
+    };
+
+    PassBuilder add_pass(std::string_view name, void *callable, RecordFn record);
+    void use(uint32_t pass, uint32_t resource, const RenderGraphAccess &access, bool write);
+    void cull();
+    bool create_transients(uint64_t frame);
+    void transition(Resource &resource, const RenderGraphAccess &access, bool write, BarrierBatch &barriers);
+
+    FrameArena *_arena;
+    RenderGraphCache *_cache;
+    std::pmr::vector<Resource> _resources;
+    std::pmr::vector<Use> _uses;
+    std::pmr::vector<Pass> _passes;
+    RenderGraphCache::Set *_transients{nullptr};
+    RenderGraphStats _stats;
+};
+
+}
\ No newline at end of file
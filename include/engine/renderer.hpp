@@ -5,7 +5,19 @@
 #include <engine/model.hpp>
 #include <engine/commandpool.hpp>
 #include <engine/queue.hpp>
+#include <engine/frustum.hpp>
+#include <engine/camera.hpp>
+#include <engine/bvh.hpp>
+#include <engine/components.hpp>
+#include <engine/scene_graph.hpp>
+#include <engine/ecs.hpp>
+#include <engine/frame_arena.hpp>
+#include <engine/upload_ring.hpp>
+#include <engine/frame_pacer.hpp>
+#include <engine/dynamic_resolution.hpp>
+#include <engine/render_graph.hpp>
 
+#include <array>
 #include <cstdint>
 #include <unordered_map>
 #include <vector>
@@ -22,13 +34,41 @@ class Shader;
 class PipelineManager;
 class BufferManager;
 class TextureManager;
+class ImportJob;
 struct Buffer;
+struct Texture;
 
 struct FrameRenderResources {
     CommandPool cmdpool;
     vk::CommandBuffer cmdbuff;
-    vk::Semaphore image_ready, rendering_done;
+    vk::Semaphore image_ready; // signaled by the acquire, waited on by the frame's submit
     vk::Fence in_flight_fence;
+    // scratch memory of everything recorded into cmdbuff, reset once in_flight_fence signaled
+    std::unique_ptr<FrameArena> arena;
+    // written by cull_meshlets, see RendererCullObjects
+    Handle<Buffer> meshlet_cull_jobs, meshlet_draws, meshlet_draw_counts;
+    vk::DescriptorSet meshlet_cull_descriptor;
+    uint64_t meshlets_version{0}; // the Renderer::meshlets_version whose buffer_meshlets meshlet_cull_descriptor binds
+    // written by cull_occlusion, see RendererOcclusionObjects. instance_phases is read by cull_meshlets as well
+    Handle<Buffer> instance_cull_jobs, instance_draws, instance_draw_counts, instance_phases;
+    vk::DescriptorSet instance_cull_descriptor;
+    // host visible, how many instances the second phase found occluded. read and zeroed once in_flight_fence signaled
+    Handle<Buffer> occlusion_stats;
+    // per level of the depth pyramid, the first reads the frame's depth and is rewritten by build_hiz, level n reads level n - 1
+    std::vector<vk::DescriptorSet> hiz_reduce_descriptors;
+    uint64_t hiz_version{0}; // the RendererOcclusionObjects::hiz_version of the pyramid the descriptors point to
+    // world matrix of every instance at its instance_id, which the draws pass on as their first instance. written by update_transforms
+    static constexpr uint32_t MAX_INSTANCE_TRANSFORMS = 1 << 16; // instances with a higher instance_id aren't drawn
+    Handle<Buffer> instance_transforms;
+    vk::DescriptorSet transform_descriptor;
+    uint64_t transforms_version{0}; // the Renderer::transforms_version the buffer holds
+    // where this frame's FrameConstants are in the upload ring, the dynamic offset of transform_descriptor
+    uint32_t constants_offset{0};
+    // written at the first and last command of cmdbuff, read once in_flight_fence signaled
+    vk::QueryPool timestamps;
+    bool timestamps_written{false};
+    // the scale the scene was rendered at, which is what the timestamps measured
+    float render_scale{1.0f};
 };
 
 enum class VkQueueFamilyType {
@@ -39,6 +79,15 @@ struct VkQueueFamily {
     uint32_t family_index{0}, count{0};
 };
 
+// replaced by create_swapchain. the frames in flight may still present to it, and presents aren't fenced, so it's
+// destroyed along with its views and semaphores once `frame` is done, frames_in_flight frames after it was replaced
+struct RetiredSwapchain {
+    vk::SwapchainKHR swapchain;
+    std::vector<vk::ImageView> views;
+    std::vector<vk::Semaphore> rendering_done;
+    uint64_t frame{0};
+};
+
 struct VulkanObjects {
     vk::Instance instance;
     vk::DebugUtilsMessengerEXT dbg_msng;
@@ -52,69 +101,354 @@ struct VulkanObjects {
     vk::SwapchainKHR swapchain;
     std::vector<vk::Image> swapchain_images;
     std::vector<vk::ImageView> swapchain_views;
-    Handle<Buffer> buffer_vertex, buffer_index;
+    // a semaphore per image, signaled by the submit rendering to it and waited on by its present. a frame's own
+    // semaphore could still be pending in a present when the frame comes around again, the image's can't once it's
+    // acquired again
+    std::vector<vk::Semaphore> swapchain_rendering_done;
+    std::vector<RetiredSwapchain> retired_swapchains;
+    std::vector<vk::PresentModeKHR> present_modes; // what the surface supports
+    // presents carry the frame number as their id with VK_KHR_present_id. wait_for_present is nullptr without
+    // VK_KHR_present_wait, and only frames from first_present_id on were presented to the current swapchain
+    bool present_id{false};
+    PFN_vkWaitForPresentKHR wait_for_present{};
+    uint64_t first_present_id{~0ull};
+    // nanoseconds per tick of the graphics queue's timestamps, 0 when it has none
+    float timestamp_period{0.0f};
+    uint64_t timestamp_mask{0};
+    Handle<Buffer> buffer_vertex, buffer_index, buffer_meshlets;
+    vk::Sampler material_sampler;
+    // set 0 of the mesh shaders, identical to what the pipeline manager makes from them: the instance transforms and the
+    // frame's constants in the upload ring
+    vk::DescriptorSetLayout transform_set_layout;
+    vk::DescriptorPool transform_descpool;
     std::vector<FrameRenderResources> per_frame_render_data;
     VmaAllocator allocator;
+    bool index_type_uint8{false}; // VK_EXT_index_type_uint8
+    bool draw_indirect_count{false};
 };
 
 //maybe switch to 64bits later
 using gpu_index_t = int32_t;
 struct GpuMesh {
     const Mesh *original{nullptr};
+    // where upload_meshes put the mesh in the shared vertex and index buffers.
+    // first_index counts in elements of index_type, which is the smallest type the vertex count fits in.
+    uint32_t first_index{0}, index_count{0};
+    vk::IndexType index_type{vk::IndexType::eUint32};
+    int32_t vertex_offset{0};
+    VertexLayout layout{};
+    VertexDecode decode{};
+    // object space box of the mesh, what the instances' world bounds are made from
+    glm::vec3 aabb_min{0.0f}, aabb_max{0.0f};
+    // where the mesh's meshlets are in buffer_meshlets, meshlet_count is 0 when it has none or they didn't fit
+    uint32_t first_meshlet{0}, meshlet_count{0};
+    // copy of original's levels, so the per instance loops don't have to go into the Mesh
+    std::array<MeshLod, MESH_MAX_LODS> lods{};
+    uint32_t lod_count{1};
+};
+
+// Meshlet as the culling shader reads it, its index range made absolute within the shared index buffer
+struct GpuMeshlet {
+    glm::vec4 sphere; // center, radius
+    glm::vec4 cone; // axis, cutoff
+    uint32_t first_index{0}, index_count{0};
+    int32_t vertex_offset{0};
+    uint32_t _pad{0};
+};
+static_assert(sizeof(GpuMeshlet) == 48);
+
+// up to a workgroup's worth of one instance's meshlets. the visible ones are appended to the instance's
+// draws starting at first_draw, counted in meshlet_draw_counts[draw_slot]
+// instance is where instance_cull.comp wrote in which phases the instance gets drawn, ~0u when that's only the first
+struct MeshletCullJob {
+    uint32_t first_meshlet{0}, meshlet_count{0};
+    uint32_t first_draw{0}, draw_slot{0}; // the instance's, the same for all of its jobs
+    uint32_t instance{~0u};
+    uint32_t transform{0}; // instance_id, for the world matrix
+};
+
+struct MeshletCullConstants {
+    glm::vec4 planes[6]; // world space, pointing inwards
+    glm::vec4 camera; // eye position, or the view direction when w is 0
+    uint32_t phase{0};
+    uint32_t draw_stride{0}, count_stride{0}; // draws and counts of phase n start n strides in
 };
+static_assert(sizeof(MeshletCullConstants) <= 128);
 
-struct MeshInstance {
+// the world box of a visible instance, and its draw when it's drawn whole. the survivors are appended to
+// the draws of its batch starting at first_draw, counted in instance_draw_counts[draw_slot]
+struct InstanceCullJob {
+    glm::vec4 center, extent;
+    uint32_t instance{0}; // index into the visibility kept across frames
+    uint32_t draw_slot{~0u}; // ~0u when cull_meshlets draws it
+    uint32_t first_draw{0};
+    uint32_t index_count{0}, first_index{0};
+    int32_t vertex_offset{0};
+    uint32_t _pad[2]{};
+};
+static_assert(sizeof(InstanceCullJob) == 64);
+
+struct InstanceCullConstants {
+    glm::mat4 clip_from_world;
+    glm::vec2 viewport; // pixels of the depth the pyramid was built from
+    uint32_t phase{0}, job_count{0};
+    uint32_t draw_stride{0}, count_stride{0};
+    uint32_t hiz_levels{0}, _pad{0};
+};
+static_assert(sizeof(InstanceCullConstants) <= 128);
+
+struct HizReduceConstants {
+    glm::ivec2 src_size, dst_size;
+};
+
+// set 0 binding 1 of the mesh shaders, std140
+struct FrameConstants {
+    glm::mat4 clip_from_world;
+};
+
+// the rest of the renderables' components are in components.hpp
+struct Material {
     vk::Pipeline pipeline{};
     vk::PipelineLayout pipeline_layout{};
-    vk::DescriptorSet material_descriptor{};
-    uint32_t mesh_idx{0};
-    gpu_index_t instance_id{-1};
+    vk::DescriptorSet descriptor{};
+    // owned by the material, given back when its instance is removed
+    vk::DescriptorPool descriptor_pool{};
+    Handle<Texture> texture{};
+};
+// ecs_bench stands in for it with integers in place of the vulkan handles, keep the two the same size
+static_assert(sizeof(Material) == 4 * sizeof(uint64_t) + sizeof(Handle<Texture>));
+
+// how many frames the cpu may record ahead of the gpu, and how the swapchain presents. more frames in flight or
+// images overlap more work at the cost of latency
+struct RendererSettings {
+    uint32_t frames_in_flight{2};
+    // clamped to what the surface allows
+    uint32_t swapchain_images{3};
+    // fifo when the surface doesn't support it
+    vk::PresentModeKHR present_mode{vk::PresentModeKHR::eFifo};
+    // how many submitted frames the gpu may not be done with when the next one starts, up to frames_in_flight. 1 keeps
+    // the gpu idle while the cpu records
+    uint32_t queue_depth{2};
+    // waits for the presentation of the frame queue_depth back when the device can, and delays the input sampling
+    // until just before the gpu is predicted to run out of work, see FramePacer
+    bool low_latency{false};
+    // fraction of the game viewport's size the scene is rendered at, from 0.25 to 1. the most dynamic resolution goes to
+    float render_scale{1.0f};
+    // lowers the render scale, down to min_render_scale, while the gpu takes longer than gpu_budget_ms for a frame.
+    // needs timestamps on the graphics queue
+    bool dynamic_resolution{false};
+    float min_render_scale{0.5f};
+    float gpu_budget_ms{16.0f};
+};
+
+// replaced by resize_viewport. the frames in flight still render to and show the old game image and cull with the old
+// pyramid, so they're destroyed once `frame` is done, the same as a RetiredSwapchain
+struct RetiredViewportTargets {
+    vk::Image game_image;
+    vk::ImageView game_image_view;
+    VmaAllocation game_image_alloc;
+    void *game_im_txt_id;
+    vk::Image hiz_image;
+    VmaAllocation hiz_alloc;
+    vk::ImageView hiz_view;
+    std::vector<vk::ImageView> hiz_level_views;
+    uint64_t frame{0};
 };
 
 struct RendererUIObjects {
+    // the viewport targets grow in steps of this many pixels
+    static constexpr uint32_t VIEWPORT_TARGET_STEP = 256;
+
     vk::Pipeline pipeline;
     vk::DescriptorPool descpool;
+    // the size of the game image, the scene image, the depth and the depth pyramid's base. the viewport is the top
+    // left of them, the scene is rendered to the top left of that. the scene image and the depth are the render graph's
+    vk::Extent2D target_extent;
+    // shown in the game window. the scene is rendered straight into it at full resolution, otherwise blitted up from the scene image
     vk::Image game_image;
     vk::ImageView game_image_view;
     VmaAllocation game_image_alloc;
     VmaAllocationInfo game_image_alloci;
+    RenderGraphState game_image_state;
     vk::Sampler sampler;
     void *game_im_txt_id;
+    std::vector<RetiredViewportTargets> retired_targets;
+    // sampled by the depth pyramid reduction
+    vk::Format depth_format{vk::Format::eUndefined};
+};
+
+// per frame, the culling shader turns the meshlets of every instance's current level of detail into compacted
+// indirect draws, which are then drawn with drawIndexedIndirectCount, one call per instance
+struct RendererCullObjects {
+    static constexpr uint32_t GROUP_SIZE = 64; // meshlets per job, local_size_x of meshlet_cull.comp
+    static constexpr uint32_t MAX_DRAWS = 1 << 16; // instances past this many meshlets are drawn whole
+    static constexpr uint32_t MAX_INSTANCES = 1 << 12;
+    static constexpr uint32_t MAX_JOBS = MAX_DRAWS / GROUP_SIZE + MAX_INSTANCES;
+
+    vk::Pipeline pipeline;
+    vk::PipelineLayout pipeline_layout;
+    vk::DescriptorPool descpool;
+};
+
+// two phase occlusion culling of the visible instances, see instance_cull.comp. instances drawn whole are batched per mesh
+// and pipeline and drawn with drawIndexedIndirectCount, for the rest cull_meshlets reads which phases they're drawn in.
+// the depth pyramid is made from the depth after the first phase and then used by the second and the next frame's first.
+struct RendererOcclusionObjects {
+    static constexpr uint32_t GROUP_SIZE = 64; // local_size_x of instance_cull.comp
+    static constexpr uint32_t MAX_INSTANCES = 1 << 14; // instances with a higher instance_id aren't occlusion culled
+    static constexpr uint32_t MAX_HIZ_LEVELS = 16; // of a pyramid over a 64k wide target
+
+    vk::Pipeline pipeline, reduce_pipeline;
+    vk::PipelineLayout pipeline_layout, reduce_pipeline_layout;
+    vk::DescriptorPool descpool;
+    Handle<Buffer> visibility; // per instance, kept across frames
+    RenderGraphState visibility_state;
+    // half the size of the depth, down to 1x1. in the general layout once it's cleared
+    vk::Image hiz_image;
+    VmaAllocation hiz_alloc;
+    vk::ImageView hiz_view;
+    std::vector<vk::ImageView> hiz_level_views;
+    RenderGraphState hiz_state;
+    // bumped by create_hiz. the frames in flight read the old pyramid, each rewrites its own descriptors once it's free
+    uint64_t hiz_version{0};
+    vk::Sampler hiz_sampler;
+    vk::Extent2D hiz_extent;
+    // the render extent of the depth the pyramid was last built from. the next frame's first phase projects with it,
+    // the render extent may have changed since
+    vk::Extent2D built_extent;
+    uint32_t hiz_levels{0};
+    bool cleared{false}; // the pyramid and visibility, on first use
 };
 
 class Renderer {
 public:
-    Renderer(Window *window);
+    explicit Renderer(Window *window, const RendererSettings &settings = {});
     ~Renderer() noexcept;
+    // blocks until the next frame may start, the input should be polled right after
+    void wait_for_frame();
     void update();
-    void add_object(const Model *model);
+    // the renderer keeps the geometry from then on, the meshes' GpuMesh::original point into it
+    const Geometry* add_geometry(Geometry &&geometry);
+    // model.geometry has to outlive the renderer, which is the case for what add_geometry returns
+    void add_object(const Model &model);
+    // at the start of the next update(). its texture is released and its material's descriptors are destroyed once
+    // the frames in flight are done with them, its scene nodes once no other instance is placed by them
+    void remove_instance(Entity entity);
 
     bool is_properly_initialized() const { return _is_properly_initialized; }
 
 private:
     [[nodiscard]] bool initialize_vulkan();
     [[nodiscard]] bool create_swapchain();
+    void destroy_retired_swapchains(uint64_t completed_frame);
     [[nodiscard]] bool create_rendering_resources();
     [[nodiscard]] bool create_vma();
     [[nodiscard]] bool initialize_imgui();
+    [[nodiscard]] bool create_meshlet_culling();
+    [[nodiscard]] bool create_occlusion_culling();
+    [[nodiscard]] bool create_hiz();
+    void write_hiz_descriptors(FrameRenderResources &frame);
+    [[nodiscard]] bool create_viewport_targets(vk::Extent2D extent);
+    void retire_viewport_targets();
+    void destroy_retired_viewport_targets(uint64_t completed_frame);
+    void resize_viewport(vk::Extent2D extent);
 
     const std::vector<Shader>* get_or_create_shaders(const std::string &shader_name);
-    void upload_meshes();
+    void update_imports();
+    // the copies are made visible to the draws with the frame's first batch of barriers
+    void upload_meshes(vk::CommandBuffer cmd, BarrierBatch &barriers);
     void upload_mesh_instances();
+    void remove_instances();
+    // pixels_per_unit is how many pixels a world unit covers at a distance of one unit from the eye
+    void select_lods(const glm::vec3 &eye, float pixels_per_unit);
+    void update_transforms(FrameRenderResources &frame);
+    Aabb world_bounds(SceneGraph::Node node, uint32_t mesh_idx) const;
+    void cull_instances(const Frustum &frustum);
+    void pick_instance(const glm::vec2 &ndc);
+    // flies the camera with the right mouse button and wasd/qe while the game image is hovered
+    void control_camera(bool hovered);
+    // a wall of boxes with a grid of boxes behind it, in front of the camera. what's behind is rejected by the occlusion culling
+    void add_occlusion_test_scene();
+    uint32_t prepare_meshlet_culling(FrameRenderResources &frame);
+    uint32_t prepare_occlusion_culling(FrameRenderResources &frame);
+    void cull_meshlets(vk::CommandBuffer cmd, FrameRenderResources &frame, const Frustum &frustum, const glm::vec4 &camera, uint32_t job_count, uint32_t phase);
+    void cull_occlusion(vk::CommandBuffer cmd, FrameRenderResources &frame, const glm::mat4 &clip_from_world, vk::Extent2D viewport, uint32_t job_count, uint32_t phase);
+    void build_hiz(vk::CommandBuffer cmd, BarrierBatch &barriers, FrameRenderResources &frame, vk::ImageView depth, vk::Extent2D viewport);
+    void draw_instances(vk::CommandBuffer cmd, FrameRenderResources &frame, uint32_t phase, vk::Extent2D extent);
+    bool uses_occlusion_culling(uint32_t instance, const MeshRef &ref, const Material &material) const;
     uint32_t get_frame_resource_index(int idx) const { return std::abs(idx % (int)_vk.per_frame_render_data.size()); }
     FrameRenderResources& get_frame_resources();
 
     Window *window{nullptr};
+    // frames_in_flight is fixed once the renderer exists, the swapchain's are applied by recreating it
+    RendererSettings settings;
+    bool swapchain_outdated{false};
+    FramePacer pacer;
+    // pixels of the game window, and the part of them the last frame rendered the scene to
+    vk::Extent2D viewport_extent{1, 1}, render_extent{1, 1};
+    DynamicResolution resolution;
     VulkanObjects _vk;
     RendererUIObjects _ui;
+    RendererCullObjects _cull;
+    RendererOcclusionObjects _occlusion;
     std::unique_ptr<BufferManager> buffer_mgr;
+    // what's written anew every frame, a region per frame in flight
+    static constexpr size_t UPLOAD_RING_REGION_SIZE = 1 << 20;
+    UploadRing upload_ring;
+    // the transients of the frames' render graphs
+    RenderGraphCache graph_cache;
+    RenderGraphStats graph_stats; // of the last frame
+    BarrierBatch::Stats barrier_stats; // of the last frame, the graph's and those recorded by its passes
     std::unique_ptr<TextureManager> texture_mgr;
     std::unique_ptr<PipelineManager> ppmgr;
     std::unordered_map<std::string, std::vector<Shader>> shaders;
+    std::vector<std::unique_ptr<Geometry>> geometries;
     std::vector<GpuMesh> meshes;
     std::vector<size_t> meshes_to_upload;
-    std::vector<MeshInstance> mesh_instances;
-    std::vector<size_t> mesh_instances_to_upload;
+    EntityRegistry registry;
+    // the archetype of Transform, MeshRef, Material, WorldBounds and Visibility, which is what gets drawn. its rows are
+    // what the shaders know as instances (instance_id), sorted by upload_mesh_instances so instances drawn the same way
+    // are next to each other
+    Archetype *renderables{nullptr};
+    // added with only a Transform and MeshRef, the rest is added by upload_mesh_instances
+    std::vector<Entity> entities_to_upload;
+    std::vector<Entity> entities_to_remove;
+    // of removed instances' materials, destroyed once the frame is done
+    std::vector<std::pair<vk::DescriptorPool, uint64_t>> retired_descriptor_pools;
+    // the nodes of every added model's geometry, below a node per model placing all of them
+    SceneGraph scene;
+    // per SceneGraph::Node made by add_object, the instances placed by it or a node below it
+    std::vector<uint32_t> node_instances;
+    // bumped whenever an instance moved or the renderables got reordered
+    uint64_t transforms_version{1};
+    // bumped whenever upload_meshes moved buffer_meshlets into a bigger buffer
+    uint64_t meshlets_version{1};
+    // the WorldBounds of the renderables, the objects are their rows. rebuilt whenever those are sorted
+    Bvh instance_bvh;
+    Camera camera;
+    float camera_speed{2.0f}; // units per second
+    bool camera_framed{false}; // moved to see all instances once the first were added
+    // rows of the renderables inside the frustum this frame, only these get their lod picked and are drawn
+    std::vector<uint32_t> visible_instances;
+    std::vector<uint64_t> visible_instance_mask; // a bit per instance, for putting visible_instances back in order
+    // clicked on in the game window, cleared when the renderables are reordered
+    std::optional<uint32_t> picked_instance;
+    std::vector<std::unique_ptr<ImportJob>> import_jobs;
+    // what imported meshes get cooked into, meshes that stay in SoA form are uploaded with VertexLayout::full()
+    VertexLayout vertex_layout{VertexLayout::compact()};
+    // coarsest level of detail whose error projects to fewer pixels than this is drawn. a level only changes
+    // once the error is off by lod_hysteresis (relative), so instances near the threshold don't flicker between two.
+    float lod_pixel_error{1.0f};
+    float lod_hysteresis{0.25f};
+    size_t triangles_drawn{0};
+    // off, or without drawIndirectCount support, every instance is drawn whole
+    bool meshlet_culling{true};
+    size_t meshlets_submitted{0};
+    // off, or when the meshlet culling or the depth pyramid couldn't be set up, everything visible is drawn in one phase
+    bool occlusion_culling{true};
+    size_t instances_occlusion_tested{0};
+    size_t instances_occluded{0}; // by the second phase, of the frame frames_in_flight frames ago
+    uint64_t frame_allocations{0}; // heap allocations of the last update(), counted with ENG_COUNT_ALLOCATIONS
     bool _is_properly_initialized = false;
 };
 
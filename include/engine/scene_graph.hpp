@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace eng {
+
+// Transform hierarchy. The nodes live in arrays per attribute (parent, local and world matrix, flags) sorted by their
+// depth, so update() goes through the levels front to back with every parent's world matrix already done, and a
+// wide level can be split over the cores. set_local() only flags the node, update() then recomputes the flagged nodes
+// and everything below them; levels with nothing flagged and no changed parents are skipped whole.
+class SceneGraph {
+public:
+    using Node = uint32_t; // stays the same while the node exists, unlike where its attributes are
+    static constexpr Node NO_NODE = ~0u;
+    // levels with more nodes than this are split into chunks of this size on all cores
+    static constexpr size_t PARALLEL_CHUNK = 1 << 12;
+
+    Node create(Node parent, const glm::mat4 &local = glm::mat4{1.0f});
+    // the node's descendants are destroyed by the next update()
+    void destroy(Node node);
+    void set_local(Node node, const glm::mat4 &local);
+
+    bool valid(Node node) const { return node < node_slots.size() && node_slots[node] != NO_NODE; }
+    Node parent(Node node) const;
+    const glm::mat4& local(Node node) const { return locals[node_slots[node]]; }
+    // as of the last update()
+    const glm::mat4& world(Node node) const { return worlds[node_slots[node]]; }
+    // whether the last update() recomputed the world matrix
+    bool changed(Node node) const { return changed_flags[node_slots[node]] != 0; }
+
+    // returns how many world matrices were recomputed
+    size_t update();
+    size_t size() const { return slot_nodes.size(); }
+    size_t depth() const { return level_begin.empty() ? 0 : level_begin.size() - 1; }
+
+private:
+    // puts the slots back in order of depth, dropping the destroyed ones and everything below them
+    void sort_by_depth();
+
+    // per slot, sorted by depth unless `unsorted`. parents are slots as well
+    std::vector<uint32_t> parents, depths;
+    std::vector<glm::mat4> locals, worlds;
+    std::vector<uint8_t> dirty_flags, changed_flags, destroyed_flags;
+    std::vector<Node> slot_nodes;
+    // first slot of every depth plus the end, and how many world matrices of each changed the last time
+    std::vector<uint32_t> level_begin, level_changed;
+    std::vector<uint32_t> level_dirty; // flagged since the last update
+    bool unsorted{false};
+
+    std::vector<uint32_t> node_slots; // NO_NODE for ids that are free
+    std::vector<Node> free_nodes;
+};
+
+}
\ No newline at end of file
@@ -5,13 +5,11 @@
 #include <filesystem>
 #include <map>
 
-#include <engine/handle.hpp>
-
 #include <vulkan/vulkan.hpp>
 
 namespace eng {
 
-enum class ShaderType { None, Vertex, Fragment, };
+enum class ShaderType { None, Vertex, Fragment, Compute, };
 
 struct ShaderInterfaceVariable {
     uint32_t location, vecsize;
@@ -41,7 +39,7 @@ struct ShaderResources {
     vk::PushConstantRange push_constants; 
 };
 
-class Shader : public Handle<Shader> {
+class Shader {
 public:
     Shader(vk::Device device, std::filesystem::path file_path);
 
@@ -51,6 +49,8 @@ public:
                 return vk::ShaderStageFlagBits::eVertex;
             case ShaderType::Fragment:
                 return vk::ShaderStageFlagBits::eFragment;
+            case ShaderType::Compute:
+                return vk::ShaderStageFlagBits::eCompute;
             default:
                 assert(false && "Conversion from ShaderType to VkShaderStage not implemented.");
         }
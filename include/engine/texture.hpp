@@ -1,6 +1,6 @@
 #pragma once
 
-#include <engine/handle.hpp>
+#include <engine/handle_pool.hpp>
 
 #include <unordered_map>
 #include <filesystem>
@@ -13,9 +13,9 @@ namespace eng {
 class BufferManager;
 class Queue;
 
-struct Texture : public Handle<Texture> {
+struct Texture {
     Texture(vk::Image image, vk::Format format, vk::ImageLayout current_layout, vk::ImageUsageFlags usage, std::vector<uint32_t> owning_queue_families, VmaAllocation allocation) noexcept 
-        : Handle(GENERATE_HANDLE), image(image), format(format), current_layout(current_layout), usage(usage), owning_queue_families(owning_queue_families), allocation(allocation) {}
+        : image(image), format(format), current_layout(current_layout), usage(usage), owning_queue_families(owning_queue_families), allocation(allocation) {}
     Texture(const Texture&) = delete;
     Texture& operator=(const Texture&) = delete;
     Texture(Texture &&other) noexcept;
@@ -27,34 +27,49 @@ struct Texture : public Handle<Texture> {
     vk::ImageUsageFlags usage{};
     std::vector<uint32_t> owning_queue_families;
     VmaAllocation allocation{};
+    std::vector<vk::ImageView> views;
+    uint32_t refcount{0};
+    uint64_t last_release{0}; // the latest frame any of its holders said it may still be used in
 };
 
 class TextureManager {
 public:
-    TextureManager(vk::Device device, BufferManager *buffer_mgr, VmaAllocator allocator) noexcept;
+    TextureManager(vk::PhysicalDevice physical_device, vk::Device device, BufferManager *buffer_mgr, VmaAllocator allocator) noexcept;
     TextureManager(const TextureManager&) = delete;
     TextureManager& operator=(const TextureManager&) = delete;
     TextureManager(TextureManager &&other) noexcept;
     TextureManager& operator=(TextureManager &&other) noexcept;
-    ~TextureManager() noexcept = default;
+    ~TextureManager() noexcept;
 
     Handle<Texture> allocate() const;
+    // Every successful call holds a reference that must be given back with release().
+    // Textures are deduplicated by path, by file contents and by decoded pixels.
+    // A cooked .etex next to the file is loaded instead, if the device supports its format for `image_ci.usage`.
     Handle<Texture> load_from_file(std::filesystem::path file, Queue &queue, vk::CommandBuffer cmd, vk::ImageCreateInfo image_ci);
-    vk::ImageView make_view(Handle<Texture> handle, vk::ImageViewCreateInfo view_ci) const;
+    // Views are owned by the texture and destroyed together with it.
+    vk::ImageView make_view(Handle<Texture> handle, vk::ImageViewCreateInfo view_ci);
     vk::Image get(Handle<Texture> handle) const; 
+    Handle<Texture> acquire(Handle<Texture> handle);
+    // `frame` is the last frame that may still use the texture on the gpu.
+    void release(Handle<Texture> handle, uint64_t frame);
+    // Destroys the textures nothing holds anymore whose latest release is at or before `completed_frame`.
+    void evict(uint64_t completed_frame);
 
 private:
-    static void layout_transition(vk::CommandBuffer cmd, auto img, auto old_layout, auto new_layout, auto src_stage, auto src_access, auto dst_stage, auto dst_access, auto subresource) {
-        vk::ImageMemoryBarrier img_barrier;
-        img_barrier.setImage(img).setSrcAccessMask(src_access).setDstAccessMask(dst_access).setOldLayout(old_layout).setNewLayout(new_layout).setSubresourceRange(subresource);
-        cmd.pipelineBarrier(src_stage, dst_stage, {}, {}, {}, img_barrier);
-    };
+    void _destroy(Texture &texture);
+    // optimal tiling images of the format can be created for the usage
+    bool _supports(vk::Format format, vk::ImageUsageFlags usage) const;
+    bool _supports_cooked(const std::filesystem::path &cooked_file, vk::ImageUsageFlags usage) const;
 
+    vk::PhysicalDevice physical_device;
     vk::Device device;
     BufferManager *buffer_mgr{};
     VmaAllocator allocator{};
-    std::unordered_map<Handle<Texture>, Texture> textures;
+    HandlePool<Texture> textures;
     std::unordered_map<std::string, Handle<Texture>> texture_paths;
+    std::unordered_map<uint64_t, Handle<Texture>> texture_hashes;
+    // refcount went to 0, unless they were acquired again since
+    std::vector<Handle<Texture>> released;
 };
 
 }
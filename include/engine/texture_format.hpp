@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <vector>
+
+namespace eng {
+
+// Cooked texture container (.etex), written by the texture_cooker tool.
+// Layout: CookedTextureHeader | CookedTextureLevel[mip_count] | level data
+// Level data is already laid out the way vkCmdCopyBufferToImage expects it,
+// so loading is a single memcpy into a staging buffer.
+enum class CookedTextureFormat : uint32_t {
+    None, RGBA8, BC1, BC3, BC5, BC7
+};
+
+struct CookedTextureHeader {
+    static constexpr uint32_t MAGIC = 0x58455445; // "ETEX"
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t magic{MAGIC};
+    uint32_t version{VERSION};
+    CookedTextureFormat format{CookedTextureFormat::None};
+    uint32_t srgb{0};
+    uint32_t width{0}, height{0};
+    uint32_t mip_count{0};
+    uint32_t reserved{0};
+};
+
+struct CookedTextureLevel {
+    uint64_t offset{0}; // relative to the start of the level data
+    uint64_t size{0};
+    uint32_t width{0}, height{0};
+};
+
+struct CookedTexture {
+    CookedTextureHeader header;
+    std::vector<CookedTextureLevel> levels;
+    std::span<const std::byte> data;
+};
+
+inline constexpr uint32_t cooked_texture_block_size(CookedTextureFormat format) {
+    switch(format) {
+        case CookedTextureFormat::BC1: return 8;
+        case CookedTextureFormat::BC3:
+        case CookedTextureFormat::BC5:
+        case CookedTextureFormat::BC7: return 16;
+        default: return 0;
+    }
+}
+
+inline constexpr uint64_t cooked_texture_level_size(CookedTextureFormat format, uint32_t width, uint32_t height) {
+    if(format == CookedTextureFormat::RGBA8) { return (uint64_t)width * height * 4; }
+    return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * cooked_texture_block_size(format);
+}
+
+// Returns false if the file is not a valid .etex container. On success, `out.data` points into `file`.
+inline bool parse_cooked_texture(std::span<const std::byte> file, CookedTexture &out) {
+    if(file.size() < sizeof(CookedTextureHeader)) { return false; }
+    memcpy(&out.header, file.data(), sizeof(CookedTextureHeader));
+    if(out.header.magic != CookedTextureHeader::MAGIC || out.header.version != CookedTextureHeader::VERSION) { return false; }
+    if(out.header.mip_count == 0 || cooked_texture_level_size(out.header.format, 1, 1) == 0) { return false; }
+
+    const auto levels_size = sizeof(CookedTextureLevel) * out.header.mip_count;
+    if(file.size() < sizeof(CookedTextureHeader) + levels_size) { return false; }
+    out.levels.resize(out.header.mip_count);
+    memcpy(out.levels.data(), file.data() + sizeof(CookedTextureHeader), levels_size);
+
+    out.data = file.subspan(sizeof(CookedTextureHeader) + levels_size);
+    for(const auto &l : out.levels) {
+        if(l.offset + l.size > out.data.size()) { return false; }
+        if(l.size != cooked_texture_level_size(out.header.format, l.width, l.height)) { return false; }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <engine/buffer.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+#include <vulkan/vulkan.hpp>
+
+namespace eng {
+
+// a piece of an UploadRing, written through `data` and bound with `offset` as the dynamic offset
+struct UploadAllocation {
+    explicit operator bool() const { return data != nullptr; }
+
+    vk::Buffer buffer{};
+    uint32_t offset{0};
+    uint32_t size{0};
+    std::byte *data{nullptr};
+};
+
+// One persistently mapped buffer for what changes every frame, split into a region per frame in flight. A frame
+// bumps through its region and begin_frame() starts the region over once the gpu is done with the frame that used
+// it last, so streaming something is a memcpy and binding it a dynamic offset, without allocating or submitting
+// anything. The memory is device local when the device lets the host write to it (resizable BAR), host memory otherwise.
+class UploadRing {
+public:
+    // alignment is what every allocation is aligned to at least, the device's min offset alignment of the buffer usages
+    bool create(BufferManager &buffers, vk::BufferUsageFlags usage, size_t region_size, uint32_t region_count, size_t alignment);
+
+    // `region` must not be read by the gpu anymore
+    void begin_frame(uint32_t region);
+    // nothing when the region is full. a dynamic descriptor bound at the offset can't have a larger range than `size`
+    UploadAllocation allocate(size_t size, size_t alignment = 1);
+    template<typename T> UploadAllocation push(std::span<const T> values) {
+        static_assert(std::is_trivially_copyable_v<T>, "uploads are memcpy'd");
+        const auto allocation = allocate(values.size_bytes(), alignof(T));
+        if(allocation) { std::memcpy(allocation.data, values.data(), values.size_bytes()); }
+        return allocation;
+    }
+    template<typename T> UploadAllocation push(const T &value) { return push(std::span<const T>{&value, 1}); }
+    // makes the frame's writes visible to the device when the memory isn't host coherent. before the frame is submitted
+    void flush() const;
+
+    vk::Buffer buffer() const { return _buffer; }
+    size_t region_size() const { return _region_size; }
+    // of the current region
+    size_t used() const { return _offset - _region_begin; }
+    bool device_local() const { return _device_local; }
+
+private:
+    BufferManager *_buffers{nullptr};
+    Handle<Buffer> _handle;
+    vk::Buffer _buffer{};
+    std::byte *_mapped{nullptr};
+    size_t _region_size{0}, _alignment{1};
+    uint32_t _region_count{0};
+    size_t _region_begin{0}, _offset{0};
+    bool _device_local{false};
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace eng {
+
+enum class VertexAttributeFormat : uint8_t {
+    None, Float2, Float3, Half2, Unorm16x2, Unorm16x4, Snorm8x2, Snorm16x2
+};
+
+inline constexpr uint32_t vertex_attribute_size(VertexAttributeFormat format) {
+    switch(format) {
+        case VertexAttributeFormat::Float2: return 8;
+        case VertexAttributeFormat::Float3: return 12;
+        case VertexAttributeFormat::Half2: return 4;
+        case VertexAttributeFormat::Unorm16x2: return 4;
+        case VertexAttributeFormat::Unorm16x4: return 8;
+        case VertexAttributeFormat::Snorm8x2: return 2;
+        case VertexAttributeFormat::Snorm16x2: return 4;
+        default: return 0;
+    }
+}
+
+// Vertex attributes in the order of their shader input locations.
+// Quantized positions are unorm16 within the mesh's bounding box (the 4th component is padding),
+// snorm normals are octahedral encoded and unorm16 texture coords are relative to the mesh's uv bounds.
+// Shaders undo all of that with the VertexDecode push constants.
+struct VertexLayout {
+    enum Location : uint32_t { Position, Normal, TextureCoords, LocationCount };
+
+    static constexpr VertexLayout make(VertexAttributeFormat position, VertexAttributeFormat normal, VertexAttributeFormat texture_coords) {
+        VertexLayout layout;
+        layout.formats = {position, normal, texture_coords};
+        uint32_t offset = 0;
+        for(auto i=0u; i<LocationCount; ++i) {
+            layout.offsets[i] = offset;
+            offset += vertex_attribute_size(layout.formats[i]);
+        }
+        // keeps every vertex 4 byte aligned
+        layout.stride = (offset + 3) / 4 * 4;
+        return layout;
+    }
+    static constexpr VertexLayout full() { return make(VertexAttributeFormat::Float3, VertexAttributeFormat::Float3, VertexAttributeFormat::Float2); }
+    static constexpr VertexLayout compact() { return make(VertexAttributeFormat::Unorm16x4, VertexAttributeFormat::Snorm16x2, VertexAttributeFormat::Half2); }
+
+    constexpr bool empty() const { return stride == 0; }
+    // whether every attribute uses a format VertexPacker can write and the shaders can decode
+    constexpr bool valid() const {
+        using enum VertexAttributeFormat;
+        const auto p = formats[Position], n = formats[Normal], t = formats[TextureCoords];
+        return (p == Float3 || p == Unorm16x4)
+            && (n == Float3 || n == Snorm8x2 || n == Snorm16x2)
+            && (t == Float2 || t == Half2 || t == Unorm16x2);
+    }
+    constexpr bool operator==(const VertexLayout&) const = default;
+
+    std::array<VertexAttributeFormat, LocationCount> formats{};
+    std::array<uint32_t, LocationCount> offsets{};
+    uint32_t stride{0};
+};
+
+// per mesh ranges the quantized attributes are relative to
+struct VertexBounds {
+    glm::vec3 position_min{0.0f}, position_max{0.0f};
+    glm::vec2 uv_min{0.0f}, uv_max{0.0f};
+};
+
+// push constants every mesh vertex shader starts with, see decode_* in the shaders
+struct VertexDecode {
+    static VertexDecode make(const VertexLayout &layout, const VertexBounds &bounds) {
+        VertexDecode decode;
+        if(layout.formats[VertexLayout::Position] == VertexAttributeFormat::Unorm16x4) {
+            decode.position_scale = bounds.position_max - bounds.position_min;
+            decode.position_offset = bounds.position_min;
+        }
+        const auto normal = layout.formats[VertexLayout::Normal];
+        decode.octahedral_normals = normal == VertexAttributeFormat::Snorm8x2 || normal == VertexAttributeFormat::Snorm16x2;
+        if(layout.formats[VertexLayout::TextureCoords] == VertexAttributeFormat::Unorm16x2) {
+            decode.uv_scale = bounds.uv_max - bounds.uv_min;
+            decode.uv_offset = bounds.uv_min;
+        }
+        return decode;
+    }
+
+    glm::vec3 position_scale{1.0f};
+    uint32_t octahedral_normals{0};
+    glm::vec3 position_offset{0.0f};
+    uint32_t _pad{0};
+    glm::vec2 uv_scale{1.0f}, uv_offset{0.0f};
+};
+static_assert(sizeof(VertexDecode) == 48);
+
+}
\ No newline at end of file
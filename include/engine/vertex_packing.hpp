@@ -0,0 +1,42 @@
+#pragma once
+
+#include <engine/model.hpp>
+#include <engine/vertex_layout.hpp>
+
+#include <cstddef>
+
+namespace eng {
+
+// Source arrays of one mesh. normals and texture_coords may be null, those attributes are then written as zeros.
+struct VertexStreams {
+    const glm::vec3 *positions{};
+    const glm::vec3 *normals{};
+    const glm::vec2 *texture_coords{};
+    size_t count{0};
+};
+
+// Interleaves separate vertex attribute arrays into a VertexLayout.
+// `dst` can be (and is meant to be) uncached, mapped staging memory: every kernel only ever writes to it,
+// and whole vertices at a time.
+class VertexPacker {
+public:
+    enum class Kernel : uint8_t { Scalar, SSE, AVX2 };
+
+    static VertexStreams streams(const Mesh &mesh);
+    static VertexBounds compute_bounds(const VertexStreams &src);
+
+    // the full layout goes through the simd kernels, quantized layouts through pack_quantized
+    static void pack(const VertexStreams &src, const VertexLayout &layout, const VertexBounds &bounds, std::byte *dst);
+    static void pack_quantized(const VertexStreams &src, const VertexLayout &layout, const VertexBounds &bounds, std::byte *dst);
+
+    // full layout only, uses the widest kernel the cpu supports
+    static void pack(const VertexStreams &src, std::byte *dst);
+    static void pack(Kernel kernel, const VertexStreams &src, std::byte *dst);
+    static Kernel best_kernel();
+
+    static void pack_scalar(const VertexStreams &src, std::byte *dst);
+    static void pack_sse(const VertexStreams &src, std::byte *dst);
+    static void pack_avx2(const VertexStreams &src, std::byte *dst);
+};
+
+}
\ No newline at end of file
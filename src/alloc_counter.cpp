@@ -0,0 +1,82 @@
+#include <engine/alloc_counter.hpp>
+
+#ifdef ENG_COUNT_ALLOCATIONS
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+    std::atomic_uint64_t allocation_count{0};
+
+    void* counted_alloc(std::size_t size) {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void* counted_alloc(std::size_t size, std::align_val_t alignment) {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        const auto align = static_cast<std::size_t>(alignment);
+        #ifdef _WIN32
+            return _aligned_malloc(size == 0 ? 1 : size, align);
+        #else
+            // aligned_alloc wants the size to be a multiple of the alignment
+            return std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align);
+        #endif
+    }
+
+    // what the aligned versions allocated has to go back the same way on windows
+    void aligned_free(void *p) {
+        #ifdef _WIN32
+            _aligned_free(p);
+        #else
+            std::free(p);
+        #endif
+    }
+
+    void* throwing_alloc(std::size_t size) {
+        if(auto *p = counted_alloc(size)) { return p; }
+        throw std::bad_alloc{};
+    }
+
+    void* throwing_alloc(std::size_t size, std::align_val_t alignment) {
+        if(auto *p = counted_alloc(size, alignment)) { return p; }
+        throw std::bad_alloc{};
+    }
+}
+
+void* operator new(std::size_t size) { return throwing_alloc(size); }
+void* operator new[](std::size_t size) { return throwing_alloc(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return throwing_alloc(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return throwing_alloc(size, alignment); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return counted_alloc(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return counted_alloc(size, alignment); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { aligned_free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { aligned_free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { aligned_free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { aligned_free(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t&) noexcept { aligned_free(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t&) noexcept { aligned_free(p); }
+
+namespace eng {
+bool allocation_counting_enabled() { return true; }
+uint64_t heap_allocation_count() { return allocation_count.load(std::memory_order_relaxed); }
+}
+#else
+namespace eng {
+bool allocation_counting_enabled() { return false; }
+uint64_t heap_allocation_count() { return 0; }
+}
+#endif
\ No newline at end of file
@@ -5,8 +5,33 @@ layout(location=1) in vec3 inorm;
 layout(location=2) in vec2 itc;
 
 layout(location=0) out vec2 vtc;
+layout(location=1) out vec3 vnorm;
+
+// world matrix of every instance, the draws pass the instance on as their first instance
+layout(set=0, binding=0) readonly buffer Transforms { mat4 transforms[]; };
+// FrameConstants, streamed through the upload ring every frame
+layout(set=0, binding=1) uniform Frame { mat4 clip_from_world; } frame;
+
+// VertexDecode, undoes the quantization of the mesh's vertex layout
+layout(push_constant) uniform Decode {
+    vec3 position_scale;
+    uint octahedral_normals;
+    vec3 position_offset;
+    uint _pad;
+    vec2 uv_scale;
+    vec2 uv_offset;
+} decode;
+
+vec3 decode_octahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if(n.z < 0.0) { n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0); }
+    return normalize(n);
+}
 
 void main() {
-    vtc = itc;
-    gl_Position = vec4(ipos.xy, 0.0, 1.0);
+    vtc = itc * decode.uv_scale + decode.uv_offset;
+    vnorm = decode.octahedral_normals != 0 ? decode_octahedral(inorm.xy) : inorm;
+    const vec3 pos = ipos * decode.position_scale + decode.position_offset;
+    const vec4 world = transforms[gl_InstanceIndex] * vec4(pos, 1.0);
+    gl_Position = frame.clip_from_world * world;
 }
@@ -2,8 +2,25 @@
 
 layout(location=0) in vec3 in_pos;
 
+// world matrix of every instance, the draws pass the instance on as their first instance
+layout(set=0, binding=0) readonly buffer Transforms { mat4 transforms[]; };
+// FrameConstants, streamed through the upload ring every frame
+layout(set=0, binding=1) uniform Frame { mat4 clip_from_world; } frame;
+
+// VertexDecode, undoes the position quantization
+layout(push_constant) uniform Decode {
+    vec3 position_scale;
+    uint octahedral_normals;
+    vec3 position_offset;
+    uint _pad;
+    vec2 uv_scale;
+    vec2 uv_offset;
+} decode;
+
 void main() {
+    const vec3 pos = in_pos * decode.position_scale + decode.position_offset;
 
-    gl_Position = vec4(in_pos.xy, 0.0, 1.0);
+    const vec4 world = transforms[gl_InstanceIndex] * vec4(pos, 1.0);
+    gl_Position = frame.clip_from_world * world;
 
 }
\ No newline at end of file
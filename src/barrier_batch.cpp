@@ -0,0 +1,93 @@
+#include <engine/barrier_batch.hpp>
+
+#include <algorithm>
+
+namespace eng {
+
+namespace {
+    bool same_range(const vk::ImageSubresourceRange &a, const vk::ImageSubresourceRange &b) {
+        return a.aspectMask == b.aspectMask && a.baseMipLevel == b.baseMipLevel && a.levelCount == b.levelCount
+            && a.baseArrayLayer == b.baseArrayLayer && a.layerCount == b.layerCount;
+    }
+    // VK_REMAINING_* counts are ~0u, which reaches to the end anyway
+    bool overlap(uint32_t a_base, uint32_t a_count, uint32_t b_base, uint32_t b_count) {
+        const auto a_end = a_count > ~0u - a_base ? ~0u : a_base + a_count;
+        const auto b_end = b_count > ~0u - b_base ? ~0u : b_base + b_count;
+        return a_base < b_end && b_base < a_end;
+    }
+    bool overlap(const vk::ImageSubresourceRange &a, const vk::ImageSubresourceRange &b) {
+        return !!(a.aspectMask & b.aspectMask) && overlap(a.baseMipLevel, a.levelCount, b.baseMipLevel, b.levelCount)
+            && overlap(a.baseArrayLayer, a.layerCount, b.baseArrayLayer, b.layerCount);
+    }
+}
+
+BarrierBatch::BarrierBatch(vk::CommandBuffer cmd, std::pmr::memory_resource *resource) : _cmd{cmd}, _images{resource}, _buffers{resource} { }
+
+void BarrierBatch::image(const vk::ImageMemoryBarrier2 &barrier) {
+    const auto mergeable = std::find_if(_images.begin(), _images.end(), [&](const vk::ImageMemoryBarrier2 &b) {
+        return b.image == barrier.image && same_range(b.subresourceRange, barrier.subresourceRange) && b.oldLayout == barrier.oldLayout
+            && b.newLayout == barrier.newLayout && b.srcQueueFamilyIndex == barrier.srcQueueFamilyIndex && b.dstQueueFamilyIndex == barrier.dstQueueFamilyIndex;
+    });
+    if(mergeable != _images.end()) {
+        mergeable->srcStageMask |= barrier.srcStageMask;
+        mergeable->srcAccessMask |= barrier.srcAccessMask;
+        mergeable->dstStageMask |= barrier.dstStageMask;
+        mergeable->dstAccessMask |= barrier.dstAccessMask;
+        ++_stats.merged;
+        return;
+    }
+    // barriers in one call aren't ordered, a second transition of the same texels would race the first
+    const auto transitions = [](const vk::ImageMemoryBarrier2 &b) { return b.oldLayout != b.newLayout; };
+    const auto conflict = std::any_of(_images.begin(), _images.end(), [&](const vk::ImageMemoryBarrier2 &b) {
+        return b.image == barrier.image && overlap(b.subresourceRange, barrier.subresourceRange) && (transitions(b) || transitions(barrier));
+    });
+    if(conflict) { flush(); }
+    _images.push_back(barrier);
+}
+
+void BarrierBatch::buffer(const vk::BufferMemoryBarrier2 &barrier) {
+    const auto pending = std::find_if(_buffers.begin(), _buffers.end(), [&](const vk::BufferMemoryBarrier2 &b) {
+        return b.buffer == barrier.buffer && b.offset == barrier.offset && b.size == barrier.size
+            && b.srcQueueFamilyIndex == barrier.srcQueueFamilyIndex && b.dstQueueFamilyIndex == barrier.dstQueueFamilyIndex;
+    });
+    if(pending == _buffers.end()) {
+        _buffers.push_back(barrier);
+        return;
+    }
+    pending->srcStageMask |= barrier.srcStageMask;
+    pending->srcAccessMask |= barrier.srcAccessMask;
+    pending->dstStageMask |= barrier.dstStageMask;
+    pending->dstAccessMask |= barrier.dstAccessMask;
+    ++_stats.merged;
+}
+
+void BarrierBatch::memory(const vk::MemoryBarrier2 &barrier) {
+    if(!_has_memory) {
+        _memory = barrier;
+        _has_memory = true;
+        return;
+    }
+    _memory.srcStageMask |= barrier.srcStageMask;
+    _memory.srcAccessMask |= barrier.srcAccessMask;
+    _memory.dstStageMask |= barrier.dstStageMask;
+    _memory.dstAccessMask |= barrier.dstAccessMask;
+    ++_stats.merged;
+}
+
+void BarrierBatch::flush() {
+    if(empty()) { return; }
+    const auto dependency = vk::DependencyInfo{}
+        .setMemoryBarrierCount(_has_memory ? 1 : 0).setPMemoryBarriers(&_memory)
+        .setImageMemoryBarrierCount((uint32_t)_images.size()).setPImageMemoryBarriers(_images.data())
+        .setBufferMemoryBarrierCount((uint32_t)_buffers.size()).setPBufferMemoryBarriers(_buffers.data());
+    _cmd.pipelineBarrier2(dependency);
+    ++_stats.flushes;
+    _stats.image_barriers += (uint32_t)_images.size();
+    _stats.buffer_barriers += (uint32_t)_buffers.size();
+    _stats.memory_barriers += _has_memory ? 1 : 0;
+    _images.clear();
+    _buffers.clear();
+    _has_memory = false;
+}
+
+}
\ No newline at end of file
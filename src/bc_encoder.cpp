@@ -0,0 +1,265 @@
+#include <engine/bc_encoder.hpp>
+
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace eng {
+
+namespace {
+
+// principal axis of the block's colors, found with a few power iterations on the covariance matrix.
+template<int CH> std::array<float, CH> principal_axis(const uint8_t *rgba, std::array<float, CH> &mean) {
+    mean.fill(0.0f);
+    for(int i=0; i<16; ++i) {
+        for(int c=0; c<CH; ++c) { mean[c] += rgba[i*4 + c]; }
+    }
+    for(auto &m : mean) { m /= 16.0f; }
+
+    float cov[CH][CH]{};
+    for(int i=0; i<16; ++i) {
+        for(int a=0; a<CH; ++a) {
+            for(int b=0; b<CH; ++b) {
+                cov[a][b] += (rgba[i*4 + a] - mean[a]) * (rgba[i*4 + b] - mean[b]);
+            }
+        }
+    }
+
+    std::array<float, CH> axis;
+    axis.fill(1.0f);
+    for(int it=0; it<8; ++it) {
+        std::array<float, CH> next{};
+        for(int a=0; a<CH; ++a) {
+            for(int b=0; b<CH; ++b) { next[a] += cov[a][b] * axis[b]; }
+        }
+        float len = 0.0f;
+        for(auto v : next) { len += v*v; }
+        if(len < 1e-12f) { break; }
+        len = std::sqrt(len);
+        for(int a=0; a<CH; ++a) { axis[a] = next[a] / len; }
+    }
+    return axis;
+}
+
+// endpoints at the extremes of the block projected onto its principal axis.
+template<int CH> void principal_endpoints(const uint8_t *rgba, std::array<float, CH> &e0, std::array<float, CH> &e1) {
+    std::array<float, CH> mean;
+    const auto axis = principal_axis<CH>(rgba, mean);
+
+    float tmin = 1e30f, tmax = -1e30f;
+    for(int i=0; i<16; ++i) {
+        float t = 0.0f;
+        for(int c=0; c<CH; ++c) { t += (rgba[i*4 + c] - mean[c]) * axis[c]; }
+        tmin = std::min(tmin, t);
+        tmax = std::max(tmax, t);
+    }
+    for(int c=0; c<CH; ++c) {
+        e0[c] = std::clamp(mean[c] + axis[c] * tmin, 0.0f, 255.0f);
+        e1[c] = std::clamp(mean[c] + axis[c] * tmax, 0.0f, 255.0f);
+    }
+}
+
+uint16_t to_565(const std::array<float, 3> &c) {
+    const auto r = (uint16_t)std::lround(c[0] * 31.0f / 255.0f);
+    const auto g = (uint16_t)std::lround(c[1] * 63.0f / 255.0f);
+    const auto b = (uint16_t)std::lround(c[2] * 31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+std::array<int, 3> from_565(uint16_t c) {
+    const int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+}
+
+int distance_sq(const uint8_t *texel, const int *color, int channels) {
+    int d = 0;
+    for(int c=0; c<channels; ++c) {
+        const int diff = texel[c] - color[c];
+        d += diff * diff;
+    }
+    return d;
+}
+
+// little-endian bit writer for the 128-bit BC7 block
+struct BitWriter {
+    void write(uint32_t value, uint32_t bits) {
+        for(uint32_t i=0; i<bits; ++i, ++pos) {
+            if(value & (1u << i)) { out[pos / 8] |= (uint8_t)(1u << (pos % 8)); }
+        }
+    }
+    uint8_t *out;
+    uint32_t pos{0};
+};
+
+}
+
+void BCEncoder::encode_bc1(const uint8_t *rgba, uint8_t *out) {
+    std::array<float, 3> e0, e1;
+    principal_endpoints<3>(rgba, e0, e1);
+
+    uint16_t c0 = to_565(e1), c1 = to_565(e0);
+    if(c0 < c1) { std::swap(c0, c1); }
+
+    uint32_t indices = 0;
+    if(c0 != c1) {
+        // c0 > c1 selects the opaque 4-color mode
+        const auto p0 = from_565(c0), p1 = from_565(c1);
+        int palette[4][3];
+        for(int c=0; c<3; ++c) {
+            palette[0][c] = p0[c];
+            palette[1][c] = p1[c];
+            palette[2][c] = (2*p0[c] + p1[c]) / 3;
+            palette[3][c] = (p0[c] + 2*p1[c]) / 3;
+        }
+        for(int i=0; i<16; ++i) {
+            uint32_t best = 0;
+            int best_d = distance_sq(&rgba[i*4], palette[0], 3);
+            for(uint32_t p=1; p<4; ++p) {
+                if(const int d = distance_sq(&rgba[i*4], palette[p], 3); d < best_d) { best_d = d; best = p; }
+            }
+            indices |= best << (i*2);
+        }
+    }
+
+    memcpy(out + 0, &c0, 2);
+    memcpy(out + 2, &c1, 2);
+    memcpy(out + 4, &indices, 4);
+}
+
+void BCEncoder::_encode_bc4(const uint8_t *rgba, uint32_t channel, uint8_t *out) {
+    uint8_t amin = 255, amax = 0;
+    for(int i=0; i<16; ++i) {
+        amin = std::min(amin, rgba[i*4 + channel]);
+        amax = std::max(amax, rgba[i*4 + channel]);
+    }
+
+    uint64_t indices = 0;
+    if(amax != amin) {
+        // a0 > a1 selects the 8-value mode
+        int palette[8]{amax, amin};
+        for(int p=1; p<7; ++p) { palette[p + 1] = ((7 - p) * amax + p * amin) / 7; }
+        for(int i=0; i<16; ++i) {
+            uint64_t best = 0;
+            int best_d = std::abs(rgba[i*4 + channel] - palette[0]);
+            for(uint64_t p=1; p<8; ++p) {
+                if(const int d = std::abs(rgba[i*4 + channel] - palette[p]); d < best_d) { best_d = d; best = p; }
+            }
+            indices |= best << (i*3);
+        }
+    }
+
+    out[0] = amax;
+    out[1] = amin;
+    for(int i=0; i<6; ++i) { out[2 + i] = (uint8_t)(indices >> (i*8)); }
+}
+
+void BCEncoder::encode_bc3(const uint8_t *rgba, uint8_t *out) {
+    _encode_bc4(rgba, 3, out);
+    encode_bc1(rgba, out + 8);
+}
+
+void BCEncoder::encode_bc5(const uint8_t *rgba, uint8_t *out) {
+    _encode_bc4(rgba, 0, out);
+    _encode_bc4(rgba, 1, out + 8);
+}
+
+void BCEncoder::encode_bc7(const uint8_t *rgba, uint8_t *out) {
+    static constexpr int weights[16]{0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    std::array<float, 4> e[2];
+    principal_endpoints<4>(rgba, e[0], e[1]);
+
+    // mode 6: 7 bits per channel plus one shared p-bit per endpoint
+    uint32_t q[2][4]{}, pbit[2]{};
+    int ep[2][4]{};
+    for(int k=0; k<2; ++k) {
+        float best_err = 1e30f;
+        for(uint32_t p=0; p<2; ++p) {
+            uint32_t cq[4];
+            int rec[4];
+            float err = 0.0f;
+            for(int c=0; c<4; ++c) {
+                cq[c] = (uint32_t)std::clamp((int)std::lround((e[k][c] - (float)p) / 2.0f), 0, 127);
+                rec[c] = (int)((cq[c] << 1) | p);
+                err += (rec[c] - e[k][c]) * (rec[c] - e[k][c]);
+            }
+            if(err < best_err) {
+                best_err = err;
+                pbit[k] = p;
+                for(int c=0; c<4; ++c) { q[k][c] = cq[c]; ep[k][c] = rec[c]; }
+            }
+        }
+    }
+
+    int palette[16][4];
+    for(int w=0; w<16; ++w) {
+        for(int c=0; c<4; ++c) {
+            palette[w][c] = ((64 - weights[w]) * ep[0][c] + weights[w] * ep[1][c] + 32) >> 6;
+        }
+    }
+
+    uint32_t indices[16];
+    for(int i=0; i<16; ++i) {
+        uint32_t best = 0;
+        int best_d = distance_sq(&rgba[i*4], palette[0], 4);
+        for(uint32_t w=1; w<16; ++w) {
+            if(const int d = distance_sq(&rgba[i*4], palette[w], 4); d < best_d) { best_d = d; best = w; }
+        }
+        indices[i] = best;
+    }
+
+    // the anchor (first) index is stored with its top bit implied zero
+    if(indices[0] & 8) {
+        std::swap(q[0], q[1]);
+        std::swap(pbit[0], pbit[1]);
+        for(auto &i : indices) { i = 15 - i; }
+    }
+
+    memset(out, 0, 16);
+    BitWriter bw{out};
+    bw.write(1u << 6, 7);
+    for(int c=0; c<4; ++c) {
+        bw.write(q[0][c], 7);
+        bw.write(q[1][c], 7);
+    }
+    bw.write(pbit[0], 1);
+    bw.write(pbit[1], 1);
+    bw.write(indices[0], 3);
+    for(int i=1; i<16; ++i) { bw.write(indices[i], 4); }
+}
+
+std::vector<std::byte> BCEncoder::compress(CookedTextureFormat format, const uint8_t *rgba, uint32_t width, uint32_t height) {
+    if(format == CookedTextureFormat::RGBA8) {
+        const auto bytes = reinterpret_cast<const std::byte*>(rgba);
+        return {bytes, bytes + (size_t)width * height * 4};
+    }
+
+    const auto block_size = cooked_texture_block_size(format);
+    const auto blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+    std::vector<std::byte> out((size_t)blocks_x * blocks_y * block_size);
+
+    uint8_t block[64];
+    for(auto by=0u; by<blocks_y; ++by) {
+        for(auto bx=0u; bx<blocks_x; ++bx) {
+            for(auto y=0u; y<4; ++y) {
+                for(auto x=0u; x<4; ++x) {
+                    const auto sx = std::min(bx*4 + x, width - 1), sy = std::min(by*4 + y, height - 1);
+                    memcpy(&block[(y*4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+                }
+            }
+
+            auto dst = reinterpret_cast<uint8_t*>(out.data()) + ((size_t)by * blocks_x + bx) * block_size;
+            switch(format) {
+                case CookedTextureFormat::BC1: encode_bc1(block, dst); break;
+                case CookedTextureFormat::BC3: encode_bc3(block, dst); break;
+                case CookedTextureFormat::BC5: encode_bc5(block, dst); break;
+                case CookedTextureFormat::BC7: encode_bc7(block, dst); break;
+                default: return {};
+            }
+        }
+    }
+    return out;
+}
+
+}
@@ -3,6 +3,7 @@
 #include <engine/queue.hpp>
 
 #include <span>
+#include <functional>
 
 namespace eng {
 
@@ -12,7 +13,7 @@ BufferManager::BufferManager(vk::Device device, VmaAllocator allocator, Queue *q
 }
 
 BufferManager::~BufferManager() noexcept {
-    for(auto &[h, b] : _buffers) {
+    for(auto &b : _buffers) {
         vmaDestroyBuffer(_allocator, b.buffer, b.allocation);
     }
 }
@@ -34,9 +35,7 @@ Handle<Buffer> BufferManager::allocate(const vk::BufferCreateInfo &buffer_ci, co
     
     Buffer wrapped_buffer{vk::Buffer{buffer}, buffer_ci.usage, vmaa, std::span<const uint32_t>{buffer_ci.pQueueFamilyIndices, buffer_ci.queueFamilyIndexCount}};
     wrapped_buffer.capacity = buffer_ci.size;
-    Handle<Buffer> handle = wrapped_buffer;
-    _buffers.emplace(handle, std::move(wrapped_buffer));
-    assert(handle);
+    const auto handle = _buffers.insert(std::move(wrapped_buffer));
 
     if(data.size_bytes() > 0) {
         if(!append(handle, data)) {
@@ -49,42 +48,106 @@ Handle<Buffer> BufferManager::allocate(const vk::BufferCreateInfo &buffer_ci, co
 }
 
 bool BufferManager::insert(Handle<Buffer> dst, size_t offset, std::span<const std::byte> data) {
+    return insert(dst, offset, data.size_bytes(), [&data](std::byte *mapped) { memcpy(mapped, data.data(), data.size_bytes()); });
+}
+
+bool BufferManager::insert(Handle<Buffer> dst, size_t offset, size_t size, const std::function<void(std::byte*)> &write) {
     auto &buffer = _buffers.at(dst);
-    if(buffer.capacity - offset < data.size_bytes()) { return false; }
+    if(buffer.capacity < offset || buffer.capacity - offset < size) { return false; }
+    if(size == 0) { return true; }
 
     auto buffer_data = get_mapped_data(dst);
     if(buffer_data) {
-        memcpy(buffer_data, data.data(), data.size_bytes());
+        write(static_cast<std::byte*>(buffer_data) + offset);
+        buffer.size = std::max(buffer.size, offset + size);
         return true;
     }
 
     if(!(buffer.usage & vk::BufferUsageFlagBits::eTransferDst)) { return false; }
 
-    vk::BufferCreateInfo bci{{}, data.size_bytes(), vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, _queue->family_index};
-    VmaAllocationCreateInfo vmaaci{
-        .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-        .usage = VMA_MEMORY_USAGE_AUTO
-    };
-    auto stage = allocate(bci, vmaaci, data);
+    // the staging buffer goes into the same pool, which may move `buffer`
+    const auto dst_buffer = buffer.buffer;
+    auto stage = _allocate_staging(size, write);
     if(!stage) { return false; }
 
     try {
         _buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
-        _buffer.copyBuffer(get(stage), buffer.buffer, vk::BufferCopy{0, offset, data.size_bytes()});
+        _buffer.copyBuffer(get(stage), dst_buffer, vk::BufferCopy{0, offset, size});
         _buffer.end();
     } catch (const std::exception &error) {
         return false;
     }
 
-    auto res = _queue->submit_async({vk::SubmitInfo{{}, {}, _buffer, {}}});
+    auto res = _queue->submit_async(vk::SubmitInfo{{}, {}, _buffer, {}});
     if(!res.first) { free(stage); return false; }
     res.second.wait();
     free(stage);
-    buffer.size = offset + data.size();
+    _buffers.at(dst).size = offset + size;
+
+    return true;
+}
+
+bool BufferManager::insert(Handle<Buffer> dst, size_t offset, size_t size, const std::function<void(std::byte*)> &write, vk::CommandBuffer cmd, uint64_t frame) {
+    auto &buffer = _buffers.at(dst);
+    if(buffer.capacity < offset || buffer.capacity - offset < size) { return false; }
+    if(size == 0) { return true; }
+
+    auto buffer_data = get_mapped_data(dst);
+    if(buffer_data) {
+        write(static_cast<std::byte*>(buffer_data) + offset);
+        buffer.size = std::max(buffer.size, offset + size);
+        return true;
+    }
+
+    if(!(buffer.usage & vk::BufferUsageFlagBits::eTransferDst)) { return false; }
+
+    // the staging buffer goes into the same pool, which may move `buffer`
+    const auto dst_buffer = buffer.buffer;
+    auto stage = _allocate_staging(size, write);
+    if(!stage) { return false; }
+
+    cmd.copyBuffer(get(stage), dst_buffer, vk::BufferCopy{0, offset, size});
+    _released.emplace_back(stage, frame);
+    auto &dst_data = _buffers.at(dst);
+    dst_data.size = std::max(dst_data.size, offset + size);
 
     return true;
 }
 
+Handle<Buffer> BufferManager::grow(Handle<Buffer> handle, size_t capacity, const VmaAllocationCreateInfo &allocation_ci, vk::CommandBuffer cmd, uint64_t frame) {
+    // allocating may move the old buffer in the pool
+    const auto old_buffer = get(handle);
+    const auto old_size = size(handle);
+    const auto usage = _buffers.at(handle).usage;
+    if(old_size > 0 && !(usage & vk::BufferUsageFlagBits::eTransferSrc)) { return Handle<Buffer>{}; }
+
+    const auto grown = allocate(vk::BufferCreateInfo{{}, capacity, usage | vk::BufferUsageFlagBits::eTransferDst}, allocation_ci);
+    if(!grown) { return Handle<Buffer>{}; }
+    if(old_size > 0) { cmd.copyBuffer(old_buffer, get(grown), vk::BufferCopy{0, 0, old_size}); }
+    _buffers.at(grown).size = old_size;
+    _released.emplace_back(handle, frame);
+    return grown;
+}
+
+void BufferManager::evict(uint64_t completed_frame) {
+    std::erase_if(_released, [&](const auto &e) {
+        if(e.second > completed_frame) { return false; }
+        free(e.first);
+        return true;
+    });
+}
+
+Handle<Buffer> BufferManager::_allocate_staging(size_t size, const std::function<void(std::byte*)> &write) {
+    vk::BufferCreateInfo bci{{}, size, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, _queue->family_index};
+    VmaAllocationCreateInfo vmaaci{
+        .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+        .usage = VMA_MEMORY_USAGE_AUTO
+    };
+    auto stage = allocate(bci, vmaaci);
+    if(stage) { write(static_cast<std::byte*>(get_mapped_data(stage))); }
+    return stage;
+}
+
 bool BufferManager::append(Handle<Buffer> dst, std::span<const std::byte> data) {
     return insert(dst, size(dst), data);
 }
@@ -112,7 +175,7 @@ bool BufferManager::transfer(Handle<Buffer> src, Handle<Buffer> dst) {
         _buffer.copyBuffer(buffer_src.buffer, buffer_dst.buffer, vk::BufferCopy{0, 0, buffer_src.size});
         _buffer.end();
 
-        auto res = _queue->submit({vk::SubmitInfo{{}, {}, _buffer, {}}});
+        auto res = _queue->submit(vk::SubmitInfo{{}, {}, _buffer, {}});
         if(!res) { return false; }
         buffer_dst.size = buffer_src.size;
     } catch(const std::exception &error) {
@@ -152,6 +215,16 @@ void* BufferManager::get_mapped_data(Handle<Buffer> handle) const {
     return vmaai.pMappedData;
 }
 
+void BufferManager::flush(Handle<Buffer> handle, size_t offset, size_t size) const {
+    vmaFlushAllocation(_allocator, _buffers.at(handle).allocation, offset, size);
+}
+
+vk::MemoryPropertyFlags BufferManager::memory_properties(Handle<Buffer> handle) const {
+    VkMemoryPropertyFlags flags{};
+    vmaGetAllocationMemoryProperties(_allocator, _buffers.at(handle).allocation, &flags);
+    return vk::MemoryPropertyFlags{flags};
+}
+
 void BufferManager::clear(Handle<Buffer> handle) {
     _buffers.at(handle).size = 0;
 }
@@ -0,0 +1,479 @@
+#include <engine/bvh.hpp>
+#include <engine/cpu_features.hpp>
+#include <engine/parallel_for.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <numeric>
+
+namespace eng {
+
+namespace {
+
+constexpr uint32_t SAH_BINS = 16;
+
+// The slot tests, each returning a bit per slot. sse is part of x86-64, so there's nothing to dispatch on.
+// the first `count` slots are tested, the rest are left out of the mask
+
+// visible when the corner farthest along a plane's normal is in front of it, fully inside when the nearest one is
+template<typename Node> uint32_t frustum_mask(const Node &node, const Frustum &frustum, uint32_t &inside) {
+    const auto used = (1u << node.count) - 1;
+#ifdef ENG_CPU_X86
+    auto visible_v = _mm_castsi128_ps(_mm_set1_epi32(-1)), inside_v = visible_v;
+    for(const auto &p : frustum.planes) {
+        const auto nx = _mm_set1_ps(p.x), ny = _mm_set1_ps(p.y), nz = _mm_set1_ps(p.z), w = _mm_set1_ps(p.w);
+        const auto far_x = _mm_load_ps(p.x >= 0.0f ? node.max_x : node.min_x), near_x = _mm_load_ps(p.x >= 0.0f ? node.min_x : node.max_x);
+        const auto far_y = _mm_load_ps(p.y >= 0.0f ? node.max_y : node.min_y), near_y = _mm_load_ps(p.y >= 0.0f ? node.min_y : node.max_y);
+        const auto far_z = _mm_load_ps(p.z >= 0.0f ? node.max_z : node.min_z), near_z = _mm_load_ps(p.z >= 0.0f ? node.min_z : node.max_z);
+        const auto far_d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, far_x), _mm_mul_ps(ny, far_y)), _mm_add_ps(_mm_mul_ps(nz, far_z), w));
+        const auto near_d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, near_x), _mm_mul_ps(ny, near_y)), _mm_add_ps(_mm_mul_ps(nz, near_z), w));
+        visible_v = _mm_and_ps(visible_v, _mm_cmpge_ps(far_d, _mm_setzero_ps()));
+        inside_v = _mm_and_ps(inside_v, _mm_cmpge_ps(near_d, _mm_setzero_ps()));
+    }
+    inside = (uint32_t)_mm_movemask_ps(inside_v) & used;
+    return (uint32_t)_mm_movemask_ps(visible_v) & used;
+#else
+    uint32_t visible = used;
+    inside = used;
+    for(auto s=0u; s<node.count; ++s) {
+        for(const auto &p : frustum.planes) {
+            const auto far_d = p.x * (p.x >= 0.0f ? node.max_x[s] : node.min_x[s]) + p.y * (p.y >= 0.0f ? node.max_y[s] : node.min_y[s]) + p.z * (p.z >= 0.0f ? node.max_z[s] : node.min_z[s]) + p.w;
+            const auto near_d = p.x * (p.x >= 0.0f ? node.min_x[s] : node.max_x[s]) + p.y * (p.y >= 0.0f ? node.min_y[s] : node.max_y[s]) + p.z * (p.z >= 0.0f ? node.min_z[s] : node.max_z[s]) + p.w;
+            if(far_d < 0.0f) { visible &= ~(1u << s); }
+            if(near_d < 0.0f) { inside &= ~(1u << s); }
+        }
+    }
+    inside &= visible;
+    return visible;
+#endif
+}
+
+template<typename Node> uint32_t overlap_mask(const Node &node, const Aabb &box) {
+#ifdef ENG_CPU_X86
+    const auto used = (1u << node.count) - 1;
+    auto overlap = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.min_x), _mm_set1_ps(box.max.x)), _mm_cmpge_ps(_mm_load_ps(node.max_x), _mm_set1_ps(box.min.x)));
+    overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.min_y), _mm_set1_ps(box.max.y)), _mm_cmpge_ps(_mm_load_ps(node.max_y), _mm_set1_ps(box.min.y))));
+    overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.min_z), _mm_set1_ps(box.max.z)), _mm_cmpge_ps(_mm_load_ps(node.max_z), _mm_set1_ps(box.min.z))));
+    return (uint32_t)_mm_movemask_ps(overlap) & used;
+#else
+    uint32_t overlap = 0;
+    for(auto s=0u; s<node.count; ++s) {
+        if(node.min_x[s] <= box.max.x && node.max_x[s] >= box.min.x && node.min_y[s] <= box.max.y && node.max_y[s] >= box.min.y && node.min_z[s] <= box.max.z && node.max_z[s] >= box.min.z) { overlap |= 1u << s; }
+    }
+    return overlap;
+#endif
+}
+
+// slab test, `entry` gets where the ray enters each hit box (0 when it starts inside)
+template<typename Node> uint32_t ray_mask(const Node &node, const glm::vec3 &origin, const glm::vec3 &inv_direction, float max_distance, float *entry) {
+#ifdef ENG_CPU_X86
+    const auto used = (1u << node.count) - 1;
+    const auto ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+    const auto ix = _mm_set1_ps(inv_direction.x), iy = _mm_set1_ps(inv_direction.y), iz = _mm_set1_ps(inv_direction.z);
+    const auto ax = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_x), ox), ix), bx = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_x), ox), ix);
+    const auto ay = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_y), oy), iy), by = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_y), oy), iy);
+    const auto az = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_z), oz), iz), bz = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_z), oz), iz);
+    const auto t_enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(ax, bx), _mm_min_ps(ay, by)), _mm_max_ps(_mm_min_ps(az, bz), _mm_setzero_ps()));
+    const auto t_exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(ax, bx), _mm_max_ps(ay, by)), _mm_min_ps(_mm_max_ps(az, bz), _mm_set1_ps(max_distance)));
+    _mm_storeu_ps(entry, t_enter);
+    return (uint32_t)_mm_movemask_ps(_mm_cmple_ps(t_enter, t_exit)) & used;
+#else
+    uint32_t hit = 0;
+    for(auto s=0u; s<node.count; ++s) {
+        const auto ax = (node.min_x[s] - origin.x) * inv_direction.x, bx = (node.max_x[s] - origin.x) * inv_direction.x;
+        const auto ay = (node.min_y[s] - origin.y) * inv_direction.y, by = (node.max_y[s] - origin.y) * inv_direction.y;
+        const auto az = (node.min_z[s] - origin.z) * inv_direction.z, bz = (node.max_z[s] - origin.z) * inv_direction.z;
+        entry[s] = std::max({std::min(ax, bx), std::min(ay, by), std::min(az, bz), 0.0f});
+        const auto t_exit = std::min({std::max(ax, bx), std::max(ay, by), std::max(az, bz), max_distance});
+        if(entry[s] <= t_exit) { hit |= 1u << s; }
+    }
+    return hit;
+#endif
+}
+
+// binned surface area heuristic over the centers, falls back to halving along the widest axis
+// when every center is in one bin. returns where the second half starts.
+size_t sah_split(std::span<uint32_t> objects, std::span<const Aabb> bounds, std::span<const glm::vec3> centers) {
+    Aabb center_bounds;
+    for(const auto o : objects) { center_bounds.grow(Aabb{centers[o], centers[o]}); }
+    const auto extent = center_bounds.max - center_bounds.min;
+
+    float best_cost = std::numeric_limits<float>::max();
+    int best_axis = -1;
+    uint32_t best_bin = 0;
+    for(auto axis=0; axis<3; ++axis) {
+        if(extent[axis] <= 0.0f) { continue; }
+        const auto scale = SAH_BINS / extent[axis];
+        std::array<Aabb, SAH_BINS> bin_bounds{};
+        std::array<uint32_t, SAH_BINS> bin_counts{};
+        for(const auto o : objects) {
+            const auto bin = std::min((uint32_t)((centers[o][axis] - center_bounds.min[axis]) * scale), SAH_BINS - 1);
+            bin_bounds[bin].grow(bounds[o]);
+            ++bin_counts[bin];
+        }
+
+        // areas and counts of everything right of each split, then swept from the left
+        std::array<float, SAH_BINS> right_cost{};
+        Aabb right;
+        uint32_t right_count = 0;
+        for(auto b=SAH_BINS-1; b>0; --b) {
+            right.grow(bin_bounds[b]);
+            right_count += bin_counts[b];
+            right_cost[b] = right.half_area() * right_count;
+        }
+        Aabb left;
+        uint32_t left_count = 0;
+        for(auto b=1u; b<SAH_BINS; ++b) {
+            left.grow(bin_bounds[b - 1]);
+            left_count += bin_counts[b - 1];
+            const auto cost = left.half_area() * left_count + right_cost[b];
+            if(left_count > 0 && left_count < objects.size() && cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+            }
+        }
+    }
+
+    if(best_axis >= 0) {
+        const auto scale = SAH_BINS / extent[best_axis];
+        const auto it = std::partition(objects.begin(), objects.end(), [&](uint32_t o) {
+            return std::min((uint32_t)((centers[o][best_axis] - center_bounds.min[best_axis]) * scale), SAH_BINS - 1) < best_bin;
+        });
+        return it - objects.begin();
+    }
+
+    const auto axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    const auto mid = objects.size() / 2;
+    std::nth_element(objects.begin(), objects.begin() + mid, objects.end(), [&](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+    return mid;
+}
+
+}
+
+void Bvh::build(std::span<const Aabb> bounds) {
+    clear();
+    if(bounds.empty()) { return; }
+
+    std::vector<glm::vec3> centers(bounds.size());
+    std::vector<uint32_t> objects(bounds.size());
+    for(auto i=0u; i<bounds.size(); ++i) { centers[i] = bounds[i].center(); }
+    std::iota(objects.begin(), objects.end(), 0u);
+    object_nodes.assign(bounds.size(), INVALID);
+    object_slots.assign(bounds.size(), 0);
+    object_count = bounds.size();
+    nodes.reserve(bounds.size() / 2 + 1);
+    root = build_node(objects, bounds, centers);
+}
+
+void Bvh::clear() {
+    nodes.clear();
+    free_nodes.clear();
+    root = INVALID;
+    object_nodes.clear();
+    object_slots.clear();
+    object_count = 0;
+}
+
+void Bvh::insert(uint32_t object, const Aabb &bounds) {
+    if(contains(object)) {
+        update(object, bounds);
+        return;
+    }
+    if(object >= object_nodes.size()) {
+        object_nodes.resize(object + 1, INVALID);
+        object_slots.resize(object + 1, 0);
+    }
+    ++object_count;
+
+    if(root == INVALID) {
+        root = allocate_node();
+        set_slot(root, nodes[root].count++, bounds, object | OBJECT_BIT);
+        return;
+    }
+
+    // down the child whose box grows the least, into the first node with room. an object in the way is
+    // paired up with the new one under a new node.
+    auto node = root;
+    while(nodes[node].count == WIDTH) {
+        auto best_slot = 0u;
+        auto best_growth = std::numeric_limits<float>::max(), best_area = std::numeric_limits<float>::max();
+        for(auto s=0u; s<WIDTH; ++s) {
+            auto grown = slot_bounds(node, s);
+            const auto area = grown.half_area();
+            grown.grow(bounds);
+            const auto growth = grown.half_area() - area;
+            if(growth < best_growth || (growth == best_growth && area < best_area)) {
+                best_slot = s;
+                best_growth = growth;
+                best_area = area;
+            }
+        }
+
+        const auto child = nodes[node].children[best_slot];
+        if(child & OBJECT_BIT) {
+            const auto pair = allocate_node();
+            const auto child_bounds = slot_bounds(node, best_slot);
+            set_slot(pair, nodes[pair].count++, child_bounds, child);
+            set_slot(node, best_slot, child_bounds, pair);
+            node = pair;
+            break;
+        }
+        node = child;
+    }
+    set_slot(node, nodes[node].count++, bounds, object | OBJECT_BIT);
+    refit_parents(node);
+}
+
+void Bvh::remove(uint32_t object) {
+    if(!contains(object)) { return; }
+    auto node = object_nodes[object];
+    object_nodes[object] = INVALID;
+    --object_count;
+
+    // the last slot moves into the hole, so the used ones stay in front
+    auto &n = nodes[node];
+    const auto slot = object_slots[object], last = (uint8_t)(n.count - 1);
+    if(slot != last) { set_slot(node, slot, slot_bounds(node, last), n.children[last]); }
+    --n.count;
+
+    // a node left with a single child is replaced by that child, a root with a single node child by that node
+    if(n.count == 1 && n.parent != INVALID) {
+        const auto parent = n.parent;
+        const uint32_t parent_slot = n.parent_slot;
+        set_slot(parent, parent_slot, slot_bounds(node, 0), n.children[0]);
+        free_nodes.push_back(node);
+        node = parent;
+    } else if(node == root && n.count == 1 && !(n.children[0] & OBJECT_BIT)) {
+        root = n.children[0];
+        nodes[root].parent = INVALID;
+        free_nodes.push_back(node);
+        return;
+    } else if(node == root && n.count == 0) {
+        clear();
+        return;
+    }
+    refit_parents(node);
+}
+
+void Bvh::update(uint32_t object, const Aabb &bounds) {
+    if(!contains(object)) { return; }
+    const auto node = object_nodes[object];
+    set_slot(node, object_slots[object], bounds, object | OBJECT_BIT);
+    for(auto n = node; n != INVALID && !nodes[n].dirty; n = nodes[n].parent) { nodes[n].dirty = true; }
+}
+
+void Bvh::refit() {
+    if(root != INVALID && nodes[root].dirty) { refit_node(root); }
+}
+
+Aabb Bvh::bounds() const {
+    return root == INVALID ? Aabb{} : node_bounds(root);
+}
+
+void Bvh::query(const Frustum &frustum, std::vector<uint32_t> &objects) const {
+    if(root == INVALID) { return; }
+    if(object_count < PARALLEL_OBJECTS) {
+        query_subtree(root, frustum, objects, query_stack);
+        return;
+    }
+
+    // the top levels are tested here, level by level, until there are enough subtrees to go around the cores
+    auto &subtrees = query_subtrees, &next = query_next_subtrees;
+    subtrees.assign(1, Subtree{root, false});
+    for(auto expanded = true; expanded && subtrees.size() < PARALLEL_SUBTREES;) {
+        expanded = false;
+        next.clear();
+        for(const auto &subtree : subtrees) {
+            if(subtree.inside) {
+                next.push_back(subtree);
+                continue;
+            }
+            const auto &n = nodes[subtree.node];
+            uint32_t inside = 0;
+            for(auto mask = frustum_mask(n, frustum, inside); mask; mask &= mask - 1) {
+                const auto s = std::countr_zero(mask);
+                const auto child = n.children[s];
+                if(child & OBJECT_BIT) { objects.push_back(child & ~OBJECT_BIT); }
+                else {
+                    next.push_back(Subtree{child, (inside & (1u << s)) != 0});
+                    expanded = true;
+                }
+            }
+        }
+        std::swap(subtrees, next);
+    }
+
+    subtree_stacks.resize(std::max(subtree_stacks.size(), subtrees.size()));
+    subtree_objects.resize(std::max(subtree_objects.size(), subtrees.size()));
+    parallel_for(subtrees.size(), [&](size_t i) {
+        subtree_objects[i].clear();
+        if(subtrees[i].inside) { collect(subtrees[i].node, subtree_objects[i]); }
+        else { query_subtree(subtrees[i].node, frustum, subtree_objects[i], subtree_stacks[i]); }
+    });
+    for(auto i=0u; i<subtrees.size(); ++i) { objects.insert(objects.end(), subtree_objects[i].begin(), subtree_objects[i].end()); }
+}
+
+void Bvh::query_subtree(uint32_t top, const Frustum &frustum, std::vector<uint32_t> &objects, std::vector<uint32_t> &stack) const {
+    stack.assign(1, top);
+    while(!stack.empty()) {
+        const auto node = stack.back();
+        stack.pop_back();
+        const auto &n = nodes[node];
+        uint32_t inside = 0;
+        for(auto mask = frustum_mask(n, frustum, inside); mask; mask &= mask - 1) {
+            const auto s = std::countr_zero(mask);
+            const auto child = n.children[s];
+            if(child & OBJECT_BIT) { objects.push_back(child & ~OBJECT_BIT); }
+            else if(inside & (1u << s)) { collect(child, objects); }
+            else { stack.push_back(child); }
+        }
+    }
+}
+
+void Bvh::query(const Aabb &box, std::vector<uint32_t> &objects) const {
+    if(root == INVALID) { return; }
+    auto &stack = query_stack;
+    stack.assign(1, root);
+    while(!stack.empty()) {
+        const auto &n = nodes[stack.back()];
+        stack.pop_back();
+        for(auto mask = overlap_mask(n, box); mask; mask &= mask - 1) {
+            const auto child = n.children[std::countr_zero(mask)];
+            if(child & OBJECT_BIT) { objects.push_back(child & ~OBJECT_BIT); }
+            else { stack.push_back(child); }
+        }
+    }
+}
+
+std::optional<BvhRayHit> Bvh::raycast(const Ray &ray) const {
+    if(root == INVALID) { return {}; }
+    // a zero component gets a huge but finite inverse, infinities would turn into nans at the slab planes
+    const auto inverse = [](float d) { return 1.0f / (std::abs(d) < 1e-30f ? std::copysign(1e-30f, d) : d); };
+    const glm::vec3 inv_direction{inverse(ray.direction.x), inverse(ray.direction.y), inverse(ray.direction.z)};
+
+    // nearest children are popped first, whatever is entered past the best hit so far is skipped
+    std::optional<BvhRayHit> best;
+    std::vector<std::pair<uint32_t, float>> stack{{root, 0.0f}};
+    while(!stack.empty()) {
+        const auto [node, node_entry] = stack.back();
+        stack.pop_back();
+        if(best && node_entry >= best->distance) { continue; }
+
+        const auto &n = nodes[node];
+        alignas(16) float entry[WIDTH];
+        std::array<std::pair<float, uint32_t>, WIDTH> hits;
+        auto hit_count = 0u;
+        for(auto mask = ray_mask(n, ray.origin, inv_direction, best ? std::min(best->distance, ray.max_distance) : ray.max_distance, entry); mask; mask &= mask - 1) {
+            const auto s = std::countr_zero(mask);
+            hits[hit_count++] = {entry[s], n.children[s]};
+        }
+        std::sort(hits.begin(), hits.begin() + hit_count, [](const auto &a, const auto &b) { return a.first > b.first; });
+        for(auto h=0u; h<hit_count; ++h) {
+            const auto [distance, child] = hits[h];
+            if(!(child & OBJECT_BIT)) { stack.emplace_back(child, distance); }
+            else if(!best || distance < best->distance) { best = BvhRayHit{child & ~OBJECT_BIT, distance}; }
+        }
+    }
+    return best;
+}
+
+uint32_t Bvh::build_node(std::span<uint32_t> objects, std::span<const Aabb> bounds, std::span<const glm::vec3> centers) {
+    const auto node = allocate_node();
+
+    // halved twice into up to WIDTH ranges, each of them an object or another node
+    std::vector<std::span<uint32_t>> ranges;
+    if(objects.size() <= WIDTH) {
+        for(auto i=0u; i<objects.size(); ++i) { ranges.push_back(objects.subspan(i, 1)); }
+    } else {
+        const auto mid = sah_split(objects, bounds, centers);
+        for(const auto half : {objects.first(mid), objects.subspan(mid)}) {
+            if(half.size() == 1) {
+                ranges.push_back(half);
+                continue;
+            }
+            const auto quarter = sah_split(half, bounds, centers);
+            ranges.push_back(half.first(quarter));
+            ranges.push_back(half.subspan(quarter));
+        }
+    }
+
+    for(const auto range : ranges) {
+        if(range.size() == 1) {
+            set_slot(node, nodes[node].count++, bounds[range[0]], range[0] | OBJECT_BIT);
+            continue;
+        }
+        const auto child = build_node(range, bounds, centers);
+        set_slot(node, nodes[node].count++, node_bounds(child), child);
+    }
+    return node;
+}
+
+uint32_t Bvh::allocate_node() {
+    if(!free_nodes.empty()) {
+        const auto node = free_nodes.back();
+        free_nodes.pop_back();
+        nodes[node] = Node{};
+        return node;
+    }
+    nodes.emplace_back();
+    return (uint32_t)nodes.size() - 1;
+}
+
+void Bvh::set_slot(uint32_t node, uint32_t slot, const Aabb &box, uint32_t child) {
+    auto &n = nodes[node];
+    n.min_x[slot] = box.min.x;
+    n.min_y[slot] = box.min.y;
+    n.min_z[slot] = box.min.z;
+    n.max_x[slot] = box.max.x;
+    n.max_y[slot] = box.max.y;
+    n.max_z[slot] = box.max.z;
+    n.children[slot] = child;
+    if(child & OBJECT_BIT) {
+        object_nodes[child & ~OBJECT_BIT] = node;
+        object_slots[child & ~OBJECT_BIT] = (uint8_t)slot;
+    } else {
+        nodes[child].parent = node;
+        nodes[child].parent_slot = (uint8_t)slot;
+    }
+}
+
+Aabb Bvh::slot_bounds(uint32_t node, uint32_t slot) const {
+    const auto &n = nodes[node];
+    return Aabb{{n.min_x[slot], n.min_y[slot], n.min_z[slot]}, {n.max_x[slot], n.max_y[slot], n.max_z[slot]}};
+}
+
+Aabb Bvh::node_bounds(uint32_t node) const {
+    Aabb box;
+    for(auto s=0u; s<nodes[node].count; ++s) { box.grow(slot_bounds(node, s)); }
+    return box;
+}
+
+void Bvh::refit_parents(uint32_t node) {
+    for(auto parent = nodes[node].parent; parent != INVALID; node = parent, parent = nodes[node].parent) {
+        set_slot(parent, nodes[node].parent_slot, node_bounds(node), node);
+    }
+}
+
+void Bvh::refit_node(uint32_t node) {
+    auto &n = nodes[node];
+    for(auto s=0u; s<n.count; ++s) {
+        const auto child = n.children[s];
+        if(child & OBJECT_BIT || !nodes[child].dirty) { continue; }
+        refit_node(child);
+        set_slot(node, s, node_bounds(child), child);
+    }
+    n.dirty = false;
+}
+
+void Bvh::collect(uint32_t node, std::vector<uint32_t> &objects) const {
+    const auto &n = nodes[node];
+    for(auto s=0u; s<n.count; ++s) {
+        if(n.children[s] & OBJECT_BIT) { objects.push_back(n.children[s] & ~OBJECT_BIT); }
+        else { collect(n.children[s], objects); }
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include <engine/camera.hpp>
+
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace eng {
+
+glm::mat4 Camera::view() const {
+    return glm::lookAt(position, position + forward(), glm::vec3{0.0f, 1.0f, 0.0f});
+}
+
+glm::mat4 Camera::projection(float aspect) const {
+    // z_clip is the near distance and w_clip the distance along forward(), so depth is near / distance
+    const auto f = 1.0f / std::tan(fov_y * 0.5f);
+    glm::mat4 proj{0.0f};
+    proj[0][0] = f / aspect;
+    proj[1][1] = -f;
+    proj[2][3] = -1.0f;
+    proj[3][2] = near_plane;
+    return proj;
+}
+
+glm::vec3 Camera::forward() const {
+    return glm::vec3{-std::sin(yaw) * std::cos(pitch), std::sin(pitch), -std::cos(yaw) * std::cos(pitch)};
+}
+
+glm::vec3 Camera::right() const {
+    return glm::vec3{std::cos(yaw), 0.0f, -std::sin(yaw)};
+}
+
+glm::vec3 Camera::ray_direction(const glm::vec2 &ndc, float aspect) const {
+    const auto f = 1.0f / std::tan(fov_y * 0.5f);
+    const auto up = glm::cross(right(), forward());
+    return glm::normalize(forward() + right() * (ndc.x * aspect / f) - up * (ndc.y / f));
+}
+
+float Camera::pixels_per_unit(float height) const {
+    return height * 0.5f / std::tan(fov_y * 0.5f);
+}
+
+void Camera::frame(const glm::vec3 &center, float radius) {
+    position = center - forward() * (radius / std::sin(fov_y * 0.5f));
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#include <engine/dynamic_resolution.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace eng {
+
+float DynamicResolution::update(float gpu_ms, float measured_scale, float budget_ms, float min_scale, float max_scale) {
+    if(gpu_ms > 0.0f && budget_ms > 0.0f && measured_scale > 0.0f) {
+        const auto target = measured_scale * std::sqrt(budget_ms * HEADROOM / gpu_ms);
+        if(std::abs(target - _scale) > _scale * DEADBAND) { _scale += (target - _scale) * RATE; }
+    }
+    _scale = std::clamp(_scale, min_scale, std::max(min_scale, max_scale));
+    return _scale;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include <engine/ecs.hpp>
+
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+namespace eng {
+
+namespace {
+    std::mutex component_mutex;
+    std::vector<size_t> component_sizes;
+}
+
+ComponentId detail::register_component(size_t size) {
+    std::scoped_lock lock{component_mutex};
+    if(component_sizes.size() == MAX_COMPONENTS) { throw std::runtime_error{"Too many component types."}; }
+    component_sizes.push_back(size);
+    return (ComponentId)component_sizes.size() - 1;
+}
+
+size_t detail::component_size(ComponentId id) {
+    std::scoped_lock lock{component_mutex};
+    return component_sizes.at(id);
+}
+
+Archetype::Archetype(const ComponentMask &mask) : component_mask(mask) {
+    column_of.fill(NO_COLUMN);
+    for(auto id=0u; id<MAX_COMPONENTS; ++id) {
+        if(!mask.test(id)) { continue; }
+        column_of[id] = (uint8_t)columns.size();
+        columns.emplace_back();
+        column_sizes.push_back((uint32_t)detail::component_size(id));
+    }
+}
+
+uint32_t Archetype::append(Entity entity) {
+    const auto row = (uint32_t)row_entities.size();
+    row_entities.push_back(entity);
+    for(auto c=0u; c<columns.size(); ++c) { columns[c].resize(columns[c].size() + column_sizes[c]); }
+    return row;
+}
+
+Entity Archetype::remove(uint32_t row) {
+    const auto last = (uint32_t)row_entities.size() - 1;
+    Entity moved;
+    if(row != last) {
+        for(auto c=0u; c<columns.size(); ++c) {
+            std::memcpy(columns[c].data() + row * column_sizes[c], columns[c].data() + last * column_sizes[c], column_sizes[c]);
+        }
+        row_entities[row] = row_entities[last];
+        moved = row_entities[row];
+    }
+    row_entities.pop_back();
+    for(auto c=0u; c<columns.size(); ++c) { columns[c].resize(columns[c].size() - column_sizes[c]); }
+    return moved;
+}
+
+void Archetype::reorder(std::span<const uint32_t> order) {
+    std::vector<std::byte> sorted;
+    for(auto c=0u; c<columns.size(); ++c) {
+        const auto size = column_sizes[c];
+        sorted.resize(columns[c].size());
+        for(auto row=0u; row<order.size(); ++row) { std::memcpy(sorted.data() + row * size, columns[c].data() + order[row] * size, size); }
+        columns[c].swap(sorted);
+    }
+    std::vector<Entity> sorted_entities(order.size());
+    for(auto row=0u; row<order.size(); ++row) { sorted_entities[row] = row_entities[order[row]]; }
+    row_entities = std::move(sorted_entities);
+}
+
+Entity EntityRegistry::create() {
+    uint32_t index;
+    if(!free_indices.empty()) {
+        index = free_indices.back();
+        free_indices.pop_back();
+    } else {
+        index = (uint32_t)records.size();
+        records.emplace_back();
+    }
+    // entities without components are in the archetype of none
+    auto &record = records[index];
+    record.archetype = archetype_index(ComponentMask{});
+    record.row = archetype_list[record.archetype]->append(Entity{index, record.generation});
+    return Entity{index, record.generation};
+}
+
+void EntityRegistry::destroy(Entity entity) {
+    if(!alive(entity)) { return; }
+    auto &record = records[entity.index];
+    if(const auto moved = archetype_list[record.archetype]->remove(record.row)) { records[moved.index].row = record.row; }
+    record.archetype = NO_ARCHETYPE;
+    ++record.generation;
+    free_indices.push_back(entity.index);
+}
+
+uint32_t EntityRegistry::archetype_index(const ComponentMask &mask) {
+    const auto [it, inserted] = archetype_of.try_emplace(mask, (uint32_t)archetype_list.size());
+    if(inserted) { archetype_list.push_back(std::make_unique<Archetype>(mask)); }
+    return it->second;
+}
+
+void EntityRegistry::move(Entity entity, uint32_t archetype) {
+    auto &record = records[entity.index];
+    auto &from = *archetype_list[record.archetype];
+    auto &to = *archetype_list[archetype];
+    const auto row = to.append(entity);
+    const auto shared = from.component_mask & to.component_mask;
+    for(auto id=0u; id<MAX_COMPONENTS; ++id) {
+        if(shared.test(id)) { std::memcpy(to.at(id, row), from.at(id, record.row), to.column_sizes[to.column_of[id]]); }
+    }
+    if(const auto moved = from.remove(record.row)) { records[moved.index].row = record.row; }
+    record.archetype = archetype;
+    record.row = row;
+}
+
+void EntityRegistry::reorder(Archetype &archetype, std::span<const uint32_t> order) {
+    archetype.reorder(order);
+    const auto entities = archetype.entities();
+    for(auto row=0u; row<entities.size(); ++row) { records[entities[row].index].row = row; }
+}
+
+}
\ No newline at end of file
@@ -31,9 +31,11 @@ void Engine::initialize() {
 void Engine::start() {
     while(!glfwWindowShouldClose(_this->_window->get_glfwptr())) {
         ++_this->frame_number;
+        // the input is polled once the renderer is ready for the frame, so it is as recent as it can be when recorded
+        _this->_renderer->wait_for_frame();
+        glfwPollEvents();
         _this->_renderer->update();
         _this->_window->update();
-        glfwPollEvents();
     }
 }
 
@@ -0,0 +1,50 @@
+#include <engine/frame_arena.hpp>
+
+#include <algorithm>
+
+namespace eng {
+
+FrameArena::FrameArena(size_t capacity) {
+    add_block(std::max<size_t>(capacity, 1));
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+    auto *block = &_blocks.back();
+    auto address = reinterpret_cast<uintptr_t>(block->data.get()) + _offset;
+    auto padding = (alignment - address % alignment) % alignment;
+    if(padding + size > block->size - _offset) {
+        // twice what there is so far, so a frame that keeps growing adds only a few blocks
+        add_block(std::max(capacity() * 2, size + alignment));
+        block = &_blocks.back();
+        address = reinterpret_cast<uintptr_t>(block->data.get());
+        padding = (alignment - address % alignment) % alignment;
+    }
+    _offset += padding + size;
+    _used += padding + size;
+    return block->data.get() + _offset - size;
+}
+
+void FrameArena::reset() {
+    // one block that fits what the blocks together could hold, the next frame like this one stays in it
+    if(_blocks.size() > 1) {
+        const auto total = capacity();
+        _blocks.clear();
+        add_block(total);
+    }
+    _offset = 0;
+    _used = 0;
+}
+
+size_t FrameArena::capacity() const {
+    size_t total = 0;
+    for(const auto &block : _blocks) { total += block.size; }
+    return total;
+}
+
+void FrameArena::add_block(size_t size) {
+    _blocks.push_back(Block{std::unique_ptr<std::byte[]>{new std::byte[size]}, size});
+    _offset = 0;
+    ++_block_allocations;
+}
+
+}
\ No newline at end of file
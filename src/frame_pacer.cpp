@@ -0,0 +1,62 @@
+#include <engine/frame_pacer.hpp>
+
+#include <algorithm>
+
+namespace eng {
+
+namespace {
+    float milliseconds(FramePacer::Clock::duration duration) { return std::chrono::duration<float, std::milli>{duration}.count(); }
+    FramePacer::Clock::duration duration(float ms) {
+        return std::chrono::duration_cast<FramePacer::Clock::duration>(std::chrono::duration<float, std::milli>{ms});
+    }
+}
+
+FramePacer::Clock::duration FramePacer::input_delay(Clock::time_point now) const {
+    // the worse of the average and the last frame, a single slow frame is likelier to be followed by another one
+    const auto cpu = duration(std::max(_stats.cpu, _last_cpu));
+    const auto start = _gpu_free - cpu - MARGIN;
+    if(start <= now) { return Clock::duration::zero(); }
+    return std::min<Clock::duration>(start - now, MAX_DELAY);
+}
+
+void FramePacer::sampled(uint64_t frame, Clock::time_point at) {
+    if(_last_sample != Clock::time_point{}) { smooth(_stats.frame, milliseconds(at - _last_sample)); }
+    _last_sample = at;
+    _records[frame % _records.size()] = Record{frame, at};
+}
+
+void FramePacer::submitted(uint64_t frame, Clock::time_point at) {
+    const auto *r = record(frame);
+    if(!r) { return; }
+    _last_submitted = frame;
+    _last_cpu = milliseconds(at - r->sampled);
+    smooth(_stats.cpu, _last_cpu);
+    // the gpu starts on it once it's through everything before it
+    _gpu_free = std::max(_gpu_free, at) + duration(std::max(_stats.gpu, _last_gpu));
+}
+
+void FramePacer::gpu_time(float ms) {
+    _last_gpu = ms;
+    smooth(_stats.gpu, ms);
+}
+
+void FramePacer::waited(Clock::duration duration) {
+    smooth(_stats.wait, milliseconds(duration));
+}
+
+void FramePacer::done(uint64_t frame, Clock::time_point at) {
+    if(const auto *r = record(frame)) { smooth(_stats.latency, milliseconds(at - r->sampled)); }
+    // nothing is left on the gpu then, a prediction later than that was too pessimistic
+    if(frame == _last_submitted) { _gpu_free = std::min(_gpu_free, at); }
+}
+
+FramePacer::Record* FramePacer::record(uint64_t frame) {
+    auto &r = _records[frame % _records.size()];
+    return r.frame == frame ? &r : nullptr;
+}
+
+void FramePacer::smooth(float &average, float ms) {
+    average = average == 0.0f ? ms : average + (ms - average) * 0.1f;
+}
+
+}
\ No newline at end of file
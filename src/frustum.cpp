@@ -0,0 +1,15 @@
+#include <engine/frustum.hpp>
+
+namespace eng {
+
+Frustum Frustum::from_matrix(const glm::mat4 &clip_from_world) {
+    const auto rows = glm::transpose(clip_from_world);
+    Frustum frustum{{rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2]}};
+    for(auto &p : frustum.planes) {
+        const auto length = glm::length(glm::vec3{p});
+        if(length > 0.0f) { p /= length; }
+    }
+    return frustum;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include <engine/import_job.hpp>
+
+#include <chrono>
+#include <iostream>
+
+#include <fmt/core.h>
+
+namespace eng {
+
+ImportJob::ImportJob(std::filesystem::path path, const VertexLayout &layout): _path(std::move(path)) {
+    _result = std::async(std::launch::async, [this, layout] {
+        Geometry geom;
+        try {
+            geom = GeometryImporter::import(_path, &_progress);
+            if(!geom.meshes.empty()) {
+                GeometryImporter::optimize(geom, {}, &_progress);
+                GeometryImporter::cook(geom, layout, &_progress);
+            }
+        } catch(const std::exception &error) {
+            std::cerr << fmt::format("Importing \"{}\" failed: {}\n", _path.string(), error.what());
+            geom = Geometry{};
+        }
+
+        if(_progress.cancel) { _progress.stage = ImportStage::Cancelled; return Geometry{}; }
+        if(geom.meshes.empty()) { _progress.stage = ImportStage::Failed; return Geometry{}; }
+        return geom;
+    });
+}
+
+ImportJob::~ImportJob() noexcept {
+    cancel();
+    if(_result.valid()) { _result.wait(); }
+}
+
+bool ImportJob::ready() const {
+    return _result.valid() && _result.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+}
+
+Geometry ImportJob::take() {
+    if(!_result.valid()) { return Geometry{}; }
+    auto geom = _result.get();
+    if(!geom.meshes.empty()) {
+        _progress.fraction = 0.0f;
+        _progress.stage = ImportStage::Upload;
+    }
+    return geom;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include <engine/mapped_file.hpp>
+
+#include <utility>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace eng {
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::filesystem::path &path) {
+    _file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(_file == INVALID_HANDLE_VALUE) { _file = nullptr; return; }
+
+    LARGE_INTEGER size{};
+    if(!GetFileSizeEx(_file, &size) || size.QuadPart == 0) { _unmap(); return; }
+
+    _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!_mapping) { _unmap(); return; }
+
+    _data = static_cast<const std::byte*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    if(!_data) { _unmap(); return; }
+    _size = (size_t)size.QuadPart;
+}
+
+void MappedFile::_unmap() noexcept {
+    if(_data) { UnmapViewOfFile(_data); }
+    if(_mapping) { CloseHandle(_mapping); }
+    if(_file) { CloseHandle(_file); }
+    _data = nullptr;
+    _size = 0;
+    _mapping = nullptr;
+    _file = nullptr;
+}
+#else
+MappedFile::MappedFile(const std::filesystem::path &path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) { return; }
+
+    struct stat st{};
+    if(fstat(fd, &st) == 0 && st.st_size > 0) {
+        if(auto ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0); ptr != MAP_FAILED) {
+            _data = static_cast<const std::byte*>(ptr);
+            _size = (size_t)st.st_size;
+        }
+    }
+    // the mapping keeps its own reference to the file
+    close(fd);
+}
+
+void MappedFile::_unmap() noexcept {
+    if(_data) { munmap(const_cast<std::byte*>(_data), _size); }
+    _data = nullptr;
+    _size = 0;
+}
+#endif
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile &&other) noexcept {
+    if(this == &other) { return *this; }
+    _unmap();
+    _data = std::exchange(other._data, nullptr);
+    _size = std::exchange(other._size, 0);
+#ifdef _WIN32
+    _file = std::exchange(other._file, nullptr);
+    _mapping = std::exchange(other._mapping, nullptr);
+#endif
+    return *this;
+}
+
+MappedFile::~MappedFile() noexcept {
+    _unmap();
+}
+
+}
@@ -0,0 +1,387 @@
+#include <engine/mesh_optimizer.hpp>
+#include <engine/mesh_simplifier.hpp>
+#include <engine/hash.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace eng {
+
+namespace {
+
+constexpr uint32_t NONE = ~0u;
+
+// FIFO cache through timestamps: a vertex is cached while fewer than `cache_size` vertices were added after it.
+// starting the clock past `cache_size` makes every vertex start out uncached.
+struct CacheSimulation {
+    CacheSimulation(size_t vertex_count, uint32_t cache_size): times(vertex_count, 0), time(cache_size + 1), size(cache_size) {}
+
+    bool cached(uint32_t v) const { return time - times[v] <= size; }
+    // returns whether the vertex had to be transformed
+    bool use(uint32_t v) {
+        if(cached(v)) { return false; }
+        times[v] = time++;
+        return true;
+    }
+    void flush() { time += size + 1; }
+
+    std::vector<uint64_t> times;
+    uint64_t time;
+    uint32_t size;
+};
+
+template<typename T> void gather_stream(std::vector<T> &stream, const std::vector<uint32_t> &sources) {
+    std::vector<T> gathered(sources.size());
+    for(auto i=0u; i<sources.size(); ++i) { gathered[i] = stream[sources[i]]; }
+    stream = std::move(gathered);
+}
+
+template<typename T> void remap_stream(std::vector<T> &stream, const std::vector<uint32_t> &remap, size_t new_count) {
+    if(stream.empty()) { return; }
+    std::vector<T> remapped(new_count);
+    for(auto i=0u; i<remap.size(); ++i) {
+        if(remap[i] != NONE) { remapped[remap[i]] = stream[i]; }
+    }
+    stream = std::move(remapped);
+}
+
+// sphere around the box of the meshlet's vertices. the cone axis is the average of the triangle normals and the cutoff
+// is the sine of how far the widest normal strays from it (the cone of directions all of them face away from).
+Meshlet meshlet_bounds(std::span<const uint32_t> indices, std::span<const glm::vec3> positions, uint32_t first_index) {
+    Meshlet m{.first_index = first_index, .index_count = (uint32_t)indices.size()};
+
+    glm::vec3 min{positions[indices[0]]}, max{positions[indices[0]]};
+    for(const auto idx : indices) {
+        min = glm::min(min, positions[idx]);
+        max = glm::max(max, positions[idx]);
+    }
+    m.center = (min + max) * 0.5f;
+    for(const auto idx : indices) { m.radius = std::max(m.radius, glm::length(positions[idx] - m.center)); }
+
+    std::vector<glm::vec3> normals;
+    normals.reserve(indices.size() / 3);
+    glm::vec3 axis{0.0f};
+    for(auto t=0u; t+2<indices.size(); t+=3) {
+        const auto &a = positions[indices[t]], &b = positions[indices[t + 1]], &c = positions[indices[t + 2]];
+        const auto n = glm::cross(b - a, c - a);
+        const auto length = glm::length(n);
+        if(length == 0.0f) { continue; }
+        normals.push_back(n / length);
+        axis += normals.back();
+    }
+    if(normals.empty() || glm::length(axis) == 0.0f) { return m; }
+    axis = glm::normalize(axis);
+
+    auto min_dot = 1.0f;
+    for(const auto &n : normals) { min_dot = std::min(min_dot, glm::dot(n, axis)); }
+    m.cone_axis = axis;
+    m.cone_cutoff = min_dot <= 0.0f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+    return m;
+}
+
+}
+
+MeshOptimizationReport MeshOptimizer::optimize(Mesh &mesh, const MeshOptimizerOptions &options) {
+    MeshOptimizationReport report;
+    if(!mesh.packed_vertices.empty() || mesh.vertex_positions.empty()) { return report; }
+
+    report.vertices_before = mesh.vertex_positions.size();
+    report.before = analyze_vertex_cache(std::span{mesh.vertex_indices}.subspan(0, mesh.lod(0).index_count), mesh.vertex_positions.size());
+
+    if(options.weld) { weld_vertices(mesh); }
+    if(options.lod_count > 1 && mesh.lods.empty()) { build_lods(mesh, options); }
+
+    // every level is drawn on its own, so each gets its own triangle order; overdraw only matters up close
+    for(auto l=0u; l<mesh.lod_count(); ++l) {
+        const auto lod = mesh.lod(l);
+        const auto indices = std::span{mesh.vertex_indices}.subspan(lod.first_index, lod.index_count);
+        std::vector<uint32_t> clusters;
+        const auto overdraw = options.overdraw && l == 0;
+        optimize_vertex_cache(indices, mesh.vertex_positions.size(), overdraw ? &clusters : nullptr);
+        if(overdraw) { optimize_overdraw(indices, mesh.vertex_positions, clusters, options.overdraw_threshold); }
+        report.lod_triangles[l] = lod.index_count / 3;
+    }
+    optimize_vertex_fetch(mesh);
+    if(options.meshlets) { build_meshlets(mesh); }
+
+    report.meshlets = mesh.meshlets.size();
+    report.vertices_after = mesh.vertex_positions.size();
+    report.after = analyze_vertex_cache(std::span{mesh.vertex_indices}.subspan(0, mesh.lod(0).index_count), mesh.vertex_positions.size());
+    return report;
+}
+
+VertexCacheStats MeshOptimizer::analyze_vertex_cache(std::span<const uint32_t> indices, size_t vertex_count, uint32_t cache_size) {
+    VertexCacheStats stats;
+    stats.triangles = indices.size() / 3;
+
+    CacheSimulation cache{vertex_count, cache_size};
+    std::vector<bool> referenced(vertex_count);
+    for(const auto idx : indices) {
+        if(idx >= vertex_count) { continue; }
+        if(!referenced[idx]) {
+            referenced[idx] = true;
+            ++stats.vertices;
+        }
+        stats.transformed += cache.use(idx);
+    }
+    return stats;
+}
+
+void MeshOptimizer::weld_vertices(Mesh &mesh) {
+    const auto count = mesh.vertex_positions.size();
+    if(count == 0) { return; }
+    const auto has_normals = mesh.vertex_normals.size() == count;
+    const auto has_texture_coords = mesh.vertex_texture_coords.size() == count;
+
+    struct Vertex {
+        glm::vec3 position{0.0f}, normal{0.0f};
+        glm::vec2 texture_coords{0.0f};
+    };
+    const auto vertex = [&](size_t i) {
+        return Vertex{mesh.vertex_positions[i], has_normals ? mesh.vertex_normals[i] : glm::vec3{0.0f}, has_texture_coords ? mesh.vertex_texture_coords[i] : glm::vec2{0.0f}};
+    };
+
+    // open addressing table of the first vertex of every distinct value, at most half full
+    const auto table_size = std::bit_ceil(count * 2);
+    std::vector<uint32_t> table(table_size, NONE);
+    std::vector<uint32_t> remap(count, NONE), unique;
+    for(auto i=0u; i<count; ++i) {
+        const auto v = vertex(i);
+        auto slot = Hash::bytes(std::as_bytes(std::span{&v, 1})) & (table_size - 1);
+        for(;; slot = (slot + 1) & (table_size - 1)) {
+            if(table[slot] == NONE) {
+                table[slot] = i;
+                remap[i] = unique.size();
+                unique.push_back(i);
+                break;
+            }
+            const auto other = vertex(table[slot]);
+            if(memcmp(&v, &other, sizeof(Vertex)) == 0) {
+                remap[i] = remap[table[slot]];
+                break;
+            }
+        }
+    }
+    if(unique.size() == count) { return; }
+
+    for(auto &idx : mesh.vertex_indices) { idx = remap[idx]; }
+    gather_stream(mesh.vertex_positions, unique);
+    if(has_normals) { gather_stream(mesh.vertex_normals, unique); }
+    if(has_texture_coords) { gather_stream(mesh.vertex_texture_coords, unique); }
+}
+
+void MeshOptimizer::optimize_vertex_cache(std::span<uint32_t> indices, size_t vertex_count, std::vector<uint32_t> *clusters, uint32_t cache_size) {
+    const auto triangle_count = indices.size() / 3;
+    if(triangle_count == 0) { return; }
+
+    // triangles of every vertex, and how many of them are not emitted yet
+    std::vector<uint32_t> live(vertex_count, 0), first_adjacent(vertex_count + 1, 0), adjacency(triangle_count * 3);
+    for(auto i=0u; i<triangle_count * 3; ++i) { ++live[indices[i]]; }
+    std::partial_sum(live.begin(), live.end(), first_adjacent.begin() + 1);
+    {
+        auto fill = first_adjacent;
+        for(auto i=0u; i<triangle_count * 3; ++i) { adjacency[fill[indices[i]]++] = i / 3; }
+    }
+
+    CacheSimulation cache{vertex_count, cache_size};
+    std::vector<bool> emitted(triangle_count);
+    std::vector<uint32_t> dead_end, candidates, output;
+    output.reserve(triangle_count * 3);
+
+    size_t cursor = 0;
+    const auto next_live = [&] {
+        while(cursor < vertex_count && live[cursor] == 0) { ++cursor; }
+        return cursor < vertex_count ? (uint32_t)cursor : NONE;
+    };
+
+    auto fanning = next_live();
+    auto cold = true;
+    while(fanning != NONE) {
+        if(cold && clusters) { clusters->push_back(output.size() / 3); }
+
+        candidates.clear();
+        for(auto a=first_adjacent[fanning]; a<first_adjacent[fanning + 1]; ++a) {
+            const auto t = adjacency[a];
+            if(emitted[t]) { continue; }
+            emitted[t] = true;
+            for(auto c=0u; c<3; ++c) {
+                const auto v = indices[t * 3 + c];
+                output.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                cache.use(v);
+            }
+        }
+
+        // prefers the vertex that stays in the cache the longest while its remaining triangles are emitted
+        auto next = NONE;
+        int64_t best_priority = -1;
+        for(const auto v : candidates) {
+            if(live[v] == 0) { continue; }
+            const auto age = (int64_t)(cache.time - cache.times[v]);
+            const auto priority = age + 2 * (int64_t)live[v] <= (int64_t)cache_size ? age : 0;
+            if(priority > best_priority) {
+                best_priority = priority;
+                next = v;
+            }
+        }
+
+        cold = false;
+        while(next == NONE && !dead_end.empty()) {
+            const auto v = dead_end.back();
+            dead_end.pop_back();
+            if(live[v] > 0) { next = v; }
+        }
+        if(next == NONE) {
+            next = next_live();
+            cold = true;
+        }
+        fanning = next;
+    }
+
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void MeshOptimizer::optimize_overdraw(std::span<uint32_t> indices, std::span<const glm::vec3> positions, const std::vector<uint32_t> &clusters, float threshold, uint32_t cache_size) {
+    const auto triangle_count = indices.size() / 3;
+    if(triangle_count == 0 || clusters.empty()) { return; }
+
+    // every cluster restarts with a cold cache, so they are split wherever the part before
+    // already transforms few enough vertices per triangle
+    const auto max_acmr = analyze_vertex_cache(indices, positions.size(), cache_size).acmr() * threshold;
+    std::vector<uint32_t> splits;
+    CacheSimulation cache{positions.size(), cache_size};
+    for(auto c=0u; c<clusters.size(); ++c) {
+        const auto end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+        uint32_t start = clusters[c];
+        size_t transformed = 0;
+        splits.push_back(start);
+        cache.flush();
+        for(auto t=start; t<end; ++t) {
+            if(t > start && (float)transformed / (t - start) <= max_acmr) {
+                splits.push_back(t);
+                start = t;
+                transformed = 0;
+                cache.flush();
+            }
+            for(auto i=0u; i<3; ++i) { transformed += cache.use(indices[t * 3 + i]); }
+        }
+    }
+
+    glm::vec3 mesh_center{0.0f};
+    for(const auto idx : indices) { mesh_center += positions[idx]; }
+    mesh_center /= (float)indices.size();
+
+    // how far out of the mesh a cluster faces: its area weighted center projected onto its average normal
+    std::vector<float> facing(splits.size());
+    for(auto s=0u; s<splits.size(); ++s) {
+        const auto end = s + 1 < splits.size() ? splits[s + 1] : triangle_count;
+        glm::vec3 center{0.0f}, normal{0.0f};
+        float area = 0.0f;
+        for(auto t=splits[s]; t<end; ++t) {
+            const auto &a = positions[indices[t * 3]], &b = positions[indices[t * 3 + 1]], &c = positions[indices[t * 3 + 2]];
+            const auto n = glm::cross(b - a, c - a);
+            const auto triangle_area = glm::length(n);
+            center += (a + b + c) / 3.0f * triangle_area;
+            normal += n;
+            area += triangle_area;
+        }
+        if(area <= 0.0f || glm::dot(normal, normal) <= 0.0f) { continue; }
+        facing[s] = glm::dot(center / area - mesh_center, glm::normalize(normal));
+    }
+
+    std::vector<uint32_t> order(splits.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](auto a, auto b) { return facing[a] > facing[b]; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(triangle_count * 3);
+    for(const auto s : order) {
+        const auto end = s + 1 < splits.size() ? splits[s + 1] : triangle_count;
+        sorted.insert(sorted.end(), indices.begin() + splits[s] * 3, indices.begin() + end * 3);
+    }
+    std::copy(sorted.begin(), sorted.end(), indices.begin());
+}
+
+void MeshOptimizer::build_lods(Mesh &mesh, const MeshOptimizerOptions &options) {
+    if(mesh.vertex_indices.empty()) { return; }
+    const auto lod_count = std::min(options.lod_count, MESH_MAX_LODS);
+    const auto extent = MeshSimplifier::extent(mesh);
+
+    // each level is simplified from the one before, so the errors add up
+    mesh.lods = {MeshLod{0, (uint32_t)mesh.vertex_indices.size(), 0.0f}};
+    auto relative_error = 0.0f;
+    while(mesh.lods.size() < lod_count) {
+        const auto previous = mesh.lods.back();
+        const auto target = (size_t)(previous.index_count / 3 * options.lod_ratio) * 3;
+        auto simplified = MeshSimplifier::simplify(mesh, std::span{mesh.vertex_indices}.subspan(previous.first_index, previous.index_count),
+            target, options.lod_max_error - relative_error, options.lod_attribute_weight);
+
+        // not worth another draw range if it barely got simpler
+        if(simplified.indices.empty() || simplified.indices.size() > previous.index_count * 0.9f) { break; }
+        relative_error += simplified.error;
+        mesh.lods.push_back(MeshLod{(uint32_t)mesh.vertex_indices.size(), (uint32_t)simplified.indices.size(), relative_error * extent});
+        mesh.vertex_indices.insert(mesh.vertex_indices.end(), simplified.indices.begin(), simplified.indices.end());
+    }
+    if(mesh.lods.size() == 1) { mesh.lods.clear(); }
+}
+
+void MeshOptimizer::optimize_vertex_fetch(Mesh &mesh) {
+    const auto count = mesh.vertex_positions.size();
+    std::vector<uint32_t> remap(count, NONE);
+    uint32_t next = 0;
+    for(auto &idx : mesh.vertex_indices) {
+        if(remap[idx] == NONE) { remap[idx] = next++; }
+        idx = remap[idx];
+    }
+
+    remap_stream(mesh.vertex_positions, remap, next);
+    if(mesh.vertex_normals.size() == count) { remap_stream(mesh.vertex_normals, remap, next); }
+    if(mesh.vertex_texture_coords.size() == count) { remap_stream(mesh.vertex_texture_coords, remap, next); }
+}
+
+
+void MeshOptimizer::build_meshlets(Mesh &mesh) {
+    mesh.meshlets.clear();
+    if(mesh.vertex_indices.empty()) { return; }
+
+    // which meshlet last used each vertex, saves clearing a set for every new one
+    std::vector<uint32_t> used_by(mesh.vertex_positions.size(), NONE);
+    for(auto l=0u; l<mesh.lod_count(); ++l) {
+        const auto lod = mesh.lod(l);
+        const auto first_meshlet = (uint32_t)mesh.meshlets.size();
+        auto start = lod.first_index, vertices = 0u;
+        const auto close = [&](uint32_t end) {
+            const auto indices = std::span<const uint32_t>{mesh.vertex_indices}.subspan(start, end - start);
+            mesh.meshlets.push_back(meshlet_bounds(indices, mesh.vertex_positions, start));
+            start = end;
+            vertices = 0;
+        };
+
+        for(auto t=lod.first_index; t<lod.first_index + lod.index_count; t+=3) {
+            auto new_vertices = 0u;
+            for(auto i=0u; i<3; ++i) { new_vertices += used_by[mesh.vertex_indices[t + i]] != mesh.meshlets.size(); }
+            if(vertices + new_vertices > MESHLET_MAX_VERTICES || (t - start) / 3 == MESHLET_MAX_TRIANGLES) { close(t); }
+
+            for(auto i=0u; i<3; ++i) {
+                auto &user = used_by[mesh.vertex_indices[t + i]];
+                if(user != mesh.meshlets.size()) {
+                    user = mesh.meshlets.size();
+                    ++vertices;
+                }
+            }
+        }
+        if(start < lod.first_index + lod.index_count) { close(lod.first_index + lod.index_count); }
+
+        if(!mesh.lods.empty()) {
+            mesh.lods[l].first_meshlet = first_meshlet;
+            mesh.lods[l].meshlet_count = mesh.meshlets.size() - first_meshlet;
+        }
+    }
+}
+
+}
\ No newline at end of file
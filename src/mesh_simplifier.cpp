@@ -0,0 +1,304 @@
+#include <engine/mesh_simplifier.hpp>
+#include <engine/hash.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace eng {
+
+namespace {
+
+constexpr uint32_t NONE = ~0u;
+// how much more than the surface planes the planes through border and seam edges count
+constexpr float BORDER_WEIGHT = 10.0f;
+
+enum class VertexKind : uint8_t { Manifold, Border, Seam, Locked };
+
+// which kind of vertex may be collapsed onto which, [from][to]
+constexpr bool CAN_COLLAPSE[4][4]{
+    {true, true, true, false},
+    {false, true, false, false},
+    {false, false, true, false},
+    {false, false, false, false},
+};
+
+// a + 2b.p + p.A.p, the weighted sum of squared distances to a set of planes
+struct Quadric {
+    void add_plane(glm::dvec3 n, double d, double weight) {
+        a00 += weight * n.x * n.x; a11 += weight * n.y * n.y; a22 += weight * n.z * n.z;
+        a10 += weight * n.y * n.x; a20 += weight * n.z * n.x; a21 += weight * n.z * n.y;
+        b += weight * n * d;
+        c += weight * d * d;
+        w += weight;
+    }
+    Quadric& operator+=(const Quadric &q) {
+        a00 += q.a00; a11 += q.a11; a22 += q.a22;
+        a10 += q.a10; a20 += q.a20; a21 += q.a21;
+        b += q.b;
+        c += q.c;
+        w += q.w;
+        return *this;
+    }
+    // the weighted average squared distance of `p` to the planes
+    float error(glm::vec3 p) const {
+        const glm::dvec3 v{p};
+        const auto r = a00 * v.x * v.x + a11 * v.y * v.y + a22 * v.z * v.z
+            + 2.0 * (a10 * v.y * v.x + a20 * v.z * v.x + a21 * v.z * v.y)
+            + 2.0 * glm::dot(b, v) + c;
+        return w > 0.0 ? (float)(std::abs(r) / w) : 0.0f;
+    }
+
+    double a00{0}, a11{0}, a22{0}, a10{0}, a20{0}, a21{0};
+    glm::dvec3 b{0.0};
+    double c{0}, w{0};
+};
+
+// outgoing half edges of every vertex
+struct EdgeAdjacency {
+    void build(std::span<const uint32_t> indices, size_t vertex_count) {
+        offsets.assign(vertex_count + 1, 0);
+        for(const auto idx : indices) { ++offsets[idx + 1]; }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        targets.resize(indices.size());
+        auto fill = offsets;
+        for(auto t=0u; t<indices.size() / 3; ++t) {
+            for(auto c=0u; c<3; ++c) { targets[fill[indices[t * 3 + c]]++] = indices[t * 3 + (c + 1) % 3]; }
+        }
+    }
+    bool has_edge(uint32_t from, uint32_t to) const {
+        return std::find(targets.begin() + offsets[from], targets.begin() + offsets[from + 1], to) != targets.begin() + offsets[from + 1];
+    }
+
+    std::vector<uint32_t> offsets, targets;
+};
+
+struct Collapse {
+    uint32_t from, to;
+    bool bidirectional;
+    float error;
+};
+
+}
+
+float MeshSimplifier::extent(const Mesh &mesh) {
+    const auto size = mesh.bounds.position_max - mesh.bounds.position_min;
+    return std::max({size.x, size.y, size.z});
+}
+
+MeshSimplifier::Result MeshSimplifier::simplify(const Mesh &mesh, std::span<const uint32_t> indices, size_t target_index_count, float target_error, float attribute_weight) {
+    Result result{{indices.begin(), indices.end()}, 0.0f};
+    const auto vertex_count = mesh.vertex_positions.size();
+    if(vertex_count == 0 || indices.size() <= target_index_count) { return result; }
+    const auto has_normals = mesh.vertex_normals.size() == vertex_count;
+    const auto has_texture_coords = mesh.vertex_texture_coords.size() == vertex_count;
+
+    // everything is measured in the unit cube around the mesh, so errors are relative to its extent
+    const auto scale = extent(mesh) > 0.0f ? 1.0f / extent(mesh) : 1.0f;
+    std::vector<glm::vec3> positions(vertex_count);
+    for(auto i=0u; i<vertex_count; ++i) { positions[i] = (mesh.vertex_positions[i] - mesh.bounds.position_min) * scale; }
+    const auto uv_size = mesh.bounds.uv_max - mesh.bounds.uv_min;
+    const auto uv_scale = 1.0f / std::max({uv_size.x, uv_size.y, 1e-6f});
+
+    // remap: the first vertex with the same position. wedge: circular list of all vertices with that position
+    std::vector<uint32_t> remap(vertex_count), wedge(vertex_count);
+    {
+        const auto table_size = std::bit_ceil(vertex_count * 2);
+        std::vector<uint32_t> table(table_size, NONE);
+        for(auto i=0u; i<vertex_count; ++i) {
+            const auto &p = mesh.vertex_positions[i];
+            auto slot = Hash::bytes(std::as_bytes(std::span{&p, 1})) & (table_size - 1);
+            while(table[slot] != NONE && memcmp(&mesh.vertex_positions[table[slot]], &p, sizeof(p)) != 0) { slot = (slot + 1) & (table_size - 1); }
+            if(table[slot] == NONE) { table[slot] = i; }
+            remap[i] = table[slot];
+            wedge[i] = i;
+            if(remap[i] != i) {
+                wedge[i] = wedge[remap[i]];
+                wedge[remap[i]] = i;
+            }
+        }
+    }
+
+    EdgeAdjacency adjacency;
+    adjacency.build(result.indices, vertex_count);
+
+    // open edges are those without a twin. a vertex with exactly one open edge in and out lies on a border,
+    // two positionally equal vertices whose open edges pair up lie on a seam
+    std::vector<VertexKind> kinds(vertex_count, VertexKind::Locked);
+    {
+        std::vector<uint32_t> open_in(vertex_count, NONE), open_out(vertex_count, NONE);
+        for(auto t=0u; t<result.indices.size() / 3; ++t) {
+            for(auto c=0u; c<3; ++c) {
+                const auto from = result.indices[t * 3 + c], to = result.indices[t * 3 + (c + 1) % 3];
+                if(adjacency.has_edge(to, from)) { continue; }
+                // the vertex itself marks more than one open edge
+                open_out[from] = open_out[from] == NONE ? to : from;
+                open_in[to] = open_in[to] == NONE ? from : to;
+            }
+        }
+        const auto single_open = [&](uint32_t v) { return open_in[v] != NONE && open_in[v] != v && open_out[v] != NONE && open_out[v] != v; };
+
+        for(auto v=0u; v<vertex_count; ++v) {
+            if(remap[v] != v) { continue; }
+            if(wedge[v] == v) {
+                if(open_in[v] == NONE && open_out[v] == NONE) { kinds[v] = VertexKind::Manifold; }
+                else if(single_open(v)) { kinds[v] = VertexKind::Border; }
+            } else if(const auto w = wedge[v]; wedge[w] == v && single_open(v) && single_open(w)
+                && remap[open_in[v]] == remap[open_out[w]] && remap[open_out[v]] == remap[open_in[w]]) {
+                kinds[v] = VertexKind::Seam;
+            }
+        }
+        for(auto v=0u; v<vertex_count; ++v) { kinds[v] = kinds[remap[v]]; }
+    }
+
+    // the planes of all triangles around a position, plus planes perpendicular to them through
+    // border and seam edges so those keep their shape
+    std::vector<Quadric> quadrics(vertex_count);
+    for(auto t=0u; t<result.indices.size() / 3; ++t) {
+        const uint32_t tri[3]{result.indices[t * 3], result.indices[t * 3 + 1], result.indices[t * 3 + 2]};
+        const glm::dvec3 p0{positions[tri[0]]}, p1{positions[tri[1]]}, p2{positions[tri[2]]};
+        auto normal = glm::cross(p1 - p0, p2 - p0);
+        const auto area = glm::length(normal);
+        if(area <= 0.0) { continue; }
+        normal /= area;
+        for(const auto v : tri) { quadrics[remap[v]].add_plane(normal, -glm::dot(normal, p0), area); }
+
+        for(auto c=0u; c<3; ++c) {
+            const auto from = tri[c], to = tri[(c + 1) % 3];
+            if(kinds[from] != VertexKind::Border && kinds[from] != VertexKind::Seam) { continue; }
+            if(adjacency.has_edge(to, from)) { continue; }
+            const glm::dvec3 e0{positions[from]}, e1{positions[to]};
+            const auto length = glm::length(e1 - e0);
+            if(length <= 0.0) { continue; }
+            const auto edge_normal = glm::normalize(glm::cross(e1 - e0, normal));
+            quadrics[remap[from]].add_plane(edge_normal, -glm::dot(edge_normal, e0), length * BORDER_WEIGHT);
+            quadrics[remap[to]].add_plane(edge_normal, -glm::dot(edge_normal, e0), length * BORDER_WEIGHT);
+        }
+    }
+
+    const auto attribute_distance = [&](uint32_t a, uint32_t b) {
+        float d = 0.0f;
+        if(has_normals) { d += glm::dot(mesh.vertex_normals[a] - mesh.vertex_normals[b], mesh.vertex_normals[a] - mesh.vertex_normals[b]); }
+        if(has_texture_coords) {
+            const auto duv = (mesh.vertex_texture_coords[a] - mesh.vertex_texture_coords[b]) * uv_scale;
+            d += glm::dot(duv, duv);
+        }
+        return d;
+    };
+    const auto collapse_error = [&](uint32_t from, uint32_t to) {
+        auto error = quadrics[remap[from]].error(positions[to]) + attribute_weight * attribute_distance(from, to);
+        if(kinds[from] == VertexKind::Seam) { error += attribute_weight * attribute_distance(wedge[from], wedge[to]); }
+        return error;
+    };
+
+    const auto max_error = target_error * target_error;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> collapse_remap(vertex_count), triangle_offsets, triangles;
+    std::vector<bool> locked(vertex_count);
+
+    while(result.indices.size() > target_index_count) {
+        adjacency.build(result.indices, vertex_count);
+        const auto triangle_count = result.indices.size() / 3;
+
+        // every edge once, in the direction(s) it may be collapsed in
+        collapses.clear();
+        for(auto t=0u; t<triangle_count; ++t) {
+            for(auto c=0u; c<3; ++c) {
+                const auto v0 = result.indices[t * 3 + c], v1 = result.indices[t * 3 + (c + 1) % 3];
+                if(remap[v0] == remap[v1]) { continue; }
+                const auto k0 = (int)kinds[v0], k1 = (int)kinds[v1];
+                const auto twin = adjacency.has_edge(v1, v0);
+                if(twin && v1 < v0) { continue; }
+                // borders and seams may only move along themselves
+                if((kinds[v0] == VertexKind::Border || kinds[v0] == VertexKind::Seam) && k0 == k1 && twin) { continue; }
+                // and both sides of a seam have to move along the same edge
+                if(kinds[v0] == VertexKind::Seam && k0 == k1 && !adjacency.has_edge(wedge[v0], wedge[v1]) && !adjacency.has_edge(wedge[v1], wedge[v0])) { continue; }
+
+                if(CAN_COLLAPSE[k0][k1]) { collapses.push_back({v0, v1, CAN_COLLAPSE[k1][k0], 0.0f}); }
+                else if(CAN_COLLAPSE[k1][k0]) { collapses.push_back({v1, v0, false, 0.0f}); }
+            }
+        }
+        if(collapses.empty()) { break; }
+
+        for(auto &c : collapses) {
+            c.error = collapse_error(c.from, c.to);
+            if(!c.bidirectional) { continue; }
+            if(const auto reverse = collapse_error(c.to, c.from); reverse < c.error) {
+                std::swap(c.from, c.to);
+                c.error = reverse;
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const auto &a, const auto &b) { return a.error < b.error; });
+
+        // most collapses take two triangles with them. collapses that cost a lot more than the cheapest
+        // half that would reach the target are left for the next pass, which sees the updated quadrics
+        const auto triangle_goal = (result.indices.size() - target_index_count) / 3;
+        const auto edge_goal = triangle_goal / 2;
+        const auto error_goal = edge_goal < collapses.size() ? collapses[edge_goal].error * 1.5f : std::numeric_limits<float>::max();
+
+        // triangles around every position, to reject collapses that flip one of them
+        triangle_offsets.assign(vertex_count + 1, 0);
+        for(const auto idx : result.indices) { ++triangle_offsets[remap[idx] + 1]; }
+        std::partial_sum(triangle_offsets.begin(), triangle_offsets.end(), triangle_offsets.begin());
+        triangles.resize(result.indices.size());
+        {
+            auto fill = triangle_offsets;
+            for(auto i=0u; i<result.indices.size(); ++i) { triangles[fill[remap[result.indices[i]]]++] = i / 3; }
+        }
+        const auto flips = [&](uint32_t from, uint32_t to) {
+            const auto target = positions[to];
+            for(auto a=triangle_offsets[remap[from]]; a<triangle_offsets[remap[from] + 1]; ++a) {
+                const auto *tri = &result.indices[triangles[a] * 3];
+                glm::vec3 p[3], moved[3];
+                bool has_to = false;
+                for(auto c=0u; c<3; ++c) {
+                    p[c] = moved[c] = positions[tri[c]];
+                    if(remap[tri[c]] == remap[from]) { moved[c] = target; }
+                    has_to |= remap[tri[c]] == remap[to];
+                }
+                // those collapse to nothing
+                if(has_to) { continue; }
+                if(glm::dot(glm::cross(p[1] - p[0], p[2] - p[0]), glm::cross(moved[1] - moved[0], moved[2] - moved[0])) <= 0.0f) { return true; }
+            }
+            return false;
+        };
+
+        std::iota(collapse_remap.begin(), collapse_remap.end(), 0u);
+        std::fill(locked.begin(), locked.end(), false);
+        size_t triangles_collapsed = 0;
+        for(const auto &c : collapses) {
+            if(c.error > max_error || triangles_collapsed >= triangle_goal) { break; }
+            if(c.error > error_goal && triangles_collapsed > triangle_goal / 10) { break; }
+
+            const auto r0 = remap[c.from], r1 = remap[c.to];
+            // positions moved this pass already changed the triangles the errors were computed with
+            if(locked[r0] || locked[r1]) { continue; }
+            if(flips(c.from, c.to)) { continue; }
+
+            quadrics[r1] += quadrics[r0];
+            collapse_remap[c.from] = c.to;
+            if(kinds[c.from] == VertexKind::Seam) { collapse_remap[wedge[c.from]] = wedge[c.to]; }
+            locked[r0] = locked[r1] = true;
+            triangles_collapsed += kinds[c.from] == VertexKind::Border ? 1 : 2;
+            // only the distance counts towards the error of the result, the attribute part just steers the order
+            result.error = std::max(result.error, quadrics[r0].error(positions[c.to]));
+        }
+        if(triangles_collapsed == 0) { break; }
+
+        size_t write = 0;
+        for(auto t=0u; t<triangle_count; ++t) {
+            const uint32_t tri[3]{collapse_remap[result.indices[t * 3]], collapse_remap[result.indices[t * 3 + 1]], collapse_remap[result.indices[t * 3 + 2]]};
+            if(remap[tri[0]] == remap[tri[1]] || remap[tri[0]] == remap[tri[2]] || remap[tri[1]] == remap[tri[2]]) { continue; }
+            std::copy(tri, tri + 3, result.indices.begin() + write);
+            write += 3;
+        }
+        result.indices.resize(write);
+    }
+
+    result.error = std::sqrt(result.error);
+    return result;
+}
+
+}
\ No newline at end of file
@@ -1,34 +1,204 @@
 #include <engine/model_loader.hpp>
+#include <engine/mesh_format.hpp>
+#include <engine/mapped_file.hpp>
+#include <engine/vertex_packing.hpp>
+#include <engine/parallel_for.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+#include <glm/gtc/type_ptr.hpp>
 
 namespace eng {
 
-Geometry GeometryImporter::import(const std::filesystem::path &path) {
+static_assert(CookedMeshEntry::MAX_LODS == MESH_MAX_LODS);
+
+namespace {
+
+// forwards assimp's reading and post-processing progress and aborts the import when cancelled.
+// the importer takes ownership of it.
+class AssimpProgressHandler : public Assimp::ProgressHandler {
+public:
+    explicit AssimpProgressHandler(ImportProgress *progress): progress(progress) {}
+    bool Update(float percentage) override {
+        if(percentage >= 0.0f) { progress->fraction = std::min(percentage, 1.0f); }
+        return !progress->cancel;
+    }
+
+    ImportProgress *progress;
+};
+
+}
+
+Geometry GeometryImporter::import(const std::filesystem::path &path, ImportProgress *progress) {
     if(!std::filesystem::is_regular_file(path)) { return Geometry{}; }
     if(!std::filesystem::exists(path)) { return Geometry{}; }
+    if(path.extension() == ".emesh") { return _import_cooked(path); }
 
+    const auto set_stage = [progress](ImportStage stage) {
+        if(!progress) { return; }
+        progress->fraction = 0.0f;
+        progress->stage = stage;
+    };
+    const auto cancelled = [progress] { return progress && progress->cancel; };
+
+    set_stage(ImportStage::Parse);
     Assimp::Importer aiimp;
+    if(progress) { aiimp.SetProgressHandler(new AssimpProgressHandler{progress}); }
     const auto scene = aiimp.ReadFile(path.string(), aiProcess_GenNormals | aiProcess_FlipUVs | aiProcess_GenBoundingBoxes | aiProcess_Triangulate);
 
-    if(!scene) { return Geometry{}; }
+    if(!scene || cancelled()) { return Geometry{}; }
 
+    set_stage(ImportStage::Convert);
     GeometryImporter imp{scene, path.parent_path().string()};
+    std::vector<const aiMesh*> aimeshes;
     Geometry geom;
-    imp._parse_aiscene_nodes_rec(scene->mRootNode, geom);
+    imp._gather_aiscene_nodes_rec(scene->mRootNode, GeometryNode::NO_PARENT, aimeshes, geom.nodes);
+
+    // meshes are independent of each other, so they are converted in parallel straight into their slots.
+    geom.meshes.resize(aimeshes.size());
+    std::atomic_size_t converted{0};
+    parallel_for(aimeshes.size(), [&](size_t i) {
+        if(cancelled()) { return; }
+        geom.meshes[i] = imp._parse_aimesh(aimeshes[i]);
+        if(progress) { progress->fraction = (float)++converted / aimeshes.size(); }
+    });
+
+    if(cancelled()) { return Geometry{}; }
     return geom;
 }
 
-void GeometryImporter::_parse_aiscene_nodes_rec(const aiNode *ai, Geometry &geometry) {
+MeshOptimizationReport GeometryImporter::optimize(Geometry &geometry, const MeshOptimizerOptions &options, ImportProgress *progress) {
+    if(progress) {
+        progress->fraction = 0.0f;
+        progress->stage = ImportStage::Optimize;
+    }
+
+    std::vector<MeshOptimizationReport> reports(geometry.meshes.size());
+    std::atomic_size_t optimized{0};
+    parallel_for(geometry.meshes.size(), [&](size_t i) {
+        if(progress && progress->cancel) { return; }
+        reports[i] = MeshOptimizer::optimize(geometry.meshes[i], options);
+        if(progress) { progress->fraction = (float)++optimized / geometry.meshes.size(); }
+    });
+
+    MeshOptimizationReport total;
+    for(const auto &r : reports) { total += r; }
+    return total;
+}
+
+void GeometryImporter::cook(Geometry &geometry, const VertexLayout &layout, ImportProgress *progress) {
+    if(progress) {
+        progress->fraction = 0.0f;
+        progress->stage = ImportStage::Cook;
+    }
+
+    size_t vertex_bytes = 0, index_count = 0;
+    for(const auto &mesh : geometry.meshes) {
+        if(!mesh.packed_vertices.empty()) { continue; }
+        vertex_bytes += mesh.vertex_positions.size() * layout.stride;
+        index_count += mesh.vertex_indices.size();
+    }
+    if(vertex_bytes == 0) { return; }
+
+    // one allocation for all meshes; uint32_t elements keep the vertices and the indices aligned,
+    // as every layout's stride is a multiple of 4.
+    auto storage = std::make_shared<std::vector<uint32_t>>(vertex_bytes / sizeof(uint32_t) + index_count);
+    auto *vertices = reinterpret_cast<std::byte*>(storage->data());
+    auto *indices = storage->data() + vertex_bytes / sizeof(uint32_t);
+
+    for(auto m=0u; m<geometry.meshes.size(); ++m) {
+        auto &mesh = geometry.meshes[m];
+        if(!mesh.packed_vertices.empty()) { continue; }
+        if(progress && progress->cancel) { return; }
+
+        const auto vertex_count = mesh.vertex_positions.size();
+        VertexPacker::pack(VertexPacker::streams(mesh), layout, mesh.bounds, vertices);
+        std::copy(mesh.vertex_indices.begin(), mesh.vertex_indices.end(), indices);
+
+        mesh.packed_vertices = {vertices, vertex_count * layout.stride};
+        mesh.packed_indices = {indices, mesh.vertex_indices.size()};
+        mesh.packed_vertex_count = vertex_count;
+        mesh.packed_layout = layout;
+        vertices += vertex_count * layout.stride;
+        indices += mesh.vertex_indices.size();
+
+        mesh.vertex_positions = {};
+        mesh.vertex_normals = {};
+        mesh.vertex_texture_coords = {};
+        mesh.vertex_indices = {};
+        if(progress) { progress->fraction = (float)(m + 1) / geometry.meshes.size(); }
+    }
+
+    // a geometry is either imported from a file or cooked here, never both
+    geometry.source = std::move(storage);
+}
+
+Geometry GeometryImporter::_import_cooked(const std::filesystem::path &path) {
+    auto file = std::make_shared<MappedFile>(path);
+    CookedMesh cooked;
+    if(!*file || !parse_cooked_mesh(file->data(), cooked)) {
+        return Geometry{};
+    }
+
+    const auto base_path = path.parent_path();
+    Geometry geom;
+    geom.meshes.resize(cooked.entries.size());
+    for(auto i=0u; i<cooked.entries.size(); ++i) {
+        const auto &e = cooked.entries[i];
+        auto &mesh = geom.meshes[i];
+        mesh.packed_vertices = cooked.vertices.subspan((size_t)e.first_vertex * cooked.layout.stride, (size_t)e.vertex_count * cooked.layout.stride);
+        mesh.packed_indices = cooked.indices.subspan(e.first_index, e.index_count);
+        mesh.packed_vertex_count = e.vertex_count;
+        mesh.packed_layout = cooked.layout;
+        mesh.bounds.position_min = {e.aabb_min[0], e.aabb_min[1], e.aabb_min[2]};
+        mesh.bounds.position_max = {e.aabb_max[0], e.aabb_max[1], e.aabb_max[2]};
+        mesh.bounds.uv_min = {e.uv_min[0], e.uv_min[1]};
+        mesh.bounds.uv_max = {e.uv_max[0], e.uv_max[1]};
+        for(auto l=0u; l<e.lod_count; ++l) {
+            const auto &lod = e.lods[l];
+            mesh.lods.push_back(MeshLod{lod.first_index, lod.index_count, lod.error, lod.first_meshlet, lod.meshlet_count});
+        }
+        for(const auto &m : cooked.meshlets.subspan(e.first_meshlet, e.meshlet_count)) {
+            mesh.meshlets.push_back(Meshlet{
+                {m.center[0], m.center[1], m.center[2]}, m.radius,
+                {m.cone_axis[0], m.cone_axis[1], m.cone_axis[2]}, m.cone_cutoff,
+                m.first_index, m.index_count
+            });
+        }
+
+        if(const auto diffuse = cooked.string(e.diffuse_texture); !diffuse.empty()) {
+            mesh.material.texture_paths[TextureType::Diffuse] = (base_path / diffuse).string();
+        }
+        if(const auto normal = cooked.string(e.normal_texture); !normal.empty()) {
+            mesh.material.texture_paths[TextureType::Normal] = (base_path / normal).string();
+        }
+    }
+    for(const auto &n : cooked.nodes) {
+        geom.nodes.push_back(GeometryNode{glm::make_mat4(n.transform), n.parent, n.first_mesh, n.mesh_count});
+    }
+    geom.source = std::move(file);
+    return geom;
+}
+
+void GeometryImporter::_gather_aiscene_nodes_rec(const aiNode *ai, uint32_t parent, std::vector<const aiMesh*> &meshes, std::vector<GeometryNode> &nodes) const {
+    // assimp's matrices are row major
+    const auto &t = ai->mTransformation;
+    const auto index = (uint32_t)nodes.size();
+    nodes.push_back(GeometryNode{
+        glm::mat4{t.a1, t.b1, t.c1, t.d1, t.a2, t.b2, t.c2, t.d2, t.a3, t.b3, t.c3, t.d3, t.a4, t.b4, t.c4, t.d4},
+        parent, (uint32_t)meshes.size(), ai->mNumMeshes
+    });
     for(auto i=0u; i<ai->mNumMeshes; ++i) {
-        const auto *aim = scene->mMeshes[ai->mMeshes[i]];
-        geometry.meshes.push_back(_parse_aimesh(aim));
+        meshes.push_back(scene->mMeshes[ai->mMeshes[i]]);
     }
 
     for(auto i=0u; i<ai->mNumChildren; ++i) {
-        _parse_aiscene_nodes_rec(ai->mChildren[i], geometry);
+        _gather_aiscene_nodes_rec(ai->mChildren[i], index, meshes, nodes);
     }
 }
 
-Mesh GeometryImporter::_parse_aimesh(const aiMesh *ai) {
+Mesh GeometryImporter::_parse_aimesh(const aiMesh *ai) const {
     Mesh mesh;
 
     if(!ai->HasPositions()) { return mesh; }
@@ -38,9 +208,12 @@ Mesh GeometryImporter::_parse_aimesh(const aiMesh *ai) {
         const auto &[x, y, z] = ai->mVertices[i];
         mesh.vertex_positions[i] = {x, y, z};
     }
+    // filled by aiProcess_GenBoundingBoxes, quantized positions are relative to it
+    mesh.bounds.position_min = {ai->mAABB.mMin.x, ai->mAABB.mMin.y, ai->mAABB.mMin.z};
+    mesh.bounds.position_max = {ai->mAABB.mMax.x, ai->mAABB.mMax.y, ai->mAABB.mMax.z};
 
     if(ai->HasNormals()) {
-        mesh.vertex_normals.resize(ai->mNumVertices * 3); 
+        mesh.vertex_normals.resize(ai->mNumVertices);
         for(auto i=0u; i<ai->mNumVertices; ++i) {
             const auto &[x, y, z] = ai->mNormals[i];
             mesh.vertex_normals[i] = {x, y, z};
@@ -48,11 +221,16 @@ Mesh GeometryImporter::_parse_aimesh(const aiMesh *ai) {
     }
 
     if(ai->HasTextureCoords(0)) {
-        mesh.vertex_texture_coords.resize(ai->mNumVertices * 3); 
+        mesh.vertex_texture_coords.resize(ai->mNumVertices);
         for(auto i=0u; i<ai->mNumVertices; ++i) {
             const auto &[x, y, z] = ai->mTextureCoords[0][i];
             mesh.vertex_texture_coords[i] = {x, y};
         }
+        mesh.bounds.uv_min = mesh.bounds.uv_max = mesh.vertex_texture_coords.at(0);
+        for(const auto &tc : mesh.vertex_texture_coords) {
+            mesh.bounds.uv_min = glm::min(mesh.bounds.uv_min, tc);
+            mesh.bounds.uv_max = glm::max(mesh.bounds.uv_max, tc);
+        }
     }
 
     mesh.vertex_indices.resize(ai->mNumFaces * 3);
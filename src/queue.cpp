@@ -15,8 +15,8 @@ namespace eng {
         return *this;
     }
 
-    [[nodiscard]] std::pair<bool, std::future<void>> Queue::submit_async(std::vector<vk::SubmitInfo> submits, vk::Fence fence) {
-        return std::make_pair<bool, std::future<void>>(true, std::async(std::launch::async, [&, submits](){
+    [[nodiscard]] std::pair<bool, std::future<void>> Queue::submit_async(std::span<const vk::SubmitInfo> submits, vk::Fence fence) {
+        return std::make_pair<bool, std::future<void>>(true, std::async(std::launch::async, [&, submits = std::vector<vk::SubmitInfo>(submits.begin(), submits.end())](){
             if(!fence) {
                 try {
                     fence = _device.createFence(vk::FenceCreateInfo{});
@@ -59,7 +59,7 @@ namespace eng {
         }));
     }
 
-    [[nodiscard]] bool Queue::submit(const std::vector<vk::SubmitInfo> submits, vk::Fence fence) {
+    [[nodiscard]] bool Queue::submit(std::span<const vk::SubmitInfo> submits, vk::Fence fence) {
             try{
                 _queue.submit(submits, fence);
             } catch(const std::exception &error) {
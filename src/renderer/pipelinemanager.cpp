@@ -8,12 +8,25 @@
 
 namespace eng {
 
+static vk::Format to_vk_format(VertexAttributeFormat format) {
+    switch(format) {
+        case VertexAttributeFormat::Float2: return vk::Format::eR32G32Sfloat;
+        case VertexAttributeFormat::Float3: return vk::Format::eR32G32B32Sfloat;
+        case VertexAttributeFormat::Half2: return vk::Format::eR16G16Sfloat;
+        case VertexAttributeFormat::Unorm16x2: return vk::Format::eR16G16Unorm;
+        case VertexAttributeFormat::Unorm16x4: return vk::Format::eR16G16B16A16Unorm;
+        case VertexAttributeFormat::Snorm8x2: return vk::Format::eR8G8Snorm;
+        case VertexAttributeFormat::Snorm16x2: return vk::Format::eR16G16Snorm;
+        default: return vk::Format::eUndefined;
+    }
+}
+
 PipelineManager::PipelineManager(vk::Device dev): _dev(dev) {}
 
 Pipeline PipelineManager::get_or_create_pipeline(const PipelineConfig &p) {
     for(size_t i=0; i<_configs.size(); ++i) {
         const auto &_config = _configs.at(i);
-        if(_config.shaders != p.shaders) {
+        if(_config.shaders != p.shaders || _config.vertex_layout != p.vertex_layout || _config.color_formats != p.color_formats || _config.depth_format != p.depth_format) {
             continue;
         }
         
@@ -33,6 +46,10 @@ const PipelineLayout& PipelineManager::get_layout(vk::PipelineLayout layout) con
 }
 
 Pipeline PipelineManager::_build_pipeline(const PipelineConfig &config) {
+    if(config.shaders->size() == 1 && config.shaders->front().get_vk_stage() == vk::ShaderStageFlagBits::eCompute) {
+        return _build_compute_pipeline(config);
+    }
+
     std::vector<vk::PipelineShaderStageCreateInfo> graphicspp_stages_ci{ };
     std::vector<vk::VertexInputAttributeDescription> graphicspp_input_attributes{ };
 
@@ -43,6 +60,16 @@ Pipeline PipelineManager::_build_pipeline(const PipelineConfig &config) {
         if(s.get_vk_stage() == vk::ShaderStageFlagBits::eVertex) {
             uint32_t offset = 0;
             for(const auto &input : s.resources.interface.inputs) {
+                if(!config.vertex_layout.empty()) {
+                    const auto format = input.location < VertexLayout::LocationCount ? config.vertex_layout.formats.at(input.location) : VertexAttributeFormat::None;
+                    if(format == VertexAttributeFormat::None) {
+                        fmt::println("Vertex layout has no attribute for shader input location: {}", input.location);
+                        continue;
+                    }
+                    graphicspp_input_attributes.emplace_back(input.location, 0, to_vk_format(format), config.vertex_layout.offsets.at(input.location));
+                    continue;
+                }
+
                 vk::Format type;
                 uint32_t type_size = 0;
                 switch(input.vecsize) {
@@ -80,16 +107,22 @@ Pipeline PipelineManager::_build_pipeline(const PipelineConfig &config) {
 
     vk::PipelineMultisampleStateCreateInfo graphicspp_multisample_ci{{}, vk::SampleCountFlagBits::e1, false, 0.0f};
 
-    vk::PipelineDepthStencilStateCreateInfo graphicspp_depthstencil_ci{{}, false, false, vk::CompareOp::eNever};
+    const auto has_depth = config.depth_format != vk::Format::eUndefined;
+    vk::PipelineDepthStencilStateCreateInfo graphicspp_depthstencil_ci{{}, has_depth, has_depth, vk::CompareOp::eGreaterOrEqual};
+
+    std::vector<vk::PipelineColorBlendAttachmentState> graphicspp_blend_attachments(config.color_formats.size(), vk::PipelineColorBlendAttachmentState{}
+        .setColorWriteMask(vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA));
+    vk::PipelineColorBlendStateCreateInfo graphicspp_colorblend_ci{{}, false, vk::LogicOp::eClear, graphicspp_blend_attachments};
 
-    vk::PipelineColorBlendStateCreateInfo graphicspp_colorblend_ci{{}, false};
+    vk::PipelineRenderingCreateInfo graphicspp_rendering_ci{0, config.color_formats, config.depth_format};
 
     vk::PipelineDynamicStateCreateInfo graphicspp_dynamic_ci{{}, config.dynamic_states};
 
     vk::PipelineLayout graphicspp_layout = _find_or_build_pipeline_layout(config);
 
     vk::GraphicsPipelineCreateInfo graphicspp_ci;
-    graphicspp_ci.setStages(graphicspp_stages_ci)
+    graphicspp_ci.setPNext(&graphicspp_rendering_ci)
+        .setStages(graphicspp_stages_ci)
         .setPVertexInputState(&graphicspp_input_state_ci)
         .setPInputAssemblyState(&graphicspp_input_assembly_ci)
         .setPTessellationState(&graphicspp_tesselation_ci)
@@ -109,6 +142,19 @@ Pipeline PipelineManager::_build_pipeline(const PipelineConfig &config) {
     return Pipeline{graphicspp, graphicspp_layout, config.shaders};
 }
 
+Pipeline PipelineManager::_build_compute_pipeline(const PipelineConfig &config) {
+    const auto &shader = config.shaders->front();
+    vk::PipelineLayout computepp_layout = _find_or_build_pipeline_layout(config);
+    vk::ComputePipelineCreateInfo computepp_ci{{}, vk::PipelineShaderStageCreateInfo{{}, shader.get_vk_stage(), shader.module, "main"}, computepp_layout};
+    auto [result, computepp] = _dev.createComputePipeline({}, computepp_ci);
+
+    if(result != vk::Result::eSuccess) {
+        throw std::runtime_error{"Could not create vk compute pipeline."};
+    }
+
+    return Pipeline{computepp, computepp_layout, config.shaders};
+}
+
 vk::PipelineLayout PipelineManager::_find_or_build_pipeline_layout(const PipelineConfig &config) {
     const auto merged_bindings = _merge_shader_bindings(config);
     std::map<uint32_t, std::vector<ShaderBinding>> shader_sets;
@@ -123,9 +169,10 @@ vk::PipelineLayout PipelineManager::_find_or_build_pipeline_layout(const Pipelin
 
     // if pipeline doesn't have that many sets or if that particular set is null, 
     // mark as incompatible as a whole, but still check every set if it is reusable.
+    const auto push_constant_ranges = _get_push_constant_ranges(config);
     std::map<uint32_t, vk::DescriptorSetLayout> matching_layouts;
     for(const auto &pl : _layouts) {
-        bool is_compatible = true;
+        bool is_compatible = pl.push_constant_ranges == push_constant_ranges;
         for(auto &[shader_set_idx, shader_bindings] : shader_vk_sets) { 
             if(pl.desc_set_layout_handles.size() <= shader_set_idx || !pl.desc_set_layout_handles.at(shader_set_idx)) {
                 is_compatible = false;
@@ -146,8 +193,6 @@ vk::PipelineLayout PipelineManager::_find_or_build_pipeline_layout(const Pipelin
         }
     }
 
-    
-    const auto push_constant_ranges = _get_push_constant_ranges(config);
     std::vector<vk::DescriptorSetLayout> set_layouts(max_shader_set_idx + 1);
     for(const auto &[idx, layout] : shader_vk_sets) {
         if(auto it = matching_layouts.find(idx); it != end(matching_layouts)) {
@@ -157,16 +202,18 @@ vk::PipelineLayout PipelineManager::_find_or_build_pipeline_layout(const Pipelin
 
         vk::DescriptorSetLayoutCreateInfo info{{}, layout};
         set_layouts.at(idx) = _dev.createDescriptorSetLayout(info);
+        _set_layouts.emplace_back(set_layouts.at(idx), layout);
     }
     for(auto &e : set_layouts) {
         if(!e) {
             e = _dev.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{{}, 0, {}});
+            _set_layouts.emplace_back(e, std::vector<vk::DescriptorSetLayoutBinding>{});
         }
     }
 
     vk::PipelineLayoutCreateInfo pplci{{}, set_layouts, push_constant_ranges};
     auto ppl = _dev.createPipelineLayout(pplci);
-    return _layouts.emplace_back(ppl, set_layouts).layout;
+    return _layouts.emplace_back(ppl, set_layouts, push_constant_ranges).layout;
 }
 
 const std::vector<vk::DescriptorSetLayoutBinding>& PipelineManager::_get_set_layout_bindings(vk::DescriptorSetLayout dsl) const {
@@ -0,0 +1,337 @@
+#include <engine/render_graph.hpp>
+#include <engine/hash.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace eng {
+
+namespace {
+    constexpr vk::AccessFlags2 WRITE_ACCESS = vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eColorAttachmentWrite
+        | vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eHostWrite | vk::AccessFlagBits2::eMemoryWrite;
+}
+
+RenderGraphCache::RenderGraphCache(RenderGraphCache &&other) noexcept {
+    *this = std::move(other);
+}
+
+RenderGraphCache& RenderGraphCache::operator=(RenderGraphCache &&other) noexcept {
+    for(auto &set : _sets) { destroy(set); }
+    _device = other._device;
+    _allocator = other._allocator;
+    _sets = std::move(other._sets);
+    other._sets.clear();
+    return *this;
+}
+
+RenderGraphCache::~RenderGraphCache() noexcept {
+    for(auto &set : _sets) { destroy(set); }
+}
+
+void RenderGraphCache::evict(uint64_t completed_frame) {
+    std::erase_if(_sets, [&](Set &set) {
+        if(set.last_used + KEEP_FRAMES > completed_frame) { return false; }
+        destroy(set);
+        return true;
+    });
+}
+
+vk::DeviceSize RenderGraphCache::memory() const {
+    vk::DeviceSize total = 0;
+    for(const auto &set : _sets) { total += set.memory; }
+    return total;
+}
+
+RenderGraphCache::Set* RenderGraphCache::get(uint64_t signature, std::span<const RenderGraphImageDesc> descs, std::span<const uint32_t> groups, uint32_t group_count, uint64_t frame) {
+    for(auto &set : _sets) {
+        if(set.signature != signature) { continue; }
+        set.last_used = frame;
+        return &set;
+    }
+
+    Set set;
+    set.signature = signature;
+    set.last_used = frame;
+    set.groups.resize(group_count);
+    const VmaAllocationCreateInfo vmaaci{.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+    try {
+        for(const auto &desc : descs) {
+            const vk::ImageCreateInfo image_ci{
+                {}, vk::ImageType::e2D, desc.format, vk::Extent3D{desc.extent.width, desc.extent.height, 1}, 1, 1,
+                vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, desc.usage
+            };
+            set.images.push_back(Image{_device.createImage(image_ci), {}, {}});
+        }
+
+        // a group's memory fits the largest of its images. images that can't share a memory type get their own
+        for(auto group=0u; group<group_count; ++group) {
+            vk::MemoryRequirements requirements{0, 1, ~0u};
+            for(auto i=0u; i<set.images.size(); ++i) {
+                if(groups[i] != group) { continue; }
+                const auto image_requirements = _device.getImageMemoryRequirements(set.images[i].image);
+                requirements.size = std::max(requirements.size, image_requirements.size);
+                requirements.alignment = std::max(requirements.alignment, image_requirements.alignment);
+                requirements.memoryTypeBits &= image_requirements.memoryTypeBits;
+            }
+            if(requirements.memoryTypeBits == 0) { continue; }
+            VmaAllocationInfo vmaai{};
+            if(vmaAllocateMemory(_allocator, (const VkMemoryRequirements*)&requirements, &vmaaci, &set.groups[group].allocation, &vmaai) != VK_SUCCESS) {
+                set.groups[group].allocation = nullptr;
+                continue;
+            }
+            set.memory += vmaai.size;
+        }
+
+        for(auto i=0u; i<set.images.size(); ++i) {
+            auto &image = set.images[i];
+            auto allocation = set.groups[groups[i]].allocation;
+            if(!allocation) {
+                VmaAllocationInfo vmaai{};
+                if(vmaAllocateMemoryForImage(_allocator, image.image, &vmaaci, &image.allocation, &vmaai) != VK_SUCCESS) {
+                    image.allocation = nullptr;
+                    throw std::runtime_error{"Could not allocate memory for a transient image."};
+                }
+                set.memory += vmaai.size;
+                allocation = image.allocation;
+            }
+            if(vmaBindImageMemory(_allocator, allocation, image.image) != VK_SUCCESS) { throw std::runtime_error{"Could not bind a transient image's memory."}; }
+            image.view = _device.createImageView(vk::ImageViewCreateInfo{{}, image.image, vk::ImageViewType::e2D, descs[i].format, {}, {descs[i].aspect, 0, 1, 0, 1}});
+        }
+    } catch(const std::exception &error) {
+        std::cerr << error.what();
+        destroy(set);
+        return nullptr;
+    }
+
+    _sets.push_back(std::move(set));
+    return &_sets.back();
+}
+
+void RenderGraphCache::destroy(Set &set) {
+    for(auto &image : set.images) {
+        _device.destroyImageView(image.view);
+        _device.destroyImage(image.image);
+        if(image.allocation) { vmaFreeMemory(_allocator, image.allocation); }
+    }
+    for(auto &group : set.groups) {
+        if(group.allocation) { vmaFreeMemory(_allocator, group.allocation); }
+    }
+    set.images.clear();
+    set.groups.clear();
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::side_effects() {
+    _graph->_passes.at(_pass).side_effects = true;
+    return *this;
+}
+
+RenderGraph::RenderGraph(FrameArena &arena, RenderGraphCache &cache)
+    : _arena{&arena}, _cache{&cache}, _resources{arena.resource()}, _uses{arena.resource()}, _passes{arena.resource()} { }
+
+RenderGraphImage RenderGraph::import_image(vk::Image image, vk::ImageView view, const vk::ImageSubresourceRange &range, RenderGraphState *state) {
+    auto &resource = _resources.emplace_back();
+    resource.image = image;
+    resource.view = view;
+    resource.range = range;
+    resource.is_image = true;
+    resource.imported_state = state;
+    if(state) { resource.state = *state; }
+    return RenderGraphImage{(uint32_t)_resources.size() - 1};
+}
+
+RenderGraphBuffer RenderGraph::import_buffer(vk::Buffer buffer, RenderGraphState *state) {
+    auto &resource = _resources.emplace_back();
+    resource.buffer = buffer;
+    resource.imported_state = state;
+    if(state) { resource.state = *state; }
+    return RenderGraphBuffer{(uint32_t)_resources.size() - 1};
+}
+
+RenderGraphImage RenderGraph::create_image(const RenderGraphImageDesc &desc) {
+    auto &resource = _resources.emplace_back();
+    resource.desc = desc;
+    resource.range = vk::ImageSubresourceRange{desc.aspect, 0, 1, 0, 1};
+    resource.is_image = true;
+    resource.transient = true;
+    return RenderGraphImage{(uint32_t)_resources.size() - 1};
+}
+
+void RenderGraph::set_final_access(RenderGraphImage image, const RenderGraphAccess &access) {
+    auto &resource = _resources.at(image.index);
+    resource.final_access = access;
+    resource.has_final_access = true;
+}
+
+RenderGraph::PassBuilder RenderGraph::add_pass(std::string_view name, void *callable, RecordFn record) {
+    _passes.push_back(Pass{name, callable, record, (uint32_t)_uses.size()});
+    return PassBuilder{*this, (uint32_t)_passes.size() - 1};
+}
+
+void RenderGraph::use(uint32_t pass, uint32_t resource, const RenderGraphAccess &access, bool write) {
+    auto &p = _passes.at(pass);
+    if(resource >= _resources.size()) {
+        std::cerr << "Render graph pass " << p.name << " uses a resource that isn't in the graph";
+        return;
+    }
+    // a pass's uses are kept next to each other
+    if(p.first_use + p.use_count != _uses.size()) {
+        std::cerr << "Render graph pass " << p.name << " declared a use after the next pass was added";
+        return;
+    }
+    _uses.push_back(Use{resource, access, write});
+    ++p.use_count;
+}
+
+bool RenderGraph::execute(BarrierBatch &barriers, uint64_t frame) {
+    _stats = RenderGraphStats{.passes = (uint32_t)_passes.size()};
+    cull();
+    if(!create_transients(frame)) { return false; }
+
+    const auto cmd = barriers.command_buffer();
+    for(auto p=0u; p<_passes.size(); ++p) {
+        const auto &pass = _passes[p];
+        if(pass.culled) { continue; }
+        const auto uses = std::span{_uses}.subspan(pass.first_use, pass.use_count);
+        for(const auto &use : uses) {
+            auto &resource = _resources[use.resource];
+            // a transient takes over its memory from whatever used it last, with nothing worth keeping in it
+            if(resource.transient && !resource.started) {
+                resource.state = _transients->groups.at(resource.group).state;
+                resource.state.layout = vk::ImageLayout::eUndefined;
+                resource.started = true;
+            }
+            transition(resource, use.access, use.write, barriers);
+        }
+        barriers.flush();
+        pass.record(pass.callable, cmd);
+        for(const auto &use : uses) {
+            const auto &resource = _resources[use.resource];
+            if(resource.transient && resource.last_use == p) { _transients->groups.at(resource.group).state = resource.state; }
+        }
+    }
+
+    for(auto &resource : _resources) {
+        if(resource.has_final_access) { transition(resource, resource.final_access, false, barriers); }
+    }
+    barriers.flush();
+    for(const auto &resource : _resources) {
+        if(resource.imported_state) { *resource.imported_state = resource.state; }
+    }
+    return true;
+}
+
+void RenderGraph::cull() {
+    // what keeps a state or gets a final access is used after the graph, the rest only by passes that are kept. going
+    // backwards, a pass is kept when it writes something that's read later on, and then what it uses is needed before
+    // it. writes don't make a resource dead again, they may be to only a part of it
+    for(auto &resource : _resources) { resource.live = resource.imported_state || resource.has_final_access; }
+    for(auto p=_passes.size(); p-- > 0;) {
+        auto &pass = _passes[p];
+        const auto uses = std::span{_uses}.subspan(pass.first_use, pass.use_count);
+        pass.culled = !pass.side_effects && std::none_of(uses.begin(), uses.end(), [&](const Use &use) { return use.write && _resources[use.resource].live; });
+        if(pass.culled) {
+            ++_stats.culled_passes;
+            continue;
+        }
+        for(const auto &use : uses) { _resources[use.resource].live = true; }
+    }
+}
+
+bool RenderGraph::create_transients(uint64_t frame) {
+    _transients = nullptr;
+    std::pmr::vector<uint32_t> order{_arena->resource()};
+    for(auto p=0u; p<_passes.size(); ++p) {
+        const auto &pass = _passes[p];
+        if(pass.culled) { continue; }
+        for(const auto &use : std::span{_uses}.subspan(pass.first_use, pass.use_count)) {
+            auto &resource = _resources[use.resource];
+            if(!resource.transient) { continue; }
+            if(resource.first_use == ~0u) {
+                resource.first_use = p;
+                order.push_back(use.resource);
+            }
+            resource.last_use = p;
+        }
+    }
+    if(order.empty()) { return true; }
+
+    // in the order they're first used, each goes into the first group whose images are all done with by then.
+    // the groups and the descriptions are what a set of transients is looked up with
+    std::pmr::vector<uint32_t> group_ends{_arena->resource()}, groups{_arena->resource()};
+    std::pmr::vector<RenderGraphImageDesc> descs{_arena->resource()};
+    uint64_t signature = 0;
+    for(const auto idx : order) {
+        auto &resource = _resources[idx];
+        const auto free_group = std::find_if(group_ends.begin(), group_ends.end(), [&](uint32_t end) { return end < resource.first_use; });
+        resource.group = (uint32_t)(free_group - group_ends.begin());
+        if(free_group == group_ends.end()) {
+            group_ends.push_back(resource.last_use);
+        } else {
+            *free_group = resource.last_use;
+            ++_stats.aliased_transients;
+        }
+        descs.push_back(resource.desc);
+        groups.push_back(resource.group);
+        signature = Hash::combine(signature, resource.desc.format);
+        signature = Hash::combine(signature, resource.desc.extent);
+        signature = Hash::combine(signature, resource.desc.usage);
+        signature = Hash::combine(signature, resource.desc.aspect);
+        signature = Hash::combine(signature, resource.group);
+    }
+    _stats.transients = (uint32_t)order.size();
+
+    _transients = _cache->get(signature, descs, groups, (uint32_t)group_ends.size(), frame);
+    if(!_transients) { return false; }
+    for(auto i=0u; i<order.size(); ++i) {
+        auto &resource = _resources[order[i]];
+        resource.image = _transients->images[i].image;
+        resource.view = _transients->images[i].view;
+    }
+    return true;
+}
+
+void RenderGraph::transition(Resource &resource, const RenderGraphAccess &access, bool write, BarrierBatch &barriers) {
+    auto &state = resource.state;
+    const auto layout_change = resource.is_image && access.layout != state.layout;
+    // a write waits for everything before it, a read for the last write unless it was already made visible to it
+    const auto hazard = write ? (state.write_stages || state.read_stages)
+        : (state.write_stages && ((access.stages & ~state.visible_stages) || (state.write_access && (access.access & ~state.visible_access))));
+    if(!layout_change && !hazard) {
+        if(write) {
+            state = RenderGraphState{.write_stages = access.stages, .write_access = access.access & WRITE_ACCESS, .layout = state.layout};
+        } else {
+            state.read_stages |= access.stages;
+        }
+        return;
+    }
+
+    const auto src_stages = state.write_stages | state.read_stages;
+    if(resource.is_image) {
+        barriers.image(vk::ImageMemoryBarrier2{
+            src_stages, state.write_access, access.stages, access.access, state.layout, access.layout,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, resource.image, resource.range
+        });
+    } else {
+        barriers.buffer(vk::BufferMemoryBarrier2{
+            src_stages, state.write_access, access.stages, access.access,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, resource.buffer, 0, VK_WHOLE_SIZE
+        });
+    }
+
+    // a layout transition is a write too, one the reads after it only have to wait for
+    if(write || layout_change) {
+        state.write_stages = access.stages;
+        state.write_access = write ? access.access & WRITE_ACCESS : vk::AccessFlags2{};
+        state.visible_stages = write ? vk::PipelineStageFlags2{} : access.stages;
+        state.visible_access = write ? vk::AccessFlags2{} : access.access;
+        state.read_stages = write ? vk::PipelineStageFlags2{} : access.stages;
+    } else {
+        state.visible_stages |= access.stages;
+        state.visible_access |= access.access;
+        state.read_stages |= access.stages;
+    }
+    if(resource.is_image) { state.layout = access.layout; }
+}
+
+}
\ No newline at end of file
@@ -8,11 +8,24 @@
 #include <engine/buffer.hpp>
 #include <engine/texture.hpp>
 #include <engine/model_loader.hpp>
-
+#include <engine/import_job.hpp>
+#include <engine/vertex_packing.hpp>
+#include <engine/alloc_counter.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <memory_resource>
 #include <vector>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <cstdint>
 #include <iostream>
+#include <thread>
 
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include <imgui/imgui.h>
@@ -23,15 +36,27 @@
 #include <stb/stb_image.h>
 
 
-static constexpr auto layout_transition = [](vk::CommandBuffer cmd, auto img, auto old_layout, auto new_layout, auto src_stage, auto src_access, auto dst_stage, auto dst_access, auto subresource) {
-    vk::ImageMemoryBarrier img_barrier;
-    img_barrier.setImage(img).setSrcAccessMask(src_access).setDstAccessMask(dst_access).setOldLayout(old_layout).setNewLayout(new_layout).setSubresourceRange(subresource);
-    cmd.pipelineBarrier(src_stage, dst_stage, {}, {}, {}, img_barrier);
-};
+static constexpr uint32_t index_size(vk::IndexType type) {
+    switch(type) {
+        case vk::IndexType::eUint8EXT: return 1;
+        case vk::IndexType::eUint16: return 2;
+        default: return 4;
+    }
+}
+
+template<typename T> static void write_indices_as(std::span<const uint32_t> indices, std::byte *dst) {
+    std::transform(indices.begin(), indices.end(), reinterpret_cast<T*>(dst), [](uint32_t idx) { return (T)idx; });
+}
 
 namespace eng {
 
-Renderer::Renderer(Window *window): window{window} {
+Renderer::Renderer(Window *window, const RendererSettings &settings): window{window}, settings{settings} {
+    this->settings.frames_in_flight = std::max(settings.frames_in_flight, 1u);
+    this->settings.queue_depth = std::clamp(settings.queue_depth, 1u, this->settings.frames_in_flight);
+    this->settings.render_scale = std::clamp(settings.render_scale, 0.25f, 1.0f);
+    this->settings.min_render_scale = std::clamp(settings.min_render_scale, 0.25f, this->settings.render_scale);
+    renderables = &registry.archetype<Transform, MeshRef, Material, WorldBounds, Visibility>();
+
     if(!initialize_vulkan()) {
         std::cerr << "Could not initialize Vulkan API";
         return;
@@ -57,6 +82,16 @@ Renderer::Renderer(Window *window): window{window} {
         return;
     }
 
+    if(!create_meshlet_culling()) {
+        std::cerr << "Could not create meshlet culling resources, meshes are drawn whole";
+        meshlet_culling = false;
+    }
+
+    if(!create_occlusion_culling()) {
+        std::cerr << "Could not create occlusion culling resources, everything in view is drawn";
+        occlusion_culling = false;
+    }
+
     _is_properly_initialized = true;
 }
 
@@ -64,6 +99,51 @@ Renderer::~Renderer() noexcept {
     _vk.dev.waitIdle();
 }
 
+void Renderer::wait_for_frame() {
+    if(window->size_pixels.width == 0 || window->size_pixels.height == 0) {
+        return;
+    }
+
+    const auto frame = Engine::get_frame_number();
+    const auto wait_start = FramePacer::Clock::now();
+    // the frame limiter, the gpu isn't behind by more than queue_depth - 1 frames once this returns
+    if(frame > settings.queue_depth) {
+        const auto limit = frame - settings.queue_depth;
+        // a tenth of a second, a present that never makes it to the screen mustn't stop the loop
+        if(settings.low_latency && _vk.wait_for_present && limit >= _vk.first_present_id && _vk.wait_for_present(_vk.dev, _vk.swapchain, limit, 100'000'000) == VK_SUCCESS) {
+            pacer.done(limit, FramePacer::Clock::now());
+        } else {
+            const auto limit_wait_result = _vk.dev.waitForFences(_vk.per_frame_render_data.at(get_frame_resource_index(limit)).in_flight_fence, true, -1ULL);
+            if(limit_wait_result != vk::Result::eSuccess) { throw std::runtime_error{"Renderer is stuck on frame."}; }
+            pacer.done(limit, FramePacer::Clock::now());
+        }
+    }
+
+    auto &frame_data = get_frame_resources();
+    const auto rendering_wait_result = _vk.dev.waitForFences(frame_data.in_flight_fence, true, -1ULL);
+    if(rendering_wait_result != vk::Result::eSuccess) { throw std::runtime_error{"Renderer is stuck on frame."}; }
+    if(frame_data.timestamps_written) {
+        uint64_t ticks[2]{};
+        if(_vk.dev.getQueryPoolResults(frame_data.timestamps, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t), vk::QueryResultFlagBits::e64) == vk::Result::eSuccess) {
+            const auto gpu_ms = ((ticks[1] - ticks[0]) & _vk.timestamp_mask) * _vk.timestamp_period * 1e-6f;
+            pacer.gpu_time(gpu_ms);
+            if(settings.dynamic_resolution) { resolution.update(gpu_ms, frame_data.render_scale, settings.gpu_budget_ms, settings.min_render_scale, settings.render_scale); }
+        }
+        frame_data.timestamps_written = false;
+    }
+    if(frame_data.occlusion_stats) {
+        auto *occluded = static_cast<uint32_t*>(buffer_mgr->get_mapped_data(frame_data.occlusion_stats));
+        instances_occluded = *occluded;
+        *occluded = 0;
+    }
+
+    if(settings.low_latency) {
+        const auto delay = pacer.input_delay(FramePacer::Clock::now());
+        if(delay > FramePacer::Clock::duration::zero()) { std::this_thread::sleep_for(delay); }
+    }
+    pacer.waited(FramePacer::Clock::now() - wait_start);
+}
+
 void Renderer::update() {
     const auto [window_width, window_height] = window->size_pixels;
     if(window_width == 0 || window_height == 0) {
@@ -72,18 +152,29 @@ void Renderer::update() {
 
     auto &frame_data = get_frame_resources();
 
-    if(!meshes_to_upload.empty()) {
-        _vk.dev.waitIdle();
-        upload_meshes();
-    }
+    // past this point nothing of this frame's resources is in use by the gpu anymore,
+    // which is all the uploads below touch, so there is no need to wait for the whole device.
+    const auto rendering_wait_result = _vk.dev.waitForFences(frame_data.in_flight_fence, true, -1ULL);
+    if(rendering_wait_result != vk::Result::eSuccess) { throw std::runtime_error{"Renderer is stuck on frame."}; }
+    frame_data.arena->reset();
+    upload_ring.begin_frame(get_frame_resource_index(Engine::get_frame_number()));
+    const auto allocations_at_start = heap_allocation_count();
+    // the input was polled right before
+    pacer.sampled(Engine::get_frame_number(), FramePacer::Clock::now());
 
-    if(!mesh_instances_to_upload.empty()) {
-        _vk.dev.waitIdle();
+    update_imports();
+
+    if(!entities_to_remove.empty()) {
+        remove_instances();
+    }
+    if(!entities_to_upload.empty()) {
         upload_mesh_instances();
     }
+    update_transforms(frame_data);
 
-    if(window->resized) {
-        _vk.dev.waitIdle();
+    // the frames still in flight keep rendering to the old swapchain, which is destroyed once they're done
+    if(window->resized || swapchain_outdated || !_vk.swapchain) {
+        swapchain_outdated = false;
         if(!create_swapchain()) {
             std::cerr << "Could not recreate swapchain";
             return;
@@ -110,6 +201,18 @@ void Renderer::update() {
     ImGui::BeginChild("project hierarchy", {200.0f, space.y}, ImGuiChildFlags_Border);  
         ImGui::SeparatorText("Project hierarchy");
         ImGui::Text("asdfkjhl");
+        if(!import_jobs.empty()) {
+            static constexpr const char *stage_names[]{"Queued", "Parsing", "Converting", "Optimizing", "Cooking", "Uploading", "Done", "Cancelled", "Failed"};
+            ImGui::SeparatorText("Imports");
+            for(auto i=0u; i<import_jobs.size(); ++i) {
+                const auto &job = import_jobs.at(i);
+                ImGui::PushID(i);
+                ImGui::TextUnformatted(job->path().filename().string().c_str());
+                ImGui::ProgressBar(job->fraction(), {-FLT_MIN, 0.0f}, stage_names[(int)job->stage()]);
+                if(ImGui::SmallButton("Cancel")) { job->cancel(); }
+                ImGui::PopID();
+            }
+        }
     ImGui::EndChild();
 
     ImGui::SameLine();
@@ -117,23 +220,22 @@ void Renderer::update() {
     const auto gw_mz = space - ImVec2{400.0f, 0.0f};
     ImGui::SetCursorPos(ImGui::GetCursorScreenPos() - ImGui::GetStyle().WindowPadding - ImVec2{ImGui::GetStyle().ChildBorderSize, 0.0f});
     ImGui::BeginChild("game window", gw_mz, ImGuiChildFlags_Border);
-        ImGui::Image(_ui.game_im_txt_id, {1024.0f, 768.0f});
+        // the viewport is all of the child, only its part of the game image is shown
+        const auto viewport_size = ImGui::GetContentRegionAvail();
+        const auto framebuffer_scale = ImGui::GetIO().DisplayFramebufferScale;
+        resize_viewport(vk::Extent2D{(uint32_t)std::max(viewport_size.x * framebuffer_scale.x, 1.0f), (uint32_t)std::max(viewport_size.y * framebuffer_scale.y, 1.0f)});
+        const ImVec2 viewport_uv{(float)viewport_extent.width / _ui.target_extent.width, (float)viewport_extent.height / _ui.target_extent.height};
+        ImGui::Image(_ui.game_im_txt_id, viewport_size, {0.0f, 0.0f}, viewport_uv);
+        control_camera(ImGui::IsItemHovered());
+        if(ImGui::IsItemClicked()) {
+            const auto uv = (ImGui::GetMousePos() - ImGui::GetItemRectMin()) / ImGui::GetItemRectSize();
+            pick_instance(glm::vec2{uv.x, uv.y} * 2.0f - 1.0f);
+        }
         if(window->file_dropped() && ImGui::BeginDragDropSource(ImGuiDragDropFlags_SourceExtern)) {
             std::filesystem::path resource = window->payload;
             if(std::filesystem::is_regular_file(resource)) {
-                const auto directory = resource.parent_path();
-                auto geom = GeometryImporter::import(resource);
-                if(geom) {
-                    std::cout << "Loaded geometry with " << geom.meshes.size(); 
-                    for(auto &m : geom.meshes) { 
-                        if(!m.material.texture_paths.empty()) { m.material.shader_name = "default_textured"; }
-                        else { m.material.shader_name = "main"; }
-                    }    
-                    Model *m = new Model{};
-                    m->geometry = new Geometry{geom};
-                    add_object(m);
-                }
-
+                // picked up by update_imports() at the start of a later frame
+                import_jobs.push_back(std::make_unique<ImportJob>(resource, vertex_layout));
             }
             ImGui::EndDragDropSource();
         }
@@ -143,6 +245,81 @@ void Renderer::update() {
     ImGui::SetCursorPos(ImGui::GetCursorScreenPos() - ImGui::GetStyle().WindowPadding - ImVec2{ImGui::GetStyle().ChildBorderSize, 0.0f});
         ImGui::BeginChild("inspector", ii_mz, ImGuiChildFlags_Border);
             ImGui::SeparatorText("AAAAAAAAAAA");
+            ImGui::SeparatorText("Camera");
+            ImGui::DragFloat3("Position", &camera.position.x, 0.05f);
+            ImGui::SliderAngle("Field of view", &camera.fov_y, 20.0f, 120.0f);
+            ImGui::SliderFloat("Speed", &camera_speed, 0.1f, 100.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+            if(ImGui::Button("Frame all")) { camera_framed = false; }
+            ImGui::SameLine();
+            if(ImGui::Button("Add occlusion test")) { add_occlusion_test_scene(); }
+            ImGui::SeparatorText("Level of detail");
+            ImGui::SliderFloat("Pixel error", &lod_pixel_error, 0.1f, 16.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("Hysteresis", &lod_hysteresis, 0.0f, 0.9f);
+            ImGui::Text("Triangles: %zu", triangles_drawn);
+            ImGui::SeparatorText("Meshlets");
+            ImGui::BeginDisabled(!_cull.pipeline);
+            ImGui::Checkbox("Cull meshlets", &meshlet_culling);
+            ImGui::EndDisabled();
+            ImGui::Text("Meshlets: %zu", meshlets_submitted);
+            ImGui::SeparatorText("Frustum culling");
+            ImGui::Text("Instances: %zu / %zu", visible_instances.size(), renderables->size());
+            ImGui::Text("BVH nodes: %zu", instance_bvh.node_count());
+            if(picked_instance) {
+                const auto &ref = renderables->column<MeshRef>()[*picked_instance];
+                ImGui::Text("Picked: instance %u (mesh %u, lod %u)", *picked_instance, ref.mesh_idx, ref.lod);
+                if(ImGui::SmallButton("Remove")) { remove_instance(renderables->entities()[*picked_instance]); }
+            } else {
+                ImGui::TextUnformatted("Picked: none");
+            }
+            ImGui::SeparatorText("Occlusion culling");
+            ImGui::BeginDisabled(!_occlusion.pipeline);
+            ImGui::Checkbox("Cull occluded", &occlusion_culling);
+            ImGui::EndDisabled();
+            ImGui::Text("Tested: %zu, occluded: %zu", instances_occlusion_tested, instances_occluded);
+            ImGui::SeparatorText("Resolution");
+            ImGui::Text("Viewport: %ux%u, rendered at %ux%u", viewport_extent.width, viewport_extent.height, render_extent.width, render_extent.height);
+            ImGui::SliderFloat("Render scale", &settings.render_scale, 0.25f, 1.0f, "%.2f");
+            ImGui::BeginDisabled(_vk.timestamp_period == 0.0f);
+            ImGui::Checkbox("Dynamic resolution", &settings.dynamic_resolution);
+            ImGui::EndDisabled();
+            ImGui::BeginDisabled(!settings.dynamic_resolution);
+            ImGui::SliderFloat("GPU budget", &settings.gpu_budget_ms, 2.0f, 50.0f, "%.1f ms");
+            ImGui::SliderFloat("Min scale", &settings.min_render_scale, 0.25f, 1.0f, "%.2f");
+            ImGui::EndDisabled();
+            ImGui::SeparatorText("Memory");
+            ImGui::Text("Frame arena: %zu KiB", frame_data.arena->capacity() / 1024);
+            ImGui::Text("Upload ring: %zu KiB per frame%s", upload_ring.region_size() / 1024, upload_ring.device_local() ? ", device local" : "");
+            if(allocation_counting_enabled()) { ImGui::Text("Heap allocations last frame: %llu", (unsigned long long)frame_allocations); }
+            ImGui::SeparatorText("Render graph");
+            ImGui::Text("Passes: %u, culled: %u", graph_stats.passes, graph_stats.culled_passes);
+            ImGui::Text("Barriers: %u (%u images, %u buffers, %u global, %u merged)", barrier_stats.flushes, barrier_stats.image_barriers, barrier_stats.buffer_barriers, barrier_stats.memory_barriers, barrier_stats.merged);
+            ImGui::Text("Transients: %u, aliased: %u, %llu KiB", graph_stats.transients, graph_stats.aliased_transients, (unsigned long long)(graph_cache.memory() / 1024));
+            ImGui::SeparatorText("Swapchain");
+            if(ImGui::BeginCombo("Present mode", vk::to_string(settings.present_mode).c_str())) {
+                for(const auto mode : _vk.present_modes) {
+                    if(ImGui::Selectable(vk::to_string(mode).c_str(), mode == settings.present_mode)) {
+                        settings.present_mode = mode;
+                        swapchain_outdated = true;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            int swapchain_images = (int)settings.swapchain_images;
+            if(ImGui::SliderInt("Images", &swapchain_images, 2, 4)) {
+                settings.swapchain_images = (uint32_t)swapchain_images;
+                swapchain_outdated = true;
+            }
+            ImGui::Text("Images: %zu, frames in flight: %u", _vk.swapchain_images.size(), settings.frames_in_flight);
+            ImGui::SeparatorText("Frame pacing");
+            ImGui::Checkbox("Low latency", &settings.low_latency);
+            int queue_depth = (int)settings.queue_depth;
+            if(ImGui::SliderInt("Queue depth", &queue_depth, 1, (int)settings.frames_in_flight)) { settings.queue_depth = (uint32_t)queue_depth; }
+            ImGui::Text("Present wait: %s", _vk.wait_for_present ? "yes" : "no");
+            const auto &timings = pacer.stats();
+            ImGui::Text("Frame: %.2f ms (%.0f fps)", timings.frame, timings.frame > 0.0f ? 1000.0f / timings.frame : 0.0f);
+            ImGui::Text("CPU: %.2f ms, GPU: %.2f ms", timings.cpu, timings.gpu);
+            ImGui::Text("Waited: %.2f ms", timings.wait);
+            ImGui::Text("Input to done: %.2f ms", timings.latency);
         ImGui::EndChild();
     ImGui::End();
 
@@ -150,81 +327,243 @@ void Renderer::update() {
     }
     
 
-    const auto rendering_wait_result = _vk.dev.waitForFences(frame_data.in_flight_fence, true, -1ULL);
-    const auto [swapchain_image_result, swapchain_image_index] = _vk.dev.acquireNextImageKHR(_vk.swapchain, -1ULL, frame_data.image_ready);
-    if(rendering_wait_result != vk::Result::eSuccess) { throw std::runtime_error{"Renderer is stuck on frame."}; }
-    if(swapchain_image_result != vk::Result::eSuccess) { throw std::runtime_error{"Swapchain is busy."}; }
+    // suboptimal still signals image_ready and has to be presented, out of date skips the frame before the fence is reset
+    uint32_t swapchain_image_index{0};
+    const auto swapchain_image_result = _vk.dev.acquireNextImageKHR(_vk.swapchain, -1ULL, frame_data.image_ready, {}, &swapchain_image_index);
+    if(swapchain_image_result == vk::Result::eErrorOutOfDateKHR) {
+        swapchain_outdated = true;
+        return;
+    }
+    if(swapchain_image_result == vk::Result::eSuboptimalKHR) { swapchain_outdated = true; }
+    else if(swapchain_image_result != vk::Result::eSuccess) { throw std::runtime_error{"Swapchain is busy."}; }
     
     _vk.dev.resetFences(frame_data.in_flight_fence);
+    if(const auto frames_in_flight = _vk.per_frame_render_data.size(); Engine::get_frame_number() > frames_in_flight) {
+        texture_mgr->evict(Engine::get_frame_number() - frames_in_flight);
+        buffer_mgr->evict(Engine::get_frame_number() - frames_in_flight);
+        destroy_retired_swapchains(Engine::get_frame_number() - frames_in_flight);
+        destroy_retired_viewport_targets(Engine::get_frame_number() - frames_in_flight);
+        graph_cache.evict(Engine::get_frame_number() - frames_in_flight);
+        std::erase_if(retired_descriptor_pools, [&](const auto &retired) {
+            if(retired.second > Engine::get_frame_number() - frames_in_flight) { return false; }
+            _vk.dev.destroyDescriptorPool(retired.first);
+            return true;
+        });
+    }
+    // the frames in flight may still be reading the old pyramid through their own descriptors, only this one's are free
+    if(_occlusion.pipeline && frame_data.hiz_version != _occlusion.hiz_version) { write_hiz_descriptors(frame_data); }
     
     auto &cmd = frame_data.cmdbuff;
-    auto &img = _vk.swapchain_images.at(swapchain_image_index);
     cmd.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    if(frame_data.timestamps) {
+        cmd.resetQueryPool(frame_data.timestamps, 0, 2);
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame_data.timestamps, 0);
+    }
+
+    // may grow the mesh buffers, so it goes before anything takes their handles
+    BarrierBatch barriers{cmd, frame_data.arena->resource()};
+    if(!meshes_to_upload.empty()) {
+        upload_meshes(cmd, barriers);
+    }
 
-    vk::RenderingInfo rendering_info;
-    std::vector<vk::RenderingAttachmentInfo> color_attachments{
-        vk::RenderingAttachmentInfo{_vk.swapchain_views.at(swapchain_image_index), vk::ImageLayout::eColorAttachmentOptimal, {}, {}, {}, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, vk::ClearColorValue{0.0f, 0.0f, 0.0f, 1.0f}},
-        vk::RenderingAttachmentInfo{_ui.game_image_view, vk::ImageLayout::eColorAttachmentOptimal, {}, {}, {}, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, vk::ClearColorValue{0.0f, 0.0f, 0.0f, 1.0f}}
+    const auto render_scale = settings.dynamic_resolution ? resolution.scale() : settings.render_scale;
+    frame_data.render_scale = render_scale;
+    render_extent = vk::Extent2D{
+        std::clamp((uint32_t)std::lround(viewport_extent.width * render_scale), 1u, viewport_extent.width),
+        std::clamp((uint32_t)std::lround(viewport_extent.height * render_scale), 1u, viewport_extent.height)
     };
-    
-    rendering_info.setRenderArea(vk::Rect2D{{}, {1024, 768}})
-        .setLayerCount(1)
-        .setViewMask(0)
-        .setColorAttachments(color_attachments.at(1));
-    
-    layout_transition(cmd, _ui.game_image, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eNone, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eColorAttachmentWrite, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}); 
+    const auto upscale = render_extent != viewport_extent;
+    const vk::Extent2D window_extent{window_width, window_height};
+
+    // the first instances added are all put in view, after that the camera stays where it was moved to
+    if(!camera_framed && !instance_bvh.bounds().empty()) {
+        const auto bounds = instance_bvh.bounds();
+        camera.frame(bounds.center(), glm::length(bounds.max - bounds.min) * 0.5f);
+        camera_framed = true;
+    }
+    // reversed depth with the far plane at infinity, the near plane goes to 1. the frustum's far plane lets everything through
+    const auto aspect = (float)render_extent.width / render_extent.height;
+    const auto clip_from_world = camera.clip_from_world(aspect);
+    const auto frustum = Frustum::from_matrix(clip_from_world);
+    // only fails once more is streamed than a region holds, the draws then see whatever the old offset has
+    if(const auto constants = upload_ring.push(FrameConstants{clip_from_world})) { frame_data.constants_offset = constants.offset; }
+    else { std::cerr << "upload ring is full"; }
+    cull_instances(frustum);
+    select_lods(camera.position, camera.pixels_per_unit((float)render_extent.height));
+    const auto meshlet_jobs = prepare_meshlet_culling(frame_data);
+    const auto occlusion_jobs = prepare_occlusion_culling(frame_data);
+
+    // the frame as passes over what they read and write, the graph puts the barriers between them.
+    // the acquire's semaphore is waited on at color output, so the swapchain image's first use waits for that
+    RenderGraph graph{*frame_data.arena, graph_cache};
+    const vk::ImageSubresourceRange color_range{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+    RenderGraphState swapchain_state{.write_stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput};
+    const auto swapchain_image = graph.import_image(_vk.swapchain_images.at(swapchain_image_index), _vk.swapchain_views.at(swapchain_image_index), color_range, &swapchain_state);
+    graph.set_final_access(swapchain_image, rg::present);
+    const auto game_image = graph.import_image(_ui.game_image, _ui.game_image_view, color_range, &_ui.game_image_state);
+    // below the viewport's size the scene goes to the scene image first and is blitted up into the game image after
+    const auto scene_image = upscale ? graph.create_image(RenderGraphImageDesc{vk::Format::eB8G8R8A8Srgb, _ui.target_extent, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc}) : game_image;
+    const auto depth_image = graph.create_image(RenderGraphImageDesc{_ui.depth_format, _ui.target_extent, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled, vk::ImageAspectFlagBits::eDepth});
+    RenderGraphImage hiz;
+    RenderGraphBuffer visibility, instance_draws, instance_draw_counts, instance_phases, meshlet_draws, meshlet_draw_counts;
+    if(occlusion_jobs > 0) {
+        hiz = graph.import_image(_occlusion.hiz_image, _occlusion.hiz_view, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, _occlusion.hiz_levels, 0, 1}, &_occlusion.hiz_state);
+        visibility = graph.import_buffer(buffer_mgr->get(_occlusion.visibility), &_occlusion.visibility_state);
+        instance_draws = graph.import_buffer(buffer_mgr->get(frame_data.instance_draws));
+        instance_draw_counts = graph.import_buffer(buffer_mgr->get(frame_data.instance_draw_counts));
+        instance_phases = graph.import_buffer(buffer_mgr->get(frame_data.instance_phases));
+    }
+    if(meshlet_jobs > 0) {
+        meshlet_draws = graph.import_buffer(buffer_mgr->get(frame_data.meshlet_draws));
+        meshlet_draw_counts = graph.import_buffer(buffer_mgr->get(frame_data.meshlet_draw_counts));
+    }
 
-    cmd.beginRendering(rendering_info);
-    cmd.bindVertexBuffers(0, buffer_mgr->get(_vk.buffer_vertex), {0});
-    cmd.bindIndexBuffer(buffer_mgr->get(_vk.buffer_index), 0, vk::IndexType::eUint32);
-    uint32_t first_index = 0, vertex_offset = 0;
-    const MeshInstance *prev_instance{};
-    for(const auto &mi : mesh_instances) {
-        if(!mi.pipeline) { continue; }
-        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mi.pipeline);
-        if(mi.material_descriptor) { cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mi.pipeline_layout, 2, mi.material_descriptor, {}); }
-        cmd.drawIndexed(meshes.at(mi.mesh_idx).original->vertex_indices.size(), 1, first_index, vertex_offset, 0);
-        if(!prev_instance) { prev_instance = &mi; }
-        else {
-            if(mi.mesh_idx != prev_instance->mesh_idx) {
-                first_index += meshes.at(mi.mesh_idx).original->vertex_indices.size();
-                vertex_offset += meshes.at(mi.mesh_idx).original->vertex_positions.size();
-            }
-        }
+    // 0 is the far plane, so nothing is hidden behind a pyramid that hasn't been built yet.
+    // with no instance visible yet the first frame draws everything in the second phase
+    if(occlusion_jobs > 0 && !_occlusion.cleared) {
+        graph.add_pass("clear occlusion", [&](vk::CommandBuffer cmd) {
+            cmd.clearColorImage(graph.image(hiz), vk::ImageLayout::eTransferDstOptimal, vk::ClearColorValue{0.0f, 0.0f, 0.0f, 0.0f}, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, _occlusion.hiz_levels, 0, 1});
+            cmd.fillBuffer(graph.buffer(visibility), 0, VK_WHOLE_SIZE, 0);
+        }).write(hiz, rg::clear).write(visibility, rg::clear);
+        _occlusion.built_extent = render_extent;
+        _occlusion.cleared = true;
     }
-    cmd.endRendering();
-    layout_transition(cmd, _ui.game_image, vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eColorAttachmentWrite, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}); 
+    // the counts of both phases are zeroed up front, the second phase's draws are recorded after the first's are read
+    if(occlusion_jobs > 0 || meshlet_jobs > 0) {
+        auto pass = graph.add_pass("clear draw counts", [&](vk::CommandBuffer cmd) {
+            if(instance_draw_counts) { cmd.fillBuffer(graph.buffer(instance_draw_counts), 0, VK_WHOLE_SIZE, 0); }
+            if(meshlet_draw_counts) { cmd.fillBuffer(graph.buffer(meshlet_draw_counts), 0, VK_WHOLE_SIZE, 0); }
+        });
+        if(instance_draw_counts) { pass.write(instance_draw_counts, rg::clear); }
+        if(meshlet_draw_counts) { pass.write(meshlet_draw_counts, rg::clear); }
+    }
+
+    // the second phase draws what the first missed but turned out visible against the pyramid of the first's depth
+    const auto phase_count = occlusion_jobs > 0 ? 2u : 1u;
+    for(auto phase=0u; phase<phase_count; ++phase) {
+        if(phase > 0) {
+            graph.add_pass("build hiz", [&](vk::CommandBuffer cmd) { build_hiz(cmd, barriers, frame_data, graph.view(depth_image), render_extent); })
+                .read(depth_image, rg::compute_sampled)
+                .write(hiz, rg::compute_storage);
+            _occlusion.built_extent = render_extent;
+        }
+        if(occlusion_jobs > 0) {
+            // the first phase tests against last frame's pyramid, so it projects into the extent that was built at
+            const auto hiz_viewport = phase == 0 ? _occlusion.built_extent : render_extent;
+            graph.add_pass("cull occlusion", [&, phase, hiz_viewport](vk::CommandBuffer cmd) {
+                cull_occlusion(cmd, frame_data, clip_from_world, hiz_viewport, occlusion_jobs, phase);
+                // the count of occluded instances is read on the host once the frame's fence signaled
+                if(phase > 0) {
+                    barriers.memory(vk::MemoryBarrier2{vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite, vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead});
+                    barriers.flush();
+                }
+            })
+                .read(hiz, rg::compute_sampled_general)
+                .write(visibility, rg::compute_storage)
+                .write(instance_draws, rg::compute_storage)
+                .write(instance_draw_counts, rg::compute_storage)
+                .write(instance_phases, rg::compute_storage);
+        }
+        if(meshlet_jobs > 0) {
+            auto pass = graph.add_pass("cull meshlets", [&, phase](vk::CommandBuffer cmd) { cull_meshlets(cmd, frame_data, frustum, glm::vec4{camera.position, 1.0f}, meshlet_jobs, phase); })
+                .write(meshlet_draws, rg::compute_storage)
+                .write(meshlet_draw_counts, rg::compute_storage);
+            if(instance_phases) { pass.read(instance_phases, rg::compute_read); }
+        }
 
-    rendering_info.setRenderArea({{}, {window_width, window_height}});
-    rendering_info.setColorAttachments(color_attachments.at(0));
-    layout_transition(cmd, img, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eNone, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eColorAttachmentWrite, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}); 
-    cmd.beginRendering(rendering_info);
-    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, _ui.pipeline);
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
-    cmd.endRendering();
-    layout_transition(cmd, img, vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::ePresentSrcKHR, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eColorAttachmentWrite, vk::PipelineStageFlagBits::eBottomOfPipe, vk::AccessFlagBits::eNone, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}); 
+        auto pass = graph.add_pass("scene", [&, phase](vk::CommandBuffer cmd) {
+            // depth is reversed, cleared to 0 with nearer being greater
+            const auto load_op = phase == 0 ? vk::AttachmentLoadOp::eClear : vk::AttachmentLoadOp::eLoad;
+            const vk::RenderingAttachmentInfo color_attachment{graph.view(scene_image), vk::ImageLayout::eColorAttachmentOptimal, {}, {}, {}, load_op, vk::AttachmentStoreOp::eStore, vk::ClearColorValue{0.0f, 0.0f, 0.0f, 1.0f}};
+            const vk::RenderingAttachmentInfo depth_attachment{graph.view(depth_image), vk::ImageLayout::eDepthAttachmentOptimal, {}, {}, {}, load_op, vk::AttachmentStoreOp::eStore, vk::ClearDepthStencilValue{0.0f, 0}};
+            cmd.beginRendering(vk::RenderingInfo{}.setRenderArea(vk::Rect2D{{}, render_extent}).setLayerCount(1).setColorAttachments(color_attachment).setPDepthAttachment(&depth_attachment));
+            draw_instances(cmd, frame_data, phase, render_extent);
+            cmd.endRendering();
+        });
+        pass.write(scene_image, rg::color_attachment).write(depth_image, rg::depth_attachment);
+        for(const auto buffer : {instance_draws, instance_draw_counts, meshlet_draws, meshlet_draw_counts}) {
+            if(buffer) { pass.read(buffer, rg::indirect_read); }
+        }
+    }
+    if(upscale) {
+        graph.add_pass("upscale", [&](vk::CommandBuffer cmd) {
+            // bilinear, from the rendered part of the scene image to the viewport's part of the game image
+            const vk::ImageSubresourceLayers color_layers{vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+            const vk::ImageBlit blit{
+                color_layers, std::array<vk::Offset3D, 2>{vk::Offset3D{0, 0, 0}, vk::Offset3D{(int32_t)render_extent.width, (int32_t)render_extent.height, 1}},
+                color_layers, std::array<vk::Offset3D, 2>{vk::Offset3D{0, 0, 0}, vk::Offset3D{(int32_t)viewport_extent.width, (int32_t)viewport_extent.height, 1}}
+            };
+            cmd.blitImage(graph.image(scene_image), vk::ImageLayout::eTransferSrcOptimal, graph.image(game_image), vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+        }).read(scene_image, rg::blit_src).write(game_image, rg::blit_dst);
+    }
+    graph.add_pass("ui", [&](vk::CommandBuffer cmd) {
+        const vk::RenderingAttachmentInfo color_attachment{graph.view(swapchain_image), vk::ImageLayout::eColorAttachmentOptimal, {}, {}, {}, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, vk::ClearColorValue{0.0f, 0.0f, 0.0f, 1.0f}};
+        cmd.beginRendering(vk::RenderingInfo{}.setRenderArea(vk::Rect2D{{}, window_extent}).setLayerCount(1).setColorAttachments(color_attachment));
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, _ui.pipeline);
+        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+        cmd.endRendering();
+    }).read(game_image, rg::fragment_sampled).write(swapchain_image, rg::color_attachment);
+
+    if(!graph.execute(barriers, Engine::get_frame_number())) { throw std::runtime_error{"Could not create the frame's transient images."}; }
+    graph_stats = graph.stats();
+    barrier_stats = barriers.stats();
+    if(frame_data.timestamps) { cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, frame_data.timestamps, 1); }
     cmd.end();
 
+    upload_ring.flush();
     vk::PipelineStageFlags wait_flags[]{vk::PipelineStageFlagBits::eColorAttachmentOutput};
-    vk::SubmitInfo submit_info{frame_data.image_ready, wait_flags, cmd, frame_data.rendering_done};
-    std::vector<vk::SubmitInfo> submit_infos{submit_info};
-    if(!_vk.queue_graphics->submit(submit_infos, frame_data.in_flight_fence)) {
+    const auto rendering_done = _vk.swapchain_rendering_done.at(swapchain_image_index);
+    vk::SubmitInfo submit_info{frame_data.image_ready, wait_flags, cmd, rendering_done};
+    if(!_vk.queue_graphics->submit(submit_info, frame_data.in_flight_fence)) {
         std::cerr << "Problem with queue submit";
         return;
     }
-
-    try {
-        uint32_t image_indices[]{swapchain_image_index};
-        [[maybe_unused]] const auto present_result = _vk.queue_presentation->get_vkqueue().presentKHR(vk::PresentInfoKHR{frame_data.rendering_done, _vk.swapchain, image_indices});
-    } catch(const std::exception &error) {
-        std::cerr << error.what();
+    frame_data.timestamps_written = !!frame_data.timestamps;
+    pacer.submitted(Engine::get_frame_number(), FramePacer::Clock::now());
+
+    uint32_t image_indices[]{swapchain_image_index};
+    const uint64_t present_ids[]{Engine::get_frame_number()};
+    vk::PresentIdKHR present_id{1, present_ids};
+    vk::PresentInfoKHR present_info{rendering_done, _vk.swapchain, image_indices};
+    if(_vk.present_id) { present_info.setPNext(&present_id); }
+    // the pointer overload returns what the enhanced one throws. the semaphore is waited on even when it's out of date
+    const auto present_result = _vk.queue_presentation->get_vkqueue().presentKHR(&present_info);
+    if(present_result == vk::Result::eSuccess || present_result == vk::Result::eSuboptimalKHR) {
+        if(_vk.first_present_id == ~0ull) { _vk.first_present_id = Engine::get_frame_number(); }
     }
+    if(present_result == vk::Result::eSuboptimalKHR || present_result == vk::Result::eErrorOutOfDateKHR) {
+        swapchain_outdated = true;
+    } else if(present_result != vk::Result::eSuccess) {
+        std::cerr << "Problem with present: " << vk::to_string(present_result);
+    }
+    frame_allocations = heap_allocation_count() - allocations_at_start;
+}
+
+const Geometry* Renderer::add_geometry(Geometry &&geometry) {
+    return geometries.emplace_back(std::make_unique<Geometry>(std::move(geometry))).get();
 }
 
-void Renderer::add_object(const Model *model) {
-    if(!model || !model->geometry) { return; }
+void Renderer::add_object(const Model &model) {
+    if(!model.geometry) { return; }
 
-    for(const auto &gomesh : model->geometry->meshes) {
+    // the geometry's nodes go under one placing the whole model, meshes outside of every node hang off that one too
+    const auto &geometry = *model.geometry;
+    const auto create_node = [this](SceneGraph::Node parent, const glm::mat4 &local) {
+        const auto node = scene.create(parent, local);
+        if(node_instances.size() <= node) { node_instances.resize(node + 1); }
+        node_instances[node] = 0;
+        return node;
+    };
+    const auto model_node = create_node(SceneGraph::NO_NODE, model.transform);
+    std::vector<SceneGraph::Node> nodes;
+    std::vector<SceneGraph::Node> mesh_nodes(geometry.meshes.size(), model_node);
+    for(const auto &gn : geometry.nodes) {
+        nodes.push_back(create_node(gn.parent == GeometryNode::NO_PARENT ? model_node : nodes.at(gn.parent), gn.transform));
+        std::fill_n(mesh_nodes.begin() + gn.first_mesh, gn.mesh_count, nodes.back());
+    }
+
+    for(auto mesh_idx=0u; mesh_idx<geometry.meshes.size(); ++mesh_idx) {
+        const auto &gomesh = geometry.meshes[mesh_idx];
         const auto it = std::find_if(cbegin(meshes), cend(meshes), [&gomesh](const auto &e) { return e.original == &gomesh; });
         const auto is_already_processed = it != cend(meshes);
 
@@ -234,13 +573,51 @@ void Renderer::add_object(const Model *model) {
         } else {
             meshidx = meshes.size();
             meshes_to_upload.emplace_back(meshidx);
-            meshes.emplace_back(&gomesh);
+            auto &gpumesh = meshes.emplace_back(&gomesh);
+            gpumesh.layout = gomesh.packed_vertices.empty() ? VertexLayout::full() : gomesh.packed_layout;
+            gpumesh.decode = VertexDecode::make(gpumesh.layout, gomesh.bounds);
+            gpumesh.aabb_min = gomesh.bounds.position_min;
+            gpumesh.aabb_max = gomesh.bounds.position_max;
+            gpumesh.lod_count = (uint32_t)std::min<size_t>(gomesh.lod_count(), MESH_MAX_LODS);
+            for(auto l=0u; l<gpumesh.lod_count; ++l) { gpumesh.lods[l] = gomesh.lod(l); }
+            // the largest index of each type is left out, it would restart the primitive if that ever gets enabled
+            const auto vertex_count = gomesh.vertex_count();
+            if(_vk.index_type_uint8 && vertex_count < 0xFF) { gpumesh.index_type = vk::IndexType::eUint8EXT; }
+            else if(vertex_count < 0xFFFF) { gpumesh.index_type = vk::IndexType::eUint16; }
         }
-        mesh_instances_to_upload.emplace_back(mesh_instances.size());
-        mesh_instances.push_back(MeshInstance{.mesh_idx = meshidx});
+        const auto entity = registry.create();
+        registry.add(entity, Transform{mesh_nodes[mesh_idx]});
+        for(auto node = mesh_nodes[mesh_idx]; node != SceneGraph::NO_NODE; node = scene.parent(node)) { ++node_instances[node]; }
+        registry.add(entity, MeshRef{.mesh_idx = meshidx});
+        entities_to_upload.push_back(entity);
     }
 }
 
+void Renderer::update_imports() {
+    for(auto &job : import_jobs) {
+        if(!job->ready()) { continue; }
+
+        auto geom = job->take();
+        if(geom.meshes.empty()) {
+            if(job->stage() == ImportStage::Failed) { std::cerr << fmt::format("Could not import \"{}\"\n", job->path().string()); }
+            continue;
+        }
+
+        std::cout << fmt::format("Loaded geometry with {} meshes\n", geom.meshes.size());
+        for(auto &m : geom.meshes) { 
+            if(!m.material.texture_paths.empty()) { m.material.shader_name = "default_textured"; }
+            else { m.material.shader_name = "main"; }
+        }    
+        add_object(Model{add_geometry(std::move(geom))});
+        job->finish();
+    }
+
+    std::erase_if(import_jobs, [](const auto &job) {
+        const auto stage = job->stage();
+        return stage == ImportStage::Done || stage == ImportStage::Cancelled || stage == ImportStage::Failed;
+    });
+}
+
 bool Renderer::initialize_vulkan() {
     std::vector<const char*> ireq_exts, ireq_layers, dreq_exts;
 
@@ -329,15 +706,51 @@ bool Renderer::initialize_vulkan() {
         return false;
     }
 
+    // descriptor indexing goes through the 1.2 features, they can't be chained together with its own struct.
+    // drawIndirectCount is optional, without it the meshlets are not culled
+    const auto vk12_supported = vkpdev.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>().get<vk::PhysicalDeviceVulkan12Features>();
     vk::PhysicalDeviceFeatures2 dev_features;
-    vk::PhysicalDeviceDynamicRenderingFeatures dev_dynren_features;
-    vk::PhysicalDeviceDescriptorIndexingFeatures dev_descind_features;
-    dev_dynren_features.setDynamicRendering(true);
-    dev_descind_features.setRuntimeDescriptorArray(true)
+    vk::PhysicalDeviceVulkan13Features dev_vk13_features;
+    vk::PhysicalDeviceVulkan12Features dev_vk12_features;
+    // the render graph's barriers are synchronization2's
+    dev_vk13_features.setDynamicRendering(true).setSynchronization2(true);
+    dev_vk12_features.setRuntimeDescriptorArray(true)
         .setDescriptorBindingVariableDescriptorCount(true)
-        .setShaderSampledImageArrayNonUniformIndexing(true);
-    dev_features.setPNext(&dev_dynren_features);
-    dev_dynren_features.setPNext(&dev_descind_features);
+        .setShaderSampledImageArrayNonUniformIndexing(true)
+        .setDrawIndirectCount(vk12_supported.drawIndirectCount);
+    dev_features.features.setTextureCompressionBC(vkpdev.getFeatures().textureCompressionBC)
+        .setDrawIndirectFirstInstance(vkpdev.getFeatures().drawIndirectFirstInstance);
+    dev_features.setPNext(&dev_vk13_features);
+    dev_vk13_features.setPNext(&dev_vk12_features);
+
+    // optional, lets meshes with less than 256 vertices use 8 bit indices
+    vk::PhysicalDeviceIndexTypeUint8FeaturesEXT dev_uint8_features;
+    const auto dev_exts = vkpdev.enumerateDeviceExtensionProperties();
+    const auto has_uint8_ext = std::any_of(dev_exts.begin(), dev_exts.end(), [](const auto &e) { return std::string_view{e.extensionName} == VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME; });
+    if(has_uint8_ext && vkpdev.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceIndexTypeUint8FeaturesEXT>().get<vk::PhysicalDeviceIndexTypeUint8FeaturesEXT>().indexTypeUint8) {
+        dreq_exts.push_back(VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME);
+        dev_uint8_features.setIndexTypeUint8(true);
+        dev_vk12_features.setPNext(&dev_uint8_features);
+        _vk.index_type_uint8 = true;
+    }
+
+    // optional, present wait lets the low latency mode wait for frames to be on screen instead of only rendered
+    vk::PhysicalDevicePresentIdFeaturesKHR dev_present_id_features;
+    vk::PhysicalDevicePresentWaitFeaturesKHR dev_present_wait_features;
+    const auto has_present_exts = std::any_of(dev_exts.begin(), dev_exts.end(), [](const auto &e) { return std::string_view{e.extensionName} == VK_KHR_PRESENT_ID_EXTENSION_NAME; })
+        && std::any_of(dev_exts.begin(), dev_exts.end(), [](const auto &e) { return std::string_view{e.extensionName} == VK_KHR_PRESENT_WAIT_EXTENSION_NAME; });
+    bool has_present_wait = false;
+    if(has_present_exts) {
+        const auto present_features = vkpdev.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+        has_present_wait = present_features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId && present_features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+    }
+    if(has_present_wait) {
+        dreq_exts.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        dreq_exts.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        dev_present_id_features.setPresentId(true).setPNext(&dev_present_wait_features);
+        dev_present_wait_features.setPresentWait(true).setPNext(dev_features.pNext);
+        dev_features.setPNext(&dev_present_id_features);
+    }
 
     std::vector<vk::DeviceQueueCreateInfo> vkdev_qcis;
     float vk_qps[]{1.0f};
@@ -369,8 +782,18 @@ bool Renderer::initialize_vulkan() {
     _vk.dbg_msng = vkdbgmsngr;
     _vk.surface = vksurface;
     _vk.pdev = vkpdev;
+    // the indirect draws pass the instance's transform on as their first instance
+    _vk.draw_indirect_count = vk12_supported.drawIndirectCount && vkpdev.getFeatures().drawIndirectFirstInstance;
     _vk.queue_families = std::move(vkpdev_qfamilies);
     _vk.dev = vkdev;
+    if(has_present_wait) {
+        _vk.present_id = true;
+        _vk.wait_for_present = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkdev.getProcAddr("vkWaitForPresentKHR"));
+    }
+    if(const auto timestamp_bits = vkpdev.getQueueFamilyProperties().at(vk_gqf.family_index).timestampValidBits; timestamp_bits > 0) {
+        _vk.timestamp_period = vkpdev.getProperties().limits.timestampPeriod;
+        _vk.timestamp_mask = timestamp_bits >= 64 ? ~0ull : (1ull << timestamp_bits) - 1;
+    }
     _vk.queues.emplace_back(_vk.dev, vkdev_qs.at(0), vk_gqf.family_index);
     uint32_t queue_presentation_idx = 0;
     if(vk_gqf.family_index != vk_pqf.family_index) {
@@ -423,10 +846,17 @@ bool Renderer::create_swapchain() {
         throw std::runtime_error{"Swapchain doesn't support image format: B8G8R8A8Srgb"};
     }
 
+    // fifo is the only mode every surface has. a max image count of 0 means there's no maximum
+    _vk.present_modes = _vk.pdev.getSurfacePresentModesKHR(_vk.surface);
+    auto present_mode = settings.present_mode;
+    if(std::find(cbegin(_vk.present_modes), cend(_vk.present_modes), present_mode) == cend(_vk.present_modes)) { present_mode = vk::PresentModeKHR::eFifo; }
+    auto image_count = std::max(settings.swapchain_images, srf_caps.minImageCount);
+    if(srf_caps.maxImageCount > 0) { image_count = std::min(image_count, srf_caps.maxImageCount); }
+
     _vk.swapchain_ci = vk::SwapchainCreateInfoKHR{
         {},
         _vk.surface,
-        2,
+        image_count,
         vk::Format::eB8G8R8A8Srgb,
         vk::ColorSpaceKHR::eSrgbNonlinear,
         swapchain_image_extent,
@@ -437,54 +867,111 @@ bool Renderer::create_swapchain() {
         swapchain_queue_families.data(),
         vk::SurfaceTransformFlagBitsKHR::eIdentity, // not required by the standard
         vk::CompositeAlphaFlagBitsKHR::eOpaque,
-        vk::PresentModeKHR::eFifo,
-        VK_TRUE
+        present_mode,
+        VK_TRUE,
+        _vk.swapchain
     };
 
+    // the old one is retired by the create, whether that works or not. images it already handed out can still be
+    // presented, so it's destroyed later, see RetiredSwapchain
+    vk::SwapchainKHR swapchain;
+    const auto create_result = _vk.dev.createSwapchainKHR(&_vk.swapchain_ci, nullptr, &swapchain);
     if(_vk.swapchain) {
-        for(auto &v : _vk.swapchain_views) {
-            _vk.dev.destroyImageView(v);
-        }
-        _vk.dev.destroySwapchainKHR(_vk.swapchain);
+        _vk.retired_swapchains.push_back(RetiredSwapchain{
+            _vk.swapchain, std::move(_vk.swapchain_views), std::move(_vk.swapchain_rendering_done),
+            Engine::get_frame_number() + _vk.per_frame_render_data.size()
+        });
+        _vk.swapchain_views.clear();
+        _vk.swapchain_rendering_done.clear();
+        _vk.first_present_id = ~0ull;
     }
-    
-    try {
-        _vk.swapchain = _vk.dev.createSwapchainKHR(_vk.swapchain_ci);
-    } catch (const std::exception &error) {
+    _vk.swapchain_ci.oldSwapchain = nullptr;
+    if(create_result != vk::Result::eSuccess) {
         _vk.swapchain = nullptr;
         _vk.swapchain_images.clear();
-        _vk.swapchain_views.clear();
         return false;
     }
+    _vk.swapchain = swapchain;
     _vk.swapchain_images = _vk.dev.getSwapchainImagesKHR(_vk.swapchain);
     _vk.swapchain_views.resize(_vk.swapchain_images.size());
     for(auto i=0u; i<_vk.swapchain_views.size(); ++i) {
         vk::ImageViewCreateInfo ivci{{}, _vk.swapchain_images[i], vk::ImageViewType::e2D, _vk.swapchain_ci.imageFormat, {}, {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}};
         _vk.swapchain_views[i] = _vk.dev.createImageView(ivci);
     }
+    _vk.swapchain_rendering_done.resize(_vk.swapchain_images.size());
+    for(auto &s : _vk.swapchain_rendering_done) { s = _vk.dev.createSemaphore({}); }
 
     return true;
 }
 
+void Renderer::destroy_retired_swapchains(uint64_t completed_frame) {
+    std::erase_if(_vk.retired_swapchains, [&](const auto &retired) {
+        if(retired.frame > completed_frame) { return false; }
+        for(auto &v : retired.views) { _vk.dev.destroyImageView(v); }
+        for(auto &s : retired.rendering_done) { _vk.dev.destroySemaphore(s); }
+        _vk.dev.destroySwapchainKHR(retired.swapchain);
+        return true;
+    });
+}
+
 bool Renderer::create_rendering_resources() {
     try {
         ppmgr = std::make_unique<PipelineManager>(_vk.dev);
         buffer_mgr = std::make_unique<BufferManager>(_vk.dev, _vk.allocator, _vk.queue_graphics);
-        texture_mgr = std::make_unique<TextureManager>(_vk.dev, &*buffer_mgr, _vk.allocator);
-        vk::BufferCreateInfo vertex_ci{{}, 1024*1024, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst};
-        vk::BufferCreateInfo index_ci{{}, 1024*100, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst};
+        texture_mgr = std::make_unique<TextureManager>(_vk.pdev, _vk.dev, &*buffer_mgr, _vk.allocator);
+        graph_cache = RenderGraphCache{_vk.dev, _vk.allocator};
+        // all three are grown by upload_meshes, which copies what they hold into the bigger ones
+        vk::BufferCreateInfo vertex_ci{{}, 1024*1024, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc};
+        vk::BufferCreateInfo index_ci{{}, 1024*256, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc};
         VmaAllocationCreateInfo vertex_vmaaci{.usage = VMA_MEMORY_USAGE_AUTO};
         _vk.buffer_vertex = buffer_mgr->allocate(vertex_ci, vertex_vmaaci);
         _vk.buffer_index = buffer_mgr->allocate(index_ci, vertex_vmaaci);
+        _vk.buffer_meshlets = buffer_mgr->allocate(vk::BufferCreateInfo{{}, 1024*256, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc}, vertex_vmaaci);
+        _vk.material_sampler = _vk.dev.createSampler(vk::SamplerCreateInfo{
+            {}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear,
+            vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat,
+            0.0f, false, 0.0f, false, vk::CompareOp::eNever, 0.0f, VK_LOD_CLAMP_NONE
+        });
 
-        for(auto i=0llu; i<_vk.swapchain_images.size(); ++i) {
+        for(auto i=0u; i<settings.frames_in_flight; ++i) {
             auto cp = CommandPool{_vk.dev, vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer, _vk.queue_families.at(VkQueueFamilyType::Graphics).at(0).family_index};
             auto buff = cp.allocate_buffers(vk::CommandBufferLevel::ePrimary, 1).at(0);
-            vk::Semaphore image_ready, rendering_done;
-            image_ready = _vk.dev.createSemaphore({});
-            rendering_done = _vk.dev.createSemaphore({});
+            const auto image_ready = _vk.dev.createSemaphore({});
             vk::Fence in_flight = _vk.dev.createFence(vk::FenceCreateInfo{vk::FenceCreateFlagBits::eSignaled});
-            _vk.per_frame_render_data.emplace_back(std::move(cp), buff, image_ready, rendering_done, in_flight);
+            auto &frame = _vk.per_frame_render_data.emplace_back(std::move(cp), buff, image_ready, in_flight, std::make_unique<FrameArena>());
+            if(_vk.timestamp_period > 0.0f) { frame.timestamps = _vk.dev.createQueryPool(vk::QueryPoolCreateInfo{{}, vk::QueryType::eTimestamp, 2}); }
+        }
+
+        const auto frame_count = (uint32_t)_vk.per_frame_render_data.size();
+        const auto limits = _vk.pdev.getProperties().limits;
+        const auto upload_alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+        if(!upload_ring.create(*buffer_mgr, vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer, UPLOAD_RING_REGION_SIZE, frame_count, upload_alignment)) {
+            std::cerr << "Could not create the upload ring";
+            return false;
+        }
+
+        // the instances' world matrices, rewritten by the cpu whenever something moved, and the constants of the frame
+        const vk::DescriptorSetLayoutBinding transform_bindings[]{
+            {0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex},
+            {1, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eVertex}
+        };
+        _vk.transform_set_layout = _vk.dev.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{{}, transform_bindings});
+        const vk::DescriptorPoolSize transform_poolsizes[]{{vk::DescriptorType::eStorageBuffer, frame_count}, {vk::DescriptorType::eUniformBufferDynamic, frame_count}};
+        _vk.transform_descpool = _vk.dev.createDescriptorPool(vk::DescriptorPoolCreateInfo{{}, frame_count, transform_poolsizes});
+        VmaAllocationCreateInfo transforms_vmaaci{
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO
+        };
+        for(auto &frame : _vk.per_frame_render_data) {
+            frame.instance_transforms = buffer_mgr->allocate(vk::BufferCreateInfo{{}, FrameRenderResources::MAX_INSTANCE_TRANSFORMS * sizeof(glm::mat4), vk::BufferUsageFlagBits::eStorageBuffer}, transforms_vmaaci);
+            if(!frame.instance_transforms) { return false; }
+            frame.transform_descriptor = _vk.dev.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{_vk.transform_descpool, _vk.transform_set_layout}).at(0);
+            vk::DescriptorBufferInfo desc_bi{buffer_mgr->get(frame.instance_transforms), 0, VK_WHOLE_SIZE};
+            vk::DescriptorBufferInfo constants_bi{upload_ring.buffer(), 0, sizeof(FrameConstants)};
+            _vk.dev.updateDescriptorSets({
+                vk::WriteDescriptorSet{frame.transform_descriptor, 0, 0, vk::DescriptorType::eStorageBuffer, {}, desc_bi, {}},
+                vk::WriteDescriptorSet{frame.transform_descriptor, 1, 0, vk::DescriptorType::eUniformBufferDynamic, {}, constants_bi, {}}
+            }, {});
         }
     } catch (const std::exception &error) {
         return false;
@@ -517,10 +1004,11 @@ bool Renderer::initialize_imgui() {
     }
 
     std::vector<vk::DescriptorPoolSize> imguidpss{
-        vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, 5}
+        vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, 16}
     };
 
-    vk::DescriptorPoolCreateInfo imguidpci{vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, 5, imguidpss};
+    // the font and the game image, and the game images of retired viewport targets
+    vk::DescriptorPoolCreateInfo imguidpci{vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, 16, imguidpss};
     _ui.descpool = _vk.dev.createDescriptorPool(imguidpci);
 
     ImGui_ImplGlfw_InitForVulkan(window->get_glfwptr(), true);
@@ -531,8 +1019,9 @@ bool Renderer::initialize_imgui() {
     imguiii.QueueFamily = _vk.queue_families.at(VkQueueFamilyType::Graphics).at(0).family_index;
     imguiii.Queue = _vk.queue_graphics->get_vkqueue();
     imguiii.DescriptorPool = _ui.descpool;
-    imguiii.MinImageCount = _vk.swapchain_ci.minImageCount;
-    imguiii.ImageCount = _vk.swapchain_images.size();
+    // imgui keeps its vertex buffers per image count, which is per frame in flight here
+    imguiii.MinImageCount = 2;
+    imguiii.ImageCount = std::max(settings.frames_in_flight, 2u);
     imguiii.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
     imguiii.UseDynamicRendering = true;
     imguiii.ColorAttachmentFormat = VK_FORMAT_B8G8R8A8_SRGB;
@@ -546,88 +1035,401 @@ bool Renderer::initialize_imgui() {
     PipelineConfig imguippc{
         get_or_create_shaders("imgui"),
         {vk::DynamicState::eViewportWithCount, vk::DynamicState::eScissorWithCount},
-        {{0, 32, vk::VertexInputRate::eVertex}}
+        {{0, 32, vk::VertexInputRate::eVertex}},
+        {},
+        {vk::Format::eB8G8R8A8Srgb}
     };
     auto imguipp = ppmgr->get_or_create_pipeline(imguippc);
     _ui.pipeline = imguipp.pipeline;
 
+    _ui.sampler = _vk.dev.createSampler(vk::SamplerCreateInfo{});
+
+    // sampled for the occlusion culling's depth pyramid. d16 is always supported for both
+    for(const auto format : {vk::Format::eD32Sfloat, vk::Format::eD16Unorm}) {
+        const auto features = _vk.pdev.getFormatProperties(format).optimalTilingFeatures;
+        if(features & vk::FormatFeatureFlagBits::eDepthStencilAttachment && features & vk::FormatFeatureFlagBits::eSampledImage) {
+            _ui.depth_format = format;
+            break;
+        }
+    }
+
+    // the game window's size isn't known before its first frame, the window's is as good a guess as any
     const auto [window_width, window_height] = window->size_pixels;
+    viewport_extent = vk::Extent2D{std::max(window_width, 1u), std::max(window_height, 1u)};
+    return create_viewport_targets(viewport_extent);
+}
+
+bool Renderer::create_viewport_targets(vk::Extent2D extent) {
+    _ui.target_extent = extent;
+    VmaAllocationCreateInfo target_vmaaci{
+        .usage = VMA_MEMORY_USAGE_AUTO
+    };
+
+    // b8g8r8a8 srgb is required to support being blitted from and to, with linear filtering
     vk::ImageCreateInfo game_image_ci{
         {}, vk::ImageType::e2D, vk::Format::eB8G8R8A8Srgb,
-        vk::Extent3D{window_width, window_height, 1}, 1, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled
+        vk::Extent3D{extent.width, extent.height, 1}, 1, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst
     };
-    
-    VmaAllocationCreateInfo game_image_vmaaci{
-        .usage = VMA_MEMORY_USAGE_AUTO
-    };
-    vmaCreateImage(_vk.allocator, (const VkImageCreateInfo*)&game_image_ci, &game_image_vmaaci, (VkImage*)&_ui.game_image, &_ui.game_image_alloc, &_ui.game_image_alloci);
+    if(vmaCreateImage(_vk.allocator, (const VkImageCreateInfo*)&game_image_ci, &target_vmaaci, (VkImage*)&_ui.game_image, &_ui.game_image_alloc, &_ui.game_image_alloci) != VK_SUCCESS) {
+        return false;
+    }
     vk::ImageViewCreateInfo game_image_view_ci{{}, _ui.game_image, vk::ImageViewType::e2D, vk::Format::eB8G8R8A8Srgb, {}, {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}};
     _ui.game_image_view = _vk.dev.createImageView(game_image_view_ci);
-    _ui.sampler = _vk.dev.createSampler(vk::SamplerCreateInfo{});
     _ui.game_im_txt_id = ImGui_ImplVulkan_AddTexture(_ui.sampler, _ui.game_image_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    _ui.game_image_state = RenderGraphState{};
 
+    // the first time around the occlusion culling isn't created yet, it makes its pyramid itself
+    if(_occlusion.pipeline && !create_hiz()) {
+        std::cerr << "Could not recreate the depth pyramid, everything in view is drawn";
+        _occlusion.pipeline = nullptr;
+        occlusion_culling = false;
+    }
     return true;
 }
 
-void Renderer::upload_meshes() {
-    std::vector<float> vertices;
-    std::vector<uint32_t> indices;
-    for(auto i=0u; i<meshes_to_upload.size(); ++i) {
-        const auto idx = meshes_to_upload.at(i);
-        auto &gpumesh = meshes.at(idx);
-        
-        for(auto i=0u; i<gpumesh.original->vertex_positions.size(); ++i) {
-            vertices.push_back(gpumesh.original->vertex_positions[i].x);
-            vertices.push_back(gpumesh.original->vertex_positions[i].y);
-            vertices.push_back(gpumesh.original->vertex_positions[i].z);
-
-            if(!gpumesh.original->vertex_normals.empty()) {
-                vertices.push_back(gpumesh.original->vertex_normals[i].x);
-                vertices.push_back(gpumesh.original->vertex_normals[i].y);
-                vertices.push_back(gpumesh.original->vertex_normals[i].z);
-            } else {
-                vertices.push_back(0.0f);
-                vertices.push_back(0.0f);
-                vertices.push_back(0.0f);
+void Renderer::retire_viewport_targets() {
+    RetiredViewportTargets retired{
+        .game_image = _ui.game_image,
+        .game_image_view = _ui.game_image_view,
+        .game_image_alloc = _ui.game_image_alloc,
+        .game_im_txt_id = _ui.game_im_txt_id,
+        .frame = Engine::get_frame_number()
+    };
+    if(_occlusion.hiz_image) {
+        retired.hiz_image = _occlusion.hiz_image;
+        retired.hiz_alloc = _occlusion.hiz_alloc;
+        retired.hiz_view = _occlusion.hiz_view;
+        retired.hiz_level_views = std::move(_occlusion.hiz_level_views);
+        _occlusion.hiz_level_views.clear();
+        _occlusion.hiz_image = nullptr;
+        _occlusion.cleared = false;
+    }
+    _ui.retired_targets.push_back(std::move(retired));
+}
+
+void Renderer::destroy_retired_viewport_targets(uint64_t completed_frame) {
+    std::erase_if(_ui.retired_targets, [&](const auto &retired) {
+        if(retired.frame > completed_frame) { return false; }
+        ImGui_ImplVulkan_RemoveTexture((VkDescriptorSet)retired.game_im_txt_id);
+        _vk.dev.destroyImageView(retired.game_image_view);
+        vmaDestroyImage(_vk.allocator, retired.game_image, retired.game_image_alloc);
+        if(retired.hiz_image) {
+            for(auto &v : retired.hiz_level_views) { _vk.dev.destroyImageView(v); }
+            _vk.dev.destroyImageView(retired.hiz_view);
+            vmaDestroyImage(_vk.allocator, retired.hiz_image, retired.hiz_alloc);
+        }
+        return true;
+    });
+}
+
+void Renderer::resize_viewport(vk::Extent2D extent) {
+    viewport_extent = extent;
+    if(extent.width <= _ui.target_extent.width && extent.height <= _ui.target_extent.height) { return; }
+
+    // the targets only grow, and in steps, so dragging the window's edge recreates them every now and then instead of every frame.
+    // the frames in flight keep using the old ones until they're done, see RetiredViewportTargets
+    const auto grow = [](uint32_t needed, uint32_t size) {
+        return std::max(size, (needed + RendererUIObjects::VIEWPORT_TARGET_STEP - 1) / RendererUIObjects::VIEWPORT_TARGET_STEP * RendererUIObjects::VIEWPORT_TARGET_STEP);
+    };
+    const vk::Extent2D target_extent{grow(extent.width, _ui.target_extent.width), grow(extent.height, _ui.target_extent.height)};
+    retire_viewport_targets();
+    if(!create_viewport_targets(target_extent)) { throw std::runtime_error{"Could not create the viewport's render targets."}; }
+}
+
+bool Renderer::create_meshlet_culling() {
+    if(!_vk.draw_indirect_count) {
+        meshlet_culling = false;
+        return true;
+    }
+
+    try {
+        auto pipeline = ppmgr->get_or_create_pipeline(PipelineConfig{get_or_create_shaders("meshlet_cull")});
+        _cull.pipeline = pipeline.pipeline;
+        _cull.pipeline_layout = pipeline.layout;
+
+        const auto frame_count = (uint32_t)_vk.per_frame_render_data.size();
+        const auto poolsize = vk::DescriptorPoolSize{vk::DescriptorType::eStorageBuffer, 6 * frame_count};
+        _cull.descpool = _vk.dev.createDescriptorPool(vk::DescriptorPoolCreateInfo{{}, frame_count, poolsize});
+        const auto desc_layout = ppmgr->get_layout(pipeline.layout).desc_set_layout_handles.at(0);
+
+        // the jobs are written by the cpu every frame, the draws and their counts only ever by the culling shader.
+        // there's room for the draws of both occlusion culling phases. the instance phases are written by instance_cull.comp
+        VmaAllocationCreateInfo jobs_vmaaci{
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO
+        };
+        VmaAllocationCreateInfo draws_vmaaci{.usage = VMA_MEMORY_USAGE_AUTO};
+        for(auto &frame : _vk.per_frame_render_data) {
+            frame.meshlet_cull_jobs = buffer_mgr->allocate(vk::BufferCreateInfo{{}, RendererCullObjects::MAX_JOBS * sizeof(MeshletCullJob), vk::BufferUsageFlagBits::eStorageBuffer}, jobs_vmaaci);
+            frame.meshlet_draws = buffer_mgr->allocate(vk::BufferCreateInfo{{}, 2 * RendererCullObjects::MAX_DRAWS * sizeof(vk::DrawIndexedIndirectCommand), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer}, draws_vmaaci);
+            frame.meshlet_draw_counts = buffer_mgr->allocate(vk::BufferCreateInfo{{}, 2 * RendererCullObjects::MAX_INSTANCES * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst}, draws_vmaaci);
+            frame.instance_phases = buffer_mgr->allocate(vk::BufferCreateInfo{{}, RendererOcclusionObjects::MAX_INSTANCES * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer}, draws_vmaaci);
+            if(!frame.meshlet_cull_jobs || !frame.meshlet_draws || !frame.meshlet_draw_counts || !frame.instance_phases) { throw std::runtime_error{"Could not allocate meshlet culling buffers."}; }
+
+            frame.meshlet_cull_descriptor = _vk.dev.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{_cull.descpool, desc_layout}).at(0);
+            const Handle<Buffer> bindings[]{_vk.buffer_meshlets, frame.meshlet_cull_jobs, frame.meshlet_draws, frame.meshlet_draw_counts, frame.instance_phases, frame.instance_transforms};
+            for(auto i=0u; i<std::size(bindings); ++i) {
+                vk::DescriptorBufferInfo desc_bi{buffer_mgr->get(bindings[i]), 0, VK_WHOLE_SIZE};
+                vk::WriteDescriptorSet write_dset{frame.meshlet_cull_descriptor, i, 0, vk::DescriptorType::eStorageBuffer, {}, desc_bi, {}};
+                _vk.dev.updateDescriptorSets(write_dset, {});
             }
+            frame.meshlets_version = meshlets_version;
+        }
+    } catch(const std::exception &error) {
+        std::cerr << error.what();
+        _cull.pipeline = nullptr;
+        return false;
+    }
+    return true;
+}
 
-            if(!gpumesh.original->vertex_texture_coords.empty()) {
-                vertices.push_back(gpumesh.original->vertex_texture_coords[i].x);
-                vertices.push_back(gpumesh.original->vertex_texture_coords[i].y);
-            } else {
-                vertices.push_back(0.0f);
-                vertices.push_back(0.0f);
+bool Renderer::create_occlusion_culling() {
+    // the meshlet culling owns the instance phases it reads, without it there's nothing to cull the meshlets of occluded instances with
+    if(!_cull.pipeline || _ui.depth_format == vk::Format::eUndefined) {
+        occlusion_culling = false;
+        return true;
+    }
+
+    try {
+        auto pipeline = ppmgr->get_or_create_pipeline(PipelineConfig{get_or_create_shaders("instance_cull")});
+        auto reduce_pipeline = ppmgr->get_or_create_pipeline(PipelineConfig{get_or_create_shaders("hiz_reduce")});
+        _occlusion.pipeline_layout = pipeline.layout;
+        _occlusion.reduce_pipeline = reduce_pipeline.pipeline;
+        _occlusion.reduce_pipeline_layout = reduce_pipeline.layout;
+
+        // only ever read with texelFetch
+        _occlusion.hiz_sampler = _vk.dev.createSampler(vk::SamplerCreateInfo{{}, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest,
+            vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge});
+
+        const auto frame_count = (uint32_t)_vk.per_frame_render_data.size();
+        const vk::DescriptorPoolSize poolsizes[]{
+            {vk::DescriptorType::eStorageBuffer, 6 * frame_count},
+            {vk::DescriptorType::eCombinedImageSampler, (1 + RendererOcclusionObjects::MAX_HIZ_LEVELS) * frame_count},
+            {vk::DescriptorType::eStorageImage, RendererOcclusionObjects::MAX_HIZ_LEVELS * frame_count},
+        };
+        _occlusion.descpool = _vk.dev.createDescriptorPool(vk::DescriptorPoolCreateInfo{{}, (1 + RendererOcclusionObjects::MAX_HIZ_LEVELS) * frame_count, poolsizes});
+        const auto reduce_desc_layout = ppmgr->get_layout(reduce_pipeline.layout).desc_set_layout_handles.at(0);
+        const std::vector<vk::DescriptorSetLayout> reduce_desc_layouts(RendererOcclusionObjects::MAX_HIZ_LEVELS, reduce_desc_layout);
+
+        VmaAllocationCreateInfo jobs_vmaaci{
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO
+        };
+        VmaAllocationCreateInfo draws_vmaaci{.usage = VMA_MEMORY_USAGE_AUTO};
+        // coherent, so the count can be read and zeroed without invalidating or flushing
+        VmaAllocationCreateInfo stats_vmaaci{
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO,
+            .requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        };
+        _occlusion.visibility = buffer_mgr->allocate(vk::BufferCreateInfo{{}, RendererOcclusionObjects::MAX_INSTANCES * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst}, draws_vmaaci);
+        if(!_occlusion.visibility) { throw std::runtime_error{"Could not allocate instance visibility buffer."}; }
+
+        const auto desc_layout = ppmgr->get_layout(pipeline.layout).desc_set_layout_handles.at(0);
+        for(auto &frame : _vk.per_frame_render_data) {
+            frame.instance_cull_jobs = buffer_mgr->allocate(vk::BufferCreateInfo{{}, RendererOcclusionObjects::MAX_INSTANCES * sizeof(InstanceCullJob), vk::BufferUsageFlagBits::eStorageBuffer}, jobs_vmaaci);
+            frame.instance_draws = buffer_mgr->allocate(vk::BufferCreateInfo{{}, 2 * RendererOcclusionObjects::MAX_INSTANCES * sizeof(vk::DrawIndexedIndirectCommand), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer}, draws_vmaaci);
+            frame.instance_draw_counts = buffer_mgr->allocate(vk::BufferCreateInfo{{}, 2 * RendererOcclusionObjects::MAX_INSTANCES * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst}, draws_vmaaci);
+            frame.occlusion_stats = buffer_mgr->allocate(vk::BufferCreateInfo{{}, sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer}, stats_vmaaci);
+            if(!frame.instance_cull_jobs || !frame.instance_draws || !frame.instance_draw_counts || !frame.occlusion_stats) { throw std::runtime_error{"Could not allocate occlusion culling buffers."}; }
+            *static_cast<uint32_t*>(buffer_mgr->get_mapped_data(frame.occlusion_stats)) = 0;
+
+            frame.instance_cull_descriptor = _vk.dev.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{_occlusion.descpool, desc_layout}).at(0);
+            frame.hiz_reduce_descriptors = _vk.dev.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{_occlusion.descpool, reduce_desc_layouts});
+            const Handle<Buffer> bindings[]{frame.instance_cull_jobs, frame.instance_draws, frame.instance_draw_counts, _occlusion.visibility, frame.instance_phases};
+            for(auto i=0u; i<std::size(bindings); ++i) {
+                vk::DescriptorBufferInfo desc_bi{buffer_mgr->get(bindings[i]), 0, VK_WHOLE_SIZE};
+                vk::WriteDescriptorSet write_dset{frame.instance_cull_descriptor, i, 0, vk::DescriptorType::eStorageBuffer, {}, desc_bi, {}};
+                _vk.dev.updateDescriptorSets(write_dset, {});
             }
+            // binding 5 is the pyramid, see write_hiz_descriptors
+            vk::DescriptorBufferInfo stats_bi{buffer_mgr->get(frame.occlusion_stats), 0, VK_WHOLE_SIZE};
+            _vk.dev.updateDescriptorSets(vk::WriteDescriptorSet{frame.instance_cull_descriptor, 6, 0, vk::DescriptorType::eStorageBuffer, {}, stats_bi, {}}, {});
         }
+        if(!create_hiz()) { throw std::runtime_error{"Could not create depth pyramid image."}; }
+        _occlusion.pipeline = pipeline.pipeline;
+    } catch(const std::exception &error) {
+        std::cerr << error.what();
+        _occlusion.pipeline = nullptr;
+        return false;
+    }
+    return true;
+}
 
-        indices.insert(indices.end(), gpumesh.original->vertex_indices.begin(), gpumesh.original->vertex_indices.end());
+bool Renderer::create_hiz() {
+    // half the size of the depth, rounded up, down to 1x1. the culling only reads the part below what was rendered
+    _occlusion.hiz_extent = vk::Extent2D{std::max((_ui.target_extent.width + 1) / 2, 1u), std::max((_ui.target_extent.height + 1) / 2, 1u)};
+    _occlusion.hiz_levels = 1;
+    for(auto size = std::max(_occlusion.hiz_extent.width, _occlusion.hiz_extent.height); size > 1; size = (size + 1) / 2) { ++_occlusion.hiz_levels; }
+    if(_occlusion.hiz_levels > RendererOcclusionObjects::MAX_HIZ_LEVELS) { return false; }
+
+    vk::ImageCreateInfo hiz_image_ci{
+        {}, vk::ImageType::e2D, vk::Format::eR32Sfloat,
+        vk::Extent3D{_occlusion.hiz_extent.width, _occlusion.hiz_extent.height, 1}, _occlusion.hiz_levels, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, 
+        vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst
+    };
+    VmaAllocationCreateInfo hiz_vmaaci{.usage = VMA_MEMORY_USAGE_AUTO};
+    if(vmaCreateImage(_vk.allocator, (const VkImageCreateInfo*)&hiz_image_ci, &hiz_vmaaci, (VkImage*)&_occlusion.hiz_image, &_occlusion.hiz_alloc, nullptr) != VK_SUCCESS) {
+        _occlusion.hiz_image = nullptr;
+        return false;
     }
-    meshes_to_upload = {};
+    _occlusion.hiz_view = _vk.dev.createImageView(vk::ImageViewCreateInfo{{}, _occlusion.hiz_image, vk::ImageViewType::e2D, vk::Format::eR32Sfloat, {}, {vk::ImageAspectFlagBits::eColor, 0, _occlusion.hiz_levels, 0, 1}});
+    for(auto level=0u; level<_occlusion.hiz_levels; ++level) {
+        _occlusion.hiz_level_views.push_back(_vk.dev.createImageView(vk::ImageViewCreateInfo{{}, _occlusion.hiz_image, vk::ImageViewType::e2D, vk::Format::eR32Sfloat, {}, {vk::ImageAspectFlagBits::eColor, level, 1, 0, 1}}));
+    }
+    // a new image starts out undefined
+    _occlusion.cleared = false;
+    _occlusion.hiz_state = RenderGraphState{};
+    ++_occlusion.hiz_version;
+    return true;
+}
 
-    if(!buffer_mgr->insert(_vk.buffer_vertex, 0, std::as_bytes(std::span{vertices}))) {
-        std::cerr << "error when writing to vertex buffer";
+void Renderer::write_hiz_descriptors(FrameRenderResources &frame) {
+    // level 0's reads the frame's depth, see build_hiz
+    for(auto level=1u; level<_occlusion.hiz_levels; ++level) {
+        const auto descset = frame.hiz_reduce_descriptors.at(level);
+        const vk::DescriptorImageInfo src_ii{_occlusion.hiz_sampler, _occlusion.hiz_level_views.at(level - 1), vk::ImageLayout::eGeneral};
+        const vk::DescriptorImageInfo dst_ii{{}, _occlusion.hiz_level_views.at(level), vk::ImageLayout::eGeneral};
+        _vk.dev.updateDescriptorSets({
+            vk::WriteDescriptorSet{descset, 0, 0, vk::DescriptorType::eCombinedImageSampler, src_ii, {}, {}},
+            vk::WriteDescriptorSet{descset, 1, 0, vk::DescriptorType::eStorageImage, dst_ii, {}, {}}
+        }, {});
     }
-    if(!buffer_mgr->insert(_vk.buffer_index, 0, std::as_bytes(std::span{indices}))) {
-        std::cerr << "error when writing to index buffer";
+    vk::DescriptorImageInfo hiz_ii{_occlusion.hiz_sampler, _occlusion.hiz_view, vk::ImageLayout::eGeneral};
+    _vk.dev.updateDescriptorSets(vk::WriteDescriptorSet{frame.instance_cull_descriptor, 5, 0, vk::DescriptorType::eCombinedImageSampler, hiz_ii, {}, {}}, {});
+    frame.hiz_version = _occlusion.hiz_version;
+}
+
+void Renderer::upload_meshes(vk::CommandBuffer cmd, BarrierBatch &barriers) {
+    // new meshes are appended behind everything already uploaded, so frames still in flight
+    // never read what is written here and the copies can simply be recorded into this frame.
+    // cooked meshes are copied from their mapping straight into the staging buffers,
+    // the rest is interleaved by the vertex packer while writing.
+    // meshes of different layouts share the vertex buffer, vertexOffset counts in strides of the mesh's own layout,
+    // so every mesh starts at a multiple of its stride.
+    // same for the index regions, which are in each mesh's own index type.
+    // the meshlets get their ranges made absolute, so the culling shader can write the draws straight from them.
+    size_t vertex_bytes = 0, index_bytes = 0, meshlet_count = 0;
+    std::vector<size_t> vertex_starts(meshes_to_upload.size()), index_starts(meshes_to_upload.size());
+    const auto vertex_base = buffer_mgr->size(_vk.buffer_vertex), index_base = buffer_mgr->size(_vk.buffer_index);
+    const auto meshlet_base = buffer_mgr->size(_vk.buffer_meshlets) / sizeof(GpuMeshlet);
+    for(auto i=0u; i<meshes_to_upload.size(); ++i) {
+        const auto idx = meshes_to_upload.at(i);
+        auto &gpumesh = meshes.at(idx);
+        const auto stride = gpumesh.layout.stride;
+        const auto vertex_start = (vertex_base + vertex_bytes + stride - 1) / stride * stride;
+        vertex_starts.at(i) = vertex_start - vertex_base;
+        const auto index_stride = index_size(gpumesh.index_type);
+        const auto index_start = (index_base + index_bytes + index_stride - 1) / index_stride * index_stride;
+        index_starts.at(i) = index_start - index_base;
+        // index_count stays 0 until the indices are written, the mesh isn't drawn before
+        gpumesh.first_index = index_start / index_stride;
+        gpumesh.vertex_offset = vertex_start / stride;
+        gpumesh.first_meshlet = meshlet_base + meshlet_count;
+        gpumesh.meshlet_count = gpumesh.original->meshlets.size();
+        meshlet_count += gpumesh.meshlet_count;
+        vertex_bytes = vertex_starts.at(i) + gpumesh.original->vertex_count() * stride;
+        index_bytes = index_starts.at(i) + gpumesh.original->index_count() * index_stride;
+    }
+
+    const auto write_vertices = [&](std::byte *dst) {
+        for(auto i=0u; i<meshes_to_upload.size(); ++i) {
+            const auto &gpumesh = meshes.at(meshes_to_upload.at(i));
+            const auto &mesh = *gpumesh.original;
+            auto *mesh_dst = dst + vertex_starts.at(i);
+            if(!mesh.packed_vertices.empty()) { memcpy(mesh_dst, mesh.packed_vertices.data(), mesh.packed_vertices.size()); } 
+            else { VertexPacker::pack(VertexPacker::streams(mesh), gpumesh.layout, mesh.bounds, mesh_dst); }
+        }
+    };
+    const auto write_indices = [&](std::byte *dst) {
+        for(auto i=0u; i<meshes_to_upload.size(); ++i) {
+            const auto &gpumesh = meshes.at(meshes_to_upload.at(i));
+            const auto &mesh = *gpumesh.original;
+            const auto indices = mesh.packed_indices.empty() ? std::span<const uint32_t>{mesh.vertex_indices} : mesh.packed_indices;
+            auto *mesh_dst = dst + index_starts.at(i);
+            switch(gpumesh.index_type) {
+                case vk::IndexType::eUint8EXT: write_indices_as<uint8_t>(indices, mesh_dst); break;
+                case vk::IndexType::eUint16: write_indices_as<uint16_t>(indices, mesh_dst); break;
+                default: memcpy(mesh_dst, indices.data(), indices.size_bytes()); break;
+            }
+        }
+    };
+    const auto write_meshlets = [&](std::byte *dst) {
+        auto *meshlet_dst = reinterpret_cast<GpuMeshlet*>(dst);
+        for(const auto idx : meshes_to_upload) {
+            const auto &gpumesh = meshes.at(idx);
+            for(const auto &m : gpumesh.original->meshlets) {
+                *meshlet_dst++ = GpuMeshlet{{m.center, m.radius}, {m.cone_axis, m.cone_cutoff}, gpumesh.first_index + m.first_index, m.index_count, gpumesh.vertex_offset};
+            }
+        }
+    };
+
+    // a buffer the upload doesn't fit in goes into one twice as big. the frames in flight keep reading the old one until
+    // it's evicted with the staging buffers. the draws get the vertex and index buffers when they're recorded, and
+    // prepare_meshlet_culling points each frame's descriptor at the new meshlet buffer
+    const auto frame = Engine::get_frame_number();
+    bool copies_wait = false;
+    const auto fit = [&](Handle<Buffer> &buffer, size_t end, std::string_view name) {
+        if(end <= buffer_mgr->capacity(buffer)) { return true; }
+        // the copy reads what earlier frames' uploads wrote
+        if(!copies_wait) {
+            barriers.memory(vk::MemoryBarrier2{vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite, vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferRead});
+            barriers.flush();
+            copies_wait = true;
+        }
+        const auto capacity = std::max(end, 2 * buffer_mgr->capacity(buffer));
+        const auto grown = buffer_mgr->grow(buffer, capacity, VmaAllocationCreateInfo{.usage = VMA_MEMORY_USAGE_AUTO}, cmd, frame);
+        if(!grown) {
+            std::cerr << fmt::format("Could not grow the {} buffer to {} bytes\n", name, capacity);
+            return false;
+        }
+        buffer = grown;
+        return true;
+    };
+
+    // meshes that couldn't be written stay queued and are tried again next frame
+    const auto vertices_written = fit(_vk.buffer_vertex, vertex_base + vertex_bytes, "vertex")
+        && buffer_mgr->insert(_vk.buffer_vertex, vertex_base, vertex_bytes, write_vertices, cmd, frame);
+    const auto indices_written = vertices_written && fit(_vk.buffer_index, index_base + index_bytes, "index")
+        && buffer_mgr->insert(_vk.buffer_index, index_base, index_bytes, write_indices, cmd, frame);
+    if(!vertices_written || !indices_written) {
+        std::cerr << fmt::format("Could not upload {} meshes ({} bytes of vertices, {} of indices), retrying next frame\n", meshes_to_upload.size(), vertex_bytes, index_bytes);
+    } else {
+        for(const auto idx : meshes_to_upload) { meshes.at(idx).index_count = meshes.at(idx).original->index_count(); }
+        const auto meshlets_before = _vk.buffer_meshlets;
+        // meshes without their meshlets are still drawn, just not culled
+        if(!fit(_vk.buffer_meshlets, (meshlet_base + meshlet_count) * sizeof(GpuMeshlet), "meshlet")
+            || !buffer_mgr->insert(_vk.buffer_meshlets, meshlet_base * sizeof(GpuMeshlet), meshlet_count * sizeof(GpuMeshlet), write_meshlets, cmd, frame)) {
+            std::cerr << "error when writing to meshlet buffer";
+            for(const auto idx : meshes_to_upload) { meshes.at(idx).meshlet_count = 0; }
+        }
+        if(_vk.buffer_meshlets != meshlets_before) { ++meshlets_version; }
     }
+
+    barriers.memory(vk::MemoryBarrier2{
+        vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+        vk::PipelineStageFlagBits2::eVertexAttributeInput | vk::PipelineStageFlagBits2::eIndexInput | vk::PipelineStageFlagBits2::eComputeShader,
+        vk::AccessFlagBits2::eVertexAttributeRead | vk::AccessFlagBits2::eIndexRead | vk::AccessFlagBits2::eShaderStorageRead
+    });
+    if(vertices_written && indices_written) { meshes_to_upload = {}; }
 }
 
 void Renderer::upload_mesh_instances() {
-    for(auto i=0u; i<mesh_instances_to_upload.size(); ++i) {
-        const auto idx = mesh_instances_to_upload.at(i);
-        auto &meshinst = mesh_instances.at(idx);
-        const auto &gpumesh = meshes.at(meshinst.mesh_idx);
+    for(const auto entity : entities_to_upload) {
+        const auto &gpumesh = meshes.at(registry.get<MeshRef>(entity)->mesh_idx);
 
         const std::vector<Shader>* materialshaders = get_or_create_shaders(gpumesh.original->material.shader_name);
         auto pipeline = ppmgr->get_or_create_pipeline(PipelineConfig{
             materialshaders,
             {vk::DynamicState::eScissorWithCount, vk::DynamicState::eViewportWithCount},
             {
-                vk::VertexInputBindingDescription{0, sizeof(gpumesh.original->vertex_positions.at(0)) + sizeof(gpumesh.original->vertex_normals.at(0)) + sizeof(gpumesh.original->vertex_texture_coords.at(0)), vk::VertexInputRate::eVertex}
-            }
+                vk::VertexInputBindingDescription{0, gpumesh.layout.stride, vk::VertexInputRate::eVertex}
+            },
+            gpumesh.layout,
+            {vk::Format::eB8G8R8A8Srgb},
+            _ui.depth_format
         });
-        meshinst.pipeline = pipeline.pipeline;
-        meshinst.pipeline_layout = pipeline.layout;
+        Material material{pipeline.pipeline, pipeline.layout};
 
         if(!gpumesh.original->material.texture_paths.empty()) {
             const auto poolsize = vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, 1};
@@ -635,7 +1437,8 @@ void Renderer::upload_mesh_instances() {
 
             const auto desc_layout = ppmgr->get_layout(pipeline.layout).desc_set_layout_handles.at(2);
             auto descset = _vk.dev.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{pool, desc_layout});
-            meshinst.material_descriptor = descset.at(0);
+            material.descriptor = descset.at(0);
+            material.descriptor_pool = pool;
 
             if(gpumesh.original->material.texture_paths.contains(TextureType::Diffuse)) {
                 auto &frame = get_frame_resources();
@@ -646,22 +1449,440 @@ void Renderer::upload_mesh_instances() {
                 if(!image) {
                     std::cerr << fmt::format("Could not create texture");
                 } else {
-                    auto image_view = texture_mgr->make_view(image, vk::ImageViewCreateInfo{{}, {}, vk::ImageViewType::e2D, vk::Format::eR8G8B8A8Srgb, {}, {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}});
-                    vk::DescriptorImageInfo desc_ii{_ui.sampler, image_view, vk::ImageLayout::eShaderReadOnlyOptimal};
-                    vk::WriteDescriptorSet write_dset{meshinst.material_descriptor, 0, 0, vk::DescriptorType::eCombinedImageSampler, desc_ii, {}, {}};
+                    material.texture = image;
+                    // format and mip count come from the texture, cooked textures are block compressed
+                    auto image_view = texture_mgr->make_view(image, vk::ImageViewCreateInfo{{}, {}, vk::ImageViewType::e2D, vk::Format::eUndefined, {}, {vk::ImageAspectFlagBits::eColor, 0, VK_REMAINING_MIP_LEVELS, 0, 1}});
+                    vk::DescriptorImageInfo desc_ii{_vk.material_sampler, image_view, vk::ImageLayout::eShaderReadOnlyOptimal};
+                    vk::WriteDescriptorSet write_dset{material.descriptor, 0, 0, vk::DescriptorType::eCombinedImageSampler, desc_ii, {}, {}};
                     _vk.dev.updateDescriptorSets(write_dset, {});
                 }
 
             }
         }
+        // the last of these moves it into the renderables
+        registry.add(entity, material);
+        registry.add(entity, WorldBounds{});
+        registry.add(entity, Visibility{});
     }
 
-    std::sort(begin(mesh_instances), end(mesh_instances), [](auto &a, auto &b) { 
-        return std::tie(a.mesh_idx, a.pipeline, a.material_descriptor) < std::tie(b.mesh_idx, b.pipeline, b.material_descriptor);
+    {
+    const auto refs = renderables->column<MeshRef>();
+    const auto materials = renderables->column<Material>();
+    registry.sort(*renderables, [&](uint32_t a, uint32_t b) {
+        const auto a_index_type = meshes.at(refs[a].mesh_idx).index_type, b_index_type = meshes.at(refs[b].mesh_idx).index_type;
+        return std::tie(a_index_type, refs[a].mesh_idx, materials[a].pipeline, materials[a].descriptor) < std::tie(b_index_type, refs[b].mesh_idx, materials[b].pipeline, materials[b].descriptor);
     });
+    }
 
-    for(auto i=0u; i<mesh_instances.size(); ++i) { mesh_instances.at(i).instance_id = i; }
-    mesh_instances_to_upload = {};
+    if(renderables->size() > FrameRenderResources::MAX_INSTANCE_TRANSFORMS) {
+        std::cerr << fmt::format("{} mesh instances, only the first {} are drawn\n", renderables->size(), FrameRenderResources::MAX_INSTANCE_TRANSFORMS);
+    }
+    const auto nodes = renderables->column<Transform>();
+    const auto refs = renderables->column<MeshRef>();
+    const auto bounds = renderables->column<WorldBounds>();
+    std::vector<Aabb> boxes(renderables->size());
+    for(auto i=0u; i<renderables->size(); ++i) {
+        bounds[i].box = boxes[i] = world_bounds(nodes[i].node, refs[i].mesh_idx);
+    }
+    // the sort above moved every row, a rebuild is cheaper than removing and inserting all of them
+    instance_bvh.build(boxes);
+    picked_instance.reset();
+    ++transforms_version;
+    entities_to_upload = {};
+}
+
+void Renderer::remove_instance(Entity entity) {
+    if(std::find(entities_to_remove.begin(), entities_to_remove.end(), entity) == entities_to_remove.end()) { entities_to_remove.push_back(entity); }
+}
+
+void Renderer::remove_instances() {
+    // the frames in flight still draw them, and the current one hasn't been recorded yet
+    const auto frame = Engine::get_frame_number();
+    for(const auto entity : entities_to_remove) {
+        const auto *material = registry.get<Material>(entity);
+        if(!material) { continue; }
+        if(material->texture) { texture_mgr->release(material->texture, frame); }
+        if(material->descriptor_pool) { retired_descriptor_pools.emplace_back(material->descriptor_pool, frame); }
+        // the highest node nothing is placed below anymore goes, and everything below it with the next scene update
+        auto unused = SceneGraph::NO_NODE;
+        for(auto node = registry.get<Transform>(entity)->node; node != SceneGraph::NO_NODE; node = scene.parent(node)) {
+            if(--node_instances[node] == 0) { unused = node; }
+        }
+        scene.destroy(unused);
+        registry.destroy(entity);
+    }
+    entities_to_remove.clear();
+
+    // the last rows moved into the removed ones
+    const auto bounds = renderables->column<WorldBounds>();
+    std::vector<Aabb> boxes(renderables->size());
+    for(auto i=0u; i<renderables->size(); ++i) { boxes[i] = bounds[i].box; }
+    instance_bvh.build(boxes);
+    picked_instance.reset();
+    ++transforms_version;
+}
+
+void Renderer::update_transforms(FrameRenderResources &frame) {
+    // instances follow their nodes, the tree is refit once for all of them
+    if(scene.update() > 0) {
+        const auto nodes = renderables->column<Transform>();
+        const auto refs = renderables->column<MeshRef>();
+        const auto bounds = renderables->column<WorldBounds>();
+        for(auto i=0u; i<renderables->size(); ++i) {
+            if(!scene.changed(nodes[i].node)) { continue; }
+            bounds[i].box = world_bounds(nodes[i].node, refs[i].mesh_idx);
+            instance_bvh.update(i, bounds[i].box);
+        }
+        instance_bvh.refit();
+        ++transforms_version;
+    }
+
+    // every frame has its own copy, rewritten whole once something moved since it was last written
+    if(frame.transforms_version == transforms_version) { return; }
+    const auto count = std::min<size_t>(renderables->size(), FrameRenderResources::MAX_INSTANCE_TRANSFORMS);
+    // only two captures, which std::function keeps without going to the heap
+    const auto written = buffer_mgr->insert(frame.instance_transforms, 0, count * sizeof(glm::mat4), [this, count](std::byte *data) {
+        const auto nodes = renderables->column<Transform>();
+        auto *transforms = reinterpret_cast<glm::mat4*>(data);
+        for(auto i=0u; i<count; ++i) { transforms[i] = scene.world(nodes[i].node); }
+    });
+    if(!written) {
+        std::cerr << "error when writing instance transforms";
+        return;
+    }
+    frame.transforms_version = transforms_version;
+}
+
+Aabb Renderer::world_bounds(SceneGraph::Node node, uint32_t mesh_idx) const {
+    const auto &gpumesh = meshes.at(mesh_idx);
+    const auto &world = scene.world(node);
+    const auto center = glm::vec3{world * glm::vec4{(gpumesh.aabb_min + gpumesh.aabb_max) * 0.5f, 1.0f}};
+    const auto extent = glm::mat3{glm::abs(glm::vec3{world[0]}), glm::abs(glm::vec3{world[1]}), glm::abs(glm::vec3{world[2]})} * ((gpumesh.aabb_max - gpumesh.aabb_min) * 0.5f);
+    return Aabb{center - extent, center + extent};
+}
+
+void Renderer::cull_instances(const Frustum &frustum) {
+    // the tree hands the instances out in its own order, the batching further on needs them in the order of the rows.
+    // going through a bitmask keeps that linear in the visible ones instead of sorting them
+    visible_instances.clear();
+    instance_bvh.query(frustum, visible_instances);
+    visible_instance_mask.assign((renderables->size() + 63) / 64, 0);
+    for(const auto idx : visible_instances) { visible_instance_mask[idx / 64] |= 1ull << (idx % 64); }
+    visible_instances.clear();
+    for(auto w=0u; w<visible_instance_mask.size(); ++w) {
+        for(auto bits = visible_instance_mask[w]; bits; bits &= bits - 1) { visible_instances.push_back(w * 64 + std::countr_zero(bits)); }
+    }
+    // past those there's no room for the transform
+    while(!visible_instances.empty() && visible_instances.back() >= FrameRenderResources::MAX_INSTANCE_TRANSFORMS) { visible_instances.pop_back(); }
+}
+
+void Renderer::pick_instance(const glm::vec2 &ndc) {
+    const auto hit = instance_bvh.raycast(Ray{camera.position, camera.ray_direction(ndc, (float)render_extent.width / render_extent.height)});
+    if(hit) { picked_instance = hit->object; }
+    else { picked_instance.reset(); }
+}
+
+void Renderer::control_camera(bool hovered) {
+    const auto &io = ImGui::GetIO();
+    // a drag that left the image keeps turning
+    const auto turning = ImGui::IsMouseDown(ImGuiMouseButton_Right) && (hovered || ImGui::IsMouseDragging(ImGuiMouseButton_Right));
+    if(!hovered && !turning) { return; }
+    if(turning) {
+        camera.yaw -= io.MouseDelta.x * 0.005f;
+        camera.pitch = std::clamp(camera.pitch - io.MouseDelta.y * 0.005f, -1.55f, 1.55f);
+    }
+    glm::vec3 move{0.0f};
+    if(ImGui::IsKeyDown(ImGuiKey_W)) { move += camera.forward(); }
+    if(ImGui::IsKeyDown(ImGuiKey_S)) { move -= camera.forward(); }
+    if(ImGui::IsKeyDown(ImGuiKey_D)) { move += camera.right(); }
+    if(ImGui::IsKeyDown(ImGuiKey_A)) { move -= camera.right(); }
+    if(ImGui::IsKeyDown(ImGuiKey_E)) { move.y += 1.0f; }
+    if(ImGui::IsKeyDown(ImGuiKey_Q)) { move.y -= 1.0f; }
+    camera.position += move * camera_speed * io.DeltaTime;
+}
+
+void Renderer::add_occlusion_test_scene() {
+    // a unit cube, every face with its own vertices for the normals. counter clockwise seen from outside
+    Mesh box;
+    for(auto axis=0; axis<3; ++axis) {
+        for(const auto sign : {1.0f, -1.0f}) {
+            glm::vec3 n{0.0f}, u{0.0f}, v{0.0f};
+            n[axis] = sign;
+            u[(axis + 1) % 3] = 1.0f;
+            v[(axis + 2) % 3] = sign;
+            const auto first = (uint32_t)box.vertex_positions.size();
+            for(const auto &uv : {glm::vec2{0.0f, 0.0f}, glm::vec2{1.0f, 0.0f}, glm::vec2{1.0f, 1.0f}, glm::vec2{0.0f, 1.0f}}) {
+                box.vertex_positions.push_back((n + u * (uv.x * 2.0f - 1.0f) + v * (uv.y * 2.0f - 1.0f)) * 0.5f);
+                box.vertex_normals.push_back(n);
+                box.vertex_texture_coords.push_back(uv);
+            }
+            box.vertex_indices.insert(box.vertex_indices.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+        }
+    }
+    box.bounds = VertexBounds{glm::vec3{-0.5f}, glm::vec3{0.5f}, glm::vec2{0.0f}, glm::vec2{1.0f}};
+    box.material.shader_name = "main";
+    std::vector<Mesh> box_meshes;
+    box_meshes.push_back(std::move(box));
+    const auto *geometry = add_geometry(Geometry{std::move(box_meshes)});
+
+    // upright and facing the camera, the wall 6 units ahead hides everything from 10 to 18 units ahead
+    auto ahead = glm::vec3{camera.forward().x, 0.0f, camera.forward().z};
+    ahead = glm::length(ahead) > 1e-3f ? glm::normalize(ahead) : glm::vec3{0.0f, 0.0f, -1.0f};
+    const glm::vec3 up{0.0f, 1.0f, 0.0f};
+    const auto right = glm::cross(ahead, up);
+    const auto place = [&](const glm::vec3 &offset, const glm::vec3 &scale) {
+        const auto origin = camera.position + right * offset.x + up * offset.y + ahead * offset.z;
+        return glm::mat4{glm::vec4{right * scale.x, 0.0f}, glm::vec4{up * scale.y, 0.0f}, glm::vec4{-ahead * scale.z, 0.0f}, glm::vec4{origin, 1.0f}};
+    };
+    add_object(Model{geometry, place(glm::vec3{0.0f, 0.0f, 6.0f}, glm::vec3{8.0f, 4.0f, 0.25f})});
+    for(auto z=0; z<10; ++z) {
+        for(auto y=0; y<4; ++y) {
+            for(auto x=0; x<8; ++x) {
+                add_object(Model{geometry, place(glm::vec3{(x - 3.5f) * 0.8f, (y - 1.5f) * 0.8f, 10.0f + z * 0.8f}, glm::vec3{0.4f})});
+            }
+        }
+    }
+    camera_framed = true;
+}
+
+void Renderer::select_lods(const glm::vec3 &eye, float pixels_per_unit) {
+    triangles_drawn = 0;
+    const auto nodes = renderables->column<Transform>();
+    const auto refs = renderables->column<MeshRef>();
+    const auto bounds = renderables->column<WorldBounds>();
+    for(const auto idx : visible_instances) {
+        auto &ref = refs[idx];
+        const auto &gpumesh = meshes[ref.mesh_idx];
+        // the errors are in object space units, which the largest scale of the instance's transform makes world units.
+        // they're projected from the nearest point of the instance's box, which is as large as they get on screen
+        const auto &world = scene.world(nodes[idx].node);
+        const auto &box = bounds[idx].box;
+        const auto distance = std::max(glm::length(glm::clamp(eye, box.min, box.max) - eye), camera.near_plane);
+        const auto pixels = pixels_per_unit / distance * std::max({glm::length(glm::vec3{world[0]}), glm::length(glm::vec3{world[1]}), glm::length(glm::vec3{world[2]})});
+        auto lod = std::min(ref.lod, gpumesh.lod_count - 1);
+        while(lod > 0 && gpumesh.lods[lod].error * pixels > lod_pixel_error * (1.0f + lod_hysteresis)) { --lod; }
+        while(lod + 1 < gpumesh.lod_count && gpumesh.lods[lod + 1].error * pixels < lod_pixel_error * (1.0f - lod_hysteresis)) { ++lod; }
+        ref.lod = lod;
+        triangles_drawn += gpumesh.lods[lod].index_count / 3;
+    }
+}
+
+uint32_t Renderer::prepare_meshlet_culling(FrameRenderResources &frame) {
+    // every visible instance gets a slot for its draw count and room for all of its level's meshlets
+    std::pmr::vector<MeshletCullJob> jobs{frame.arena->resource()};
+    uint32_t draw_count = 0, slot_count = 0;
+    const auto refs = renderables->column<MeshRef>();
+    const auto materials = renderables->column<Material>();
+    const auto visibility = renderables->column<Visibility>();
+    for(const auto idx : visible_instances) {
+        auto &vis = visibility[idx];
+        vis.meshlet_draw_slot = Visibility::NO_MESHLET_DRAWS;
+        const auto &gpumesh = meshes[refs[idx].mesh_idx];
+        if(!meshlet_culling || !materials[idx].pipeline || gpumesh.index_count == 0 || gpumesh.meshlet_count == 0) { continue; }
+        const auto &lod = gpumesh.lods[refs[idx].lod];
+        if(lod.meshlet_count == 0 || slot_count == RendererCullObjects::MAX_INSTANCES || draw_count + lod.meshlet_count > RendererCullObjects::MAX_DRAWS) { continue; }
+
+        vis.meshlet_draw_slot = slot_count++;
+        vis.first_meshlet_draw = draw_count;
+        const auto instance = uses_occlusion_culling(idx, refs[idx], materials[idx]) ? idx : ~0u;
+        // the jobs of an instance share its draw count, whose atomicAdd hands out slots from its first draw on
+        const auto first_job = jobs.size();
+        for(auto m=0u; m<lod.meshlet_count; m+=RendererCullObjects::GROUP_SIZE) {
+            jobs.push_back(MeshletCullJob{gpumesh.first_meshlet + lod.first_meshlet + m, std::min(lod.meshlet_count - m, RendererCullObjects::GROUP_SIZE), draw_count, vis.meshlet_draw_slot, instance, idx});
+        }
+        assert(std::all_of(jobs.begin() + first_job, jobs.end(), [&](const MeshletCullJob &job) { return job.first_draw == vis.first_meshlet_draw && job.draw_slot == vis.meshlet_draw_slot; }));
+        draw_count += lod.meshlet_count;
+    }
+    meshlets_submitted = draw_count;
+    if(jobs.empty()) { return 0; }
+
+    // the frames in flight may still be reading the meshlets through their own descriptors, only this one's is free
+    if(frame.meshlets_version != meshlets_version) {
+        const vk::DescriptorBufferInfo meshlets_bi{buffer_mgr->get(_vk.buffer_meshlets), 0, VK_WHOLE_SIZE};
+        _vk.dev.updateDescriptorSets(vk::WriteDescriptorSet{frame.meshlet_cull_descriptor, 0, 0, vk::DescriptorType::eStorageBuffer, {}, meshlets_bi, {}}, {});
+        frame.meshlets_version = meshlets_version;
+    }
+
+    if(!buffer_mgr->insert(frame.meshlet_cull_jobs, 0, std::as_bytes(std::span{jobs}))) {
+        std::cerr << "error when writing meshlet cull jobs";
+        for(auto &vis : visibility) { vis.meshlet_draw_slot = Visibility::NO_MESHLET_DRAWS; }
+        return 0;
+    }
+    return (uint32_t)jobs.size();
+}
+
+uint32_t Renderer::prepare_occlusion_culling(FrameRenderResources &frame) {
+    // consecutive instances drawn whole with the same mesh and pipeline share one drawIndexedIndirectCount,
+    // the sort in upload_mesh_instances puts them next to each other
+    // at most one per visible instance, so it's reserved once instead of growing through the arena
+    std::pmr::vector<InstanceCullJob> jobs{frame.arena->resource()};
+    jobs.reserve(visible_instances.size());
+    std::optional<uint32_t> batch; // the row drawing the current batch
+    uint32_t slot_count = 0;
+    const auto refs = renderables->column<MeshRef>();
+    const auto materials = renderables->column<Material>();
+    const auto bounds = renderables->column<WorldBounds>();
+    const auto visibility = renderables->column<Visibility>();
+    for(const auto idx : visible_instances) {
+        auto &vis = visibility[idx];
+        vis.instance_draw_slot = Visibility::NO_INSTANCE_DRAWS;
+        vis.instance_draw_count = 0;
+        if(!uses_occlusion_culling(idx, refs[idx], materials[idx])) {
+            batch.reset();
+            continue;
+        }
+
+        const auto &gpumesh = meshes[refs[idx].mesh_idx];
+        const auto &lod = gpumesh.lods[refs[idx].lod];
+        const auto &box = bounds[idx].box;
+        InstanceCullJob job{
+            .center = glm::vec4{box.center(), 0.0f},
+            .extent = glm::vec4{(box.max - box.min) * 0.5f, 0.0f},
+            .instance = idx,
+            .index_count = lod.index_count,
+            .first_index = gpumesh.first_index + lod.first_index,
+            .vertex_offset = gpumesh.vertex_offset
+        };
+        if(vis.meshlet_draw_slot == Visibility::NO_MESHLET_DRAWS) {
+            if(!batch || refs[*batch].mesh_idx != refs[idx].mesh_idx || materials[*batch].pipeline != materials[idx].pipeline || materials[*batch].descriptor != materials[idx].descriptor) {
+                batch = idx;
+                vis.first_instance_draw = (uint32_t)jobs.size();
+                vis.instance_draw_slot = slot_count++;
+            } else {
+                vis.instance_draw_slot = visibility[*batch].instance_draw_slot;
+            }
+            auto &batch_vis = visibility[*batch];
+            job.draw_slot = batch_vis.instance_draw_slot;
+            job.first_draw = batch_vis.first_instance_draw;
+            ++batch_vis.instance_draw_count;
+        } else {
+            batch.reset();
+        }
+        jobs.push_back(job);
+    }
+    instances_occlusion_tested = jobs.size();
+    if(jobs.empty()) { return 0; }
+
+    if(!buffer_mgr->insert(frame.instance_cull_jobs, 0, std::as_bytes(std::span{jobs}))) {
+        std::cerr << "error when writing instance cull jobs";
+        instances_occlusion_tested = 0;
+        for(auto &vis : visibility) {
+            vis.instance_draw_slot = Visibility::NO_INSTANCE_DRAWS;
+            vis.instance_draw_count = 0;
+        }
+        return 0;
+    }
+    return (uint32_t)jobs.size();
+}
+
+bool Renderer::uses_occlusion_culling(uint32_t instance, const MeshRef &ref, const Material &material) const {
+    return occlusion_culling && _occlusion.pipeline && material.pipeline && meshes.at(ref.mesh_idx).index_count > 0
+        && instance < RendererOcclusionObjects::MAX_INSTANCES;
+}
+
+void Renderer::cull_meshlets(vk::CommandBuffer cmd, FrameRenderResources &frame, const Frustum &frustum, const glm::vec4 &camera, uint32_t job_count, uint32_t phase) {
+    if(job_count == 0) { return; }
+
+    MeshletCullConstants constants{.camera = camera, .phase = phase, .draw_stride = RendererCullObjects::MAX_DRAWS, .count_stride = RendererCullObjects::MAX_INSTANCES};
+    std::copy(frustum.planes.begin(), frustum.planes.end(), constants.planes);
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, _cull.pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _cull.pipeline_layout, 0, frame.meshlet_cull_descriptor, {});
+    cmd.pushConstants(_cull.pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+    cmd.dispatch(job_count, 1, 1);
+}
+
+void Renderer::cull_occlusion(vk::CommandBuffer cmd, FrameRenderResources &frame, const glm::mat4 &clip_from_world, vk::Extent2D viewport, uint32_t job_count, uint32_t phase) {
+    if(job_count == 0) { return; }
+
+    const InstanceCullConstants constants{
+        .clip_from_world = clip_from_world,
+        .viewport = glm::vec2{viewport.width, viewport.height},
+        .phase = phase,
+        .job_count = job_count,
+        .draw_stride = RendererOcclusionObjects::MAX_INSTANCES,
+        .count_stride = RendererOcclusionObjects::MAX_INSTANCES,
+        .hiz_levels = _occlusion.hiz_levels
+    };
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, _occlusion.pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _occlusion.pipeline_layout, 0, frame.instance_cull_descriptor, {});
+    cmd.pushConstants(_occlusion.pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+    cmd.dispatch((job_count + RendererOcclusionObjects::GROUP_SIZE - 1) / RendererOcclusionObjects::GROUP_SIZE, 1, 1);
+}
+
+void Renderer::build_hiz(vk::CommandBuffer cmd, BarrierBatch &barriers, FrameRenderResources &frame, vk::ImageView depth, vk::Extent2D viewport) {
+    // the depth is a transient of the frame's graph, which may be another image than last time around
+    const vk::DescriptorImageInfo depth_ii{_occlusion.hiz_sampler, depth, vk::ImageLayout::eShaderReadOnlyOptimal};
+    const vk::DescriptorImageInfo level_ii{{}, _occlusion.hiz_level_views.at(0), vk::ImageLayout::eGeneral};
+    _vk.dev.updateDescriptorSets({
+        vk::WriteDescriptorSet{frame.hiz_reduce_descriptors.at(0), 0, 0, vk::DescriptorType::eCombinedImageSampler, depth_ii, {}, {}},
+        vk::WriteDescriptorSet{frame.hiz_reduce_descriptors.at(0), 1, 0, vk::DescriptorType::eStorageImage, level_ii, {}, {}}
+    }, {});
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, _occlusion.reduce_pipeline);
+    glm::ivec2 src_size{viewport.width, viewport.height};
+    for(auto level=0u; level<_occlusion.hiz_levels; ++level) {
+        const HizReduceConstants constants{src_size, glm::max((src_size + 1) / 2, glm::ivec2{1})};
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _occlusion.reduce_pipeline_layout, 0, frame.hiz_reduce_descriptors.at(level), {});
+        cmd.pushConstants(_occlusion.reduce_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+        cmd.dispatch((constants.dst_size.x + 7) / 8, (constants.dst_size.y + 7) / 8, 1);
+        // the next level reads this one. after the last the graph makes the pyramid visible to its readers
+        if(level + 1 < _occlusion.hiz_levels) {
+            barriers.image(vk::ImageMemoryBarrier2{
+                vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+                vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead,
+                vk::ImageLayout::eGeneral, vk::ImageLayout::eGeneral, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                _occlusion.hiz_image, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, level, 1, 0, 1}
+            });
+            barriers.flush();
+        }
+        src_size = constants.dst_size;
+    }
+}
+
+void Renderer::draw_instances(vk::CommandBuffer cmd, FrameRenderResources &frame, uint32_t phase, vk::Extent2D extent) {
+    cmd.setViewportWithCount(vk::Viewport{0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f});
+    cmd.setScissorWithCount(vk::Rect2D{{}, extent});
+    cmd.bindVertexBuffers(0, buffer_mgr->get(_vk.buffer_vertex), {0});
+    // instances are sorted by index type, so this rebinds at most once per type
+    std::optional<vk::IndexType> bound_index_type;
+    const auto refs = renderables->column<MeshRef>();
+    const auto materials = renderables->column<Material>();
+    const auto visibility = renderables->column<Visibility>();
+    for(const auto idx : visible_instances) {
+        const auto &material = materials[idx];
+        const auto &vis = visibility[idx];
+        const auto &gpumesh = meshes[refs[idx].mesh_idx];
+        if(!material.pipeline || gpumesh.index_count == 0) { continue; }
+        const auto has_meshlet_draws = vis.meshlet_draw_slot != Visibility::NO_MESHLET_DRAWS;
+        const auto has_instance_draws = vis.instance_draw_slot != Visibility::NO_INSTANCE_DRAWS;
+        // drawn along with the first of its batch, or whole in the first phase only
+        if(has_instance_draws && vis.instance_draw_count == 0) { continue; }
+        if(!has_meshlet_draws && !has_instance_draws && phase > 0) { continue; }
+
+        if(bound_index_type != gpumesh.index_type) {
+            cmd.bindIndexBuffer(buffer_mgr->get(_vk.buffer_index), 0, gpumesh.index_type);
+            bound_index_type = gpumesh.index_type;
+        }
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, material.pipeline);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, material.pipeline_layout, 0, frame.transform_descriptor, frame.constants_offset);
+        if(material.descriptor) { cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, material.pipeline_layout, 2, material.descriptor, {}); }
+        cmd.pushConstants(material.pipeline_layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(VertexDecode), &gpumesh.decode);
+        const auto &lod = gpumesh.lods[refs[idx].lod];
+        if(has_meshlet_draws) {
+            cmd.drawIndexedIndirectCount(
+                buffer_mgr->get(frame.meshlet_draws), (phase * RendererCullObjects::MAX_DRAWS + vis.first_meshlet_draw) * sizeof(vk::DrawIndexedIndirectCommand),
+                buffer_mgr->get(frame.meshlet_draw_counts), (phase * RendererCullObjects::MAX_INSTANCES + vis.meshlet_draw_slot) * sizeof(uint32_t),
+                lod.meshlet_count, sizeof(vk::DrawIndexedIndirectCommand));
+        } else if(has_instance_draws) {
+            cmd.drawIndexedIndirectCount(
+                buffer_mgr->get(frame.instance_draws), (phase * RendererOcclusionObjects::MAX_INSTANCES + vis.first_instance_draw) * sizeof(vk::DrawIndexedIndirectCommand),
+                buffer_mgr->get(frame.instance_draw_counts), (phase * RendererOcclusionObjects::MAX_INSTANCES + vis.instance_draw_slot) * sizeof(uint32_t),
+                vis.instance_draw_count, sizeof(vk::DrawIndexedIndirectCommand));
+        } else {
+            cmd.drawIndexed(lod.index_count, 1, gpumesh.first_index + lod.first_index, gpumesh.vertex_offset, idx);
+        }
+    }
 }
 
 FrameRenderResources& Renderer::get_frame_resources() { return _vk.per_frame_render_data.at(get_frame_resource_index(Engine::get_frame_number())); }
@@ -0,0 +1,171 @@
+#include <engine/scene_graph.hpp>
+#include <engine/parallel_for.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+
+namespace eng {
+
+SceneGraph::Node SceneGraph::create(Node parent, const glm::mat4 &local) {
+    const auto slot = (uint32_t)slot_nodes.size();
+    const auto parent_slot = valid(parent) ? node_slots[parent] : NO_NODE;
+    const auto depth = parent_slot == NO_NODE ? 0u : depths[parent_slot] + 1;
+
+    // appending keeps the order as long as nothing is deeper already, otherwise the next update sorts
+    if(!unsorted && (slot == 0 || depth >= depths.back())) {
+        while(level_begin.size() < depth + 2) { level_begin.push_back(slot); }
+        level_begin.back() = slot + 1;
+    } else {
+        unsorted = true;
+    }
+
+    parents.push_back(parent_slot);
+    depths.push_back(depth);
+    locals.push_back(local);
+    worlds.push_back(parent_slot == NO_NODE ? local : worlds[parent_slot] * local);
+    dirty_flags.push_back(1);
+    changed_flags.push_back(0);
+    destroyed_flags.push_back(0);
+    if(level_dirty.size() <= depth) { level_dirty.resize(depth + 1, 0); }
+    ++level_dirty[depth];
+
+    Node node;
+    if(!free_nodes.empty()) {
+        node = free_nodes.back();
+        free_nodes.pop_back();
+    } else {
+        node = (Node)node_slots.size();
+        node_slots.push_back(NO_NODE);
+    }
+    node_slots[node] = slot;
+    slot_nodes.push_back(node);
+    return node;
+}
+
+void SceneGraph::destroy(Node node) {
+    if(!valid(node)) { return; }
+    destroyed_flags[node_slots[node]] = 1;
+    node_slots[node] = NO_NODE;
+    free_nodes.push_back(node);
+    unsorted = true;
+}
+
+void SceneGraph::set_local(Node node, const glm::mat4 &local) {
+    if(!valid(node)) { return; }
+    const auto slot = node_slots[node];
+    locals[slot] = local;
+    if(!dirty_flags[slot]) {
+        dirty_flags[slot] = 1;
+        ++level_dirty[depths[slot]];
+    }
+}
+
+SceneGraph::Node SceneGraph::parent(Node node) const {
+    if(!valid(node)) { return NO_NODE; }
+    const auto parent_slot = parents[node_slots[node]];
+    return parent_slot == NO_NODE ? NO_NODE : slot_nodes[parent_slot];
+}
+
+size_t SceneGraph::update() {
+    if(unsorted) { sort_by_depth(); }
+    level_changed.resize(depth(), 0);
+    level_dirty.resize(std::max(level_dirty.size(), depth()), 0);
+
+    // a node changes when it was flagged or its parent changed, which the previous level already knows
+    const auto update_range = [this](size_t begin, size_t end) {
+        uint32_t changed = 0;
+        for(auto i=begin; i<end; ++i) {
+            const auto p = parents[i];
+            const auto c = dirty_flags[i] || (p != NO_NODE && changed_flags[p]);
+            if(c) {
+                worlds[i] = p == NO_NODE ? locals[i] : worlds[p] * locals[i];
+                ++changed;
+            }
+            changed_flags[i] = c;
+            dirty_flags[i] = 0;
+        }
+        return changed;
+    };
+
+    size_t total = 0;
+    std::vector<uint32_t> chunk_changed;
+    for(auto level=0u; level<depth(); ++level) {
+        // nothing to do, and nothing left flagged as changed from the last time either
+        const auto parents_changed = level > 0 && level_changed[level - 1] > 0;
+        if(!parents_changed && level_dirty[level] == 0 && level_changed[level] == 0) { continue; }
+
+        const size_t begin = level_begin[level], end = level_begin[level + 1];
+        if(end - begin <= PARALLEL_CHUNK) {
+            level_changed[level] = update_range(begin, end);
+        } else {
+            chunk_changed.assign((end - begin + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK, 0);
+            parallel_for(chunk_changed.size(), [&](size_t c) {
+                const auto chunk_begin = begin + c * PARALLEL_CHUNK;
+                chunk_changed[c] = update_range(chunk_begin, std::min(chunk_begin + PARALLEL_CHUNK, end));
+            });
+            level_changed[level] = std::accumulate(chunk_changed.begin(), chunk_changed.end(), 0u);
+        }
+        level_dirty[level] = 0;
+        total += level_changed[level];
+    }
+    return total;
+}
+
+void SceneGraph::sort_by_depth() {
+    const auto count = slot_nodes.size();
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return depths[a] < depths[b]; });
+
+    // parents come first now, so destroying reaches all the way down in one go
+    std::vector<uint32_t> new_slots(count, NO_NODE);
+    uint32_t kept = 0;
+    for(const auto s : order) {
+        if(parents[s] != NO_NODE && destroyed_flags[parents[s]]) { destroyed_flags[s] = 1; }
+        if(destroyed_flags[s]) {
+            // the destroyed node itself gave up its id already, its descendants do it here
+            if(node_slots[slot_nodes[s]] == s) {
+                node_slots[slot_nodes[s]] = NO_NODE;
+                free_nodes.push_back(slot_nodes[s]);
+            }
+            continue;
+        }
+        new_slots[s] = kept++;
+    }
+
+    const auto gather = [&](auto &values) {
+        std::remove_reference_t<decltype(values)> sorted;
+        sorted.reserve(kept);
+        for(const auto s : order) {
+            if(new_slots[s] != NO_NODE) { sorted.push_back(values[s]); }
+        }
+        values = std::move(sorted);
+    };
+    gather(depths);
+    gather(locals);
+    gather(worlds);
+    gather(dirty_flags);
+    gather(changed_flags);
+    gather(slot_nodes);
+    std::vector<uint32_t> sorted_parents;
+    sorted_parents.reserve(kept);
+    for(const auto s : order) {
+        if(new_slots[s] != NO_NODE) { sorted_parents.push_back(parents[s] == NO_NODE ? NO_NODE : new_slots[parents[s]]); }
+    }
+    parents = std::move(sorted_parents);
+    destroyed_flags.assign(kept, 0);
+    for(auto s=0u; s<kept; ++s) { node_slots[slot_nodes[s]] = s; }
+
+    // the levels that lost nodes are redone once, so their changed flags don't point at the wrong nodes
+    level_begin.assign(1, 0);
+    for(auto s=0u; s<kept; ++s) {
+        while(level_begin.size() < depths[s] + 2) { level_begin.push_back(s); }
+        level_begin.back() = s + 1;
+    }
+    if(kept == 0) { level_begin.clear(); }
+    std::fill(level_changed.begin(), level_changed.end(), 1u);
+    unsorted = false;
+}
+
+}
\ No newline at end of file
@@ -7,7 +7,7 @@
 
 namespace eng {
 
-Shader::Shader(vk::Device device, std::filesystem::path file_path): Handle(GENERATE_HANDLE), path(file_path) {
+Shader::Shader(vk::Device device, std::filesystem::path file_path): path(file_path) {
     const auto file_data = FileReader::read(file_path, std::ios_base::binary | std::ios_base::in);
 
     vk::ShaderModuleCreateInfo smci{{}, file_data.size(), reinterpret_cast<const uint32_t*>(file_data.data())};
@@ -17,15 +17,20 @@ Shader::Shader(vk::Device device, std::filesystem::path file_path): Handle(GENER
         type = ShaderType::Vertex; 
     } else if(ext == ".frag") { 
         type = ShaderType::Fragment; 
+    } else if(ext == ".comp") { 
+        type = ShaderType::Compute; 
     } else { assert(false && "Unrecognized shader type."); }
 
     spirv_cross::Compiler c{reinterpret_cast<const uint32_t*>(file_data.data()), file_data.size()/4};
     const auto shader_resouces = c.get_shader_resources();
 
 
-    static constexpr std::array<vk::DescriptorType, 2> res_types_to_read{
+    // uniform buffers only ever hold what's streamed through the upload ring, so they're always bound with a dynamic offset
+    static constexpr std::array<vk::DescriptorType, 4> res_types_to_read{
         vk::DescriptorType::eStorageBuffer,
+        vk::DescriptorType::eUniformBufferDynamic,
         vk::DescriptorType::eCombinedImageSampler,
+        vk::DescriptorType::eStorageImage,
     };
 
     for(const auto resource_type : res_types_to_read) {
@@ -35,9 +40,15 @@ Shader::Shader(vk::Device device, std::filesystem::path file_path): Handle(GENER
             case vk::DescriptorType::eStorageBuffer:
                 resvec = &shader_resouces.storage_buffers;
                 break;
+            case vk::DescriptorType::eUniformBufferDynamic:
+                resvec = &shader_resouces.uniform_buffers;
+                break;
             case vk::DescriptorType::eCombinedImageSampler:
                 resvec = &shader_resouces.sampled_images;
                 break;
+            case vk::DescriptorType::eStorageImage:
+                resvec = &shader_resouces.storage_images;
+                break;
             default:
                 assert(false && "Unhandled type");
                 continue;
@@ -72,9 +83,9 @@ Shader::Shader(vk::Device device, std::filesystem::path file_path): Handle(GENER
     resources.push_constants.offset = 0; 
     resources.push_constants.stageFlags = get_vk_stage(); 
     if(shader_resouces.push_constant_buffers.size() > 0) {
-        for(const auto &range : c.get_active_buffer_ranges(shader_resouces.push_constant_buffers[0].id)) {
-            resources.push_constants.size += range.range;
-        }
+        // the whole block, not just the members this stage reads, so every stage declaring it agrees on the size
+        const auto &block = shader_resouces.push_constant_buffers[0];
+        resources.push_constants.size = c.get_declared_struct_size(c.get_type(block.base_type_id));
     }
 
     for(int i=0; i<2; ++i) {
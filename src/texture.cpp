@@ -1,7 +1,13 @@
 #include <engine/texture.hpp>
 #include <engine/buffer.hpp>
 #include <engine/queue.hpp>
+#include <engine/texture_format.hpp>
+#include <engine/mapped_file.hpp>
+#include <engine/hash.hpp>
+#include <engine/barrier_batch.hpp>
 
+#include <algorithm>
+#include <fstream>
 #include <span>
 #include <ranges>
 #include <string>
@@ -13,6 +19,17 @@
 
 namespace eng {
 
+static vk::Format cooked_format_to_vk(const CookedTextureHeader &header) {
+    switch(header.format) {
+        case CookedTextureFormat::RGBA8: return header.srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+        case CookedTextureFormat::BC1: return header.srgb ? vk::Format::eBc1RgbSrgbBlock : vk::Format::eBc1RgbUnormBlock;
+        case CookedTextureFormat::BC3: return header.srgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock;
+        case CookedTextureFormat::BC5: return vk::Format::eBc5UnormBlock;
+        case CookedTextureFormat::BC7: return header.srgb ? vk::Format::eBc7SrgbBlock : vk::Format::eBc7UnormBlock;
+        default: return vk::Format::eUndefined;
+    }
+}
+
 Texture::Texture(Texture &&other) noexcept {
     *this = std::move(other);
 }
@@ -24,12 +41,17 @@ Texture& Texture::operator=(Texture &&other) noexcept {
     usage = other.usage;
     owning_queue_families = std::move(other.owning_queue_families);
     allocation = other.allocation;
+    views = std::move(other.views);
+    refcount = other.refcount;
+    last_release = other.last_release;
     other.image = nullptr;
     other.allocation = nullptr;
+    other.refcount = 0;
     return *this;
 }
 
-TextureManager::TextureManager(vk::Device device, BufferManager *buffer_mgr, VmaAllocator allocator) noexcept : device(device), buffer_mgr(buffer_mgr), allocator(allocator) {
+TextureManager::TextureManager(vk::PhysicalDevice physical_device, vk::Device device, BufferManager *buffer_mgr, VmaAllocator allocator) noexcept
+    : physical_device(physical_device), device(device), buffer_mgr(buffer_mgr), allocator(allocator) {
 
 }
 
@@ -37,11 +59,21 @@ TextureManager::TextureManager(TextureManager &&other) noexcept {
     *this = std::move(other);
 }
 
+TextureManager::~TextureManager() noexcept {
+    for(auto &t : textures) {
+        _destroy(t);
+    }
+}
+
 TextureManager& TextureManager::operator=(TextureManager &&other) noexcept {
+    physical_device = other.physical_device;
+    device = other.device;
     buffer_mgr = other.buffer_mgr;
     allocator = other.allocator;
     textures = std::move(other.textures);
     texture_paths = std::move(other.texture_paths);
+    texture_hashes = std::move(other.texture_hashes);
+    released = std::move(other.released);
     other.buffer_mgr = nullptr;
     other.allocator = nullptr;
     return *this;
@@ -58,11 +90,34 @@ Handle<Texture> TextureManager::load_from_file(std::filesystem::path file, Queue
         return Handle<Texture>{};
     }
     
-    if(auto it = texture_paths.find(file.string()); it != texture_paths.end()) {
+    // prefer the output of texture_cooker: blocks are uploaded as they are stored, with no decoding.
+    // without textureCompressionBC the source is decoded instead, as if it was never cooked
+    if(auto cooked_file = std::filesystem::path{file}.replace_extension(".etex"); file.extension() != ".etex" && std::filesystem::is_regular_file(cooked_file)) {
+        if(_supports_cooked(cooked_file, image_ci.usage)) { file = cooked_file; }
+    }
+
+    // the same file can be reached through many relative paths
+    std::error_code canonical_error;
+    const auto path_key = std::filesystem::weakly_canonical(file, canonical_error).string();
+    if(auto it = texture_paths.find(path_key); it != texture_paths.end()) {
         // don't compare for data in create info. it will be when it's needed.
-        return textures.at(it->second);
+        return acquire(it->second);
     }    
 
+    // then the same bytes saved under a different name. the file is mapped, cooked blocks go from the mapping
+    // straight into the staging buffer
+    const MappedFile mapped_file{file};
+    if(!mapped_file) {
+        std::cerr << fmt::format("File \"{}\" could not be mapped.", file.string());
+        return Handle<Texture>{};
+    }
+    const auto file_data = mapped_file.data();
+    const auto file_hash = Hash::bytes(file_data);
+    if(auto it = texture_hashes.find(file_hash); it != texture_hashes.end()) {
+        texture_paths[path_key] = it->second;
+        return acquire(it->second);
+    }
+
     if(image_ci.queueFamilyIndexCount == 0) {
         image_ci.queueFamilyIndexCount = 1;
         image_ci.pQueueFamilyIndices = &queue.family_index;
@@ -72,21 +127,62 @@ Handle<Texture> TextureManager::load_from_file(std::filesystem::path file, Queue
         return Handle<Texture>{};
     }
 
-    uint32_t desired_channels = 0;
-    if(image_ci.format == vk::Format::eR8G8B8A8Srgb) {
-        desired_channels = 4;
+    stbi_uc *data{};
+    CookedTexture cooked;
+    std::span<const std::byte> texels;
+    std::vector<vk::BufferImageCopy> regions;
+
+    if(file.extension() == ".etex") {
+        if(!parse_cooked_texture(file_data, cooked)) {
+            std::cerr << fmt::format("Cooked texture \"{}\" is corrupted or was made with an incompatible version of texture_cooker.", file.string());
+            return Handle<Texture>{};
+        }
+
+        image_ci.format = cooked_format_to_vk(cooked.header);
+        if(!_supports(image_ci.format, image_ci.usage)) {
+            std::cerr << fmt::format("Cooked texture \"{}\" is in format {}, which the device doesn't support. Load its source image instead.", file.string(), vk::to_string(image_ci.format));
+            return Handle<Texture>{};
+        }
+        image_ci.extent = vk::Extent3D{cooked.header.width, cooked.header.height, 1};
+        image_ci.mipLevels = cooked.header.mip_count;
+        texels = cooked.data;
+        for(uint32_t i=0; const auto &level : cooked.levels) {
+            regions.push_back(vk::BufferImageCopy{level.offset, {}, {}, vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, i++, 0, 1}, {0, 0, 0}, {level.width, level.height, 1}});
+        }
     } else {
-        std::cerr << fmt::format("Requested texture format: \"{}\" is unsupported", vk::to_string(image_ci.format));
-        return Handle<Texture>{};
-    }
+        if(image_ci.format != vk::Format::eR8G8B8A8Srgb) {
+            std::cerr << fmt::format("Requested texture format: \"{}\" is unsupported", vk::to_string(image_ci.format));
+            return Handle<Texture>{};
+        }
 
-    int x{}, y{}, ch{};
-    auto data = stbi_load(file.string().c_str(), &x, &y, &ch, desired_channels);
-    image_ci.extent = vk::Extent3D{(uint32_t)x, (uint32_t)y, 1};
+        int x{}, y{}, ch{};
+        data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file_data.data()), file_data.size(), &x, &y, &ch, 4);
+        if(!data) {
+            std::cerr << fmt::format("Image could not be loaded.");
+            return Handle<Texture>{};
+        }
 
-    if(!data) {
-        std::cerr << fmt::format("Image could not be loaded.");
-        return Handle<Texture>{};
+        image_ci.extent = vk::Extent3D{(uint32_t)x, (uint32_t)y, 1};
+        texels = std::as_bytes(std::span(data, (size_t)x*y*4));
+        regions.push_back(vk::BufferImageCopy{{}, {}, {}, vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, 0, 0, 1}, {0, 0, 0}, image_ci.extent});
+
+        // TODO GENERATE MIP MAPS
+        if(image_ci.mipLevels > 1) {
+            std::cout << "[WARNING] Mipmaps not supported yet, cook the texture with texture_cooker instead";
+            image_ci.mipLevels = 1;
+        }
+    }
+
+    // and finally the same pixels stored in a different container (i.e. png and jpg of the same image)
+    auto pixel_hash = Hash::bytes(texels);
+    pixel_hash = Hash::combine(pixel_hash, image_ci.format);
+    pixel_hash = Hash::combine(pixel_hash, image_ci.extent);
+    pixel_hash = Hash::combine(pixel_hash, image_ci.mipLevels);
+    if(auto it = texture_hashes.find(pixel_hash); it != texture_hashes.end()) {
+        if(data) { stbi_image_free(data); }
+        texture_paths[path_key] = it->second;
+        texture_hashes[file_hash] = it->second;
+        return acquire(it->second);
     }
 
     Handle<Buffer> stage;
@@ -98,7 +194,7 @@ Handle<Texture> TextureManager::load_from_file(std::filesystem::path file, Queue
     vmaCreateImage(allocator, (VkImageCreateInfo*)&image_ci, &image_aci, &image, &image_alloc, nullptr);
     image_ci.initialLayout = prev_layout;
 
-    static auto cleanup = [&] {
+    auto cleanup = [&] {
         if(data) { stbi_image_free(data); }  
         if(stage) { buffer_mgr->free(stage); }
         if(image) { vmaDestroyImage(allocator, image, image_alloc); }
@@ -107,54 +203,65 @@ Handle<Texture> TextureManager::load_from_file(std::filesystem::path file, Queue
     };
 
     if(!image) {
+        std::cerr << fmt::format("Could not create image of format {}. ", vk::to_string(image_ci.format));
         return cleanup();
     }
     
-    vk::BufferCreateInfo bci{{}, (uint32_t)x*y*4, vk::BufferUsageFlagBits::eTransferSrc};
+    vk::BufferCreateInfo bci{{}, texels.size_bytes(), vk::BufferUsageFlagBits::eTransferSrc};
     VmaAllocationCreateInfo baci{.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, .usage = VMA_MEMORY_USAGE_AUTO};
-    stage = buffer_mgr->allocate(bci, baci, std::as_bytes(std::span(data, x*y*ch)));
+    stage = buffer_mgr->allocate(bci, baci);
 
-    if(!stage) {
+    if(!stage || !buffer_mgr->insert(stage, 0, texels.size_bytes(), [&texels](std::byte *mapped) { std::ranges::copy(texels, mapped); })) {
         return cleanup();
     }
 
+    const vk::ImageSubresourceRange all_levels{vk::ImageAspectFlagBits::eColor, 0, image_ci.mipLevels, 0, 1};
     try {
         cmd.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
-        layout_transition(cmd, image, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTopOfPipe, vk::AccessFlagBits::eNone, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
-        cmd.copyBufferToImage(buffer_mgr->get(stage), image, vk::ImageLayout::eTransferDstOptimal, vk::BufferImageCopy{{}, {}, {}, vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, 0, 0, 1}, {0, 0, 0}, {(uint32_t)x, (uint32_t)y, 1}});
-        layout_transition(cmd, image, vk::ImageLayout::eTransferDstOptimal, image_ci.initialLayout, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+        // nothing was in the image before, so the copy waits for nothing but the transition
+        BarrierBatch barriers{cmd};
+        barriers.image(vk::ImageMemoryBarrier2{
+            vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+            vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, all_levels
+        });
+        barriers.flush();
+        cmd.copyBufferToImage(buffer_mgr->get(stage), image, vk::ImageLayout::eTransferDstOptimal, regions);
+        barriers.image(vk::ImageMemoryBarrier2{
+            vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite, vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead,
+            vk::ImageLayout::eTransferDstOptimal, image_ci.initialLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, all_levels
+        });
+        barriers.flush();
         cmd.end();
     } catch(const std::exception &error) {
         return cleanup();
     }
 
-    if(auto res = queue.submit_async({vk::SubmitInfo{{}, {}, cmd}}); !res.first) {
+    if(auto res = queue.submit_async(vk::SubmitInfo{{}, {}, cmd}); !res.first) {
         return cleanup();
     } else {
         res.second.wait();
     }
 
-    // TODO GENERATE MIP MAPS
-    if(image_ci.mipLevels > 1) {
-        std::cout << "[WARNING] Mipmaps not supported yet";
-    }
-
-    stbi_image_free(data);
+    if(data) { stbi_image_free(data); }
     buffer_mgr->free(stage);
     auto queue_families_span = std::span(image_ci.pQueueFamilyIndices, image_ci.queueFamilyIndexCount);
     Texture texture{image, image_ci.format, image_ci.initialLayout, image_ci.usage, {queue_families_span.begin(), queue_families_span.end()}, image_alloc};
-    Handle<Texture> handle = texture;
-    textures.emplace(handle, std::move(texture));
-    texture_paths[file.string()] = handle;
+    texture.refcount = 1;
+    const auto handle = textures.insert(std::move(texture));
+    texture_paths[path_key] = handle;
+    texture_hashes[file_hash] = handle;
+    texture_hashes[pixel_hash] = handle;
     return handle;
 }
 
-vk::ImageView TextureManager::make_view(Handle<Texture> handle, vk::ImageViewCreateInfo view_ci) const {
+vk::ImageView TextureManager::make_view(Handle<Texture> handle, vk::ImageViewCreateInfo view_ci) {
     if(!textures.contains(handle)) { return nullptr; }
 
     try {
-        view_ci.image = textures.at(handle).image;
-        return device.createImageView(view_ci); 
+        auto &texture = textures.at(handle);
+        view_ci.image = texture.image;
+        if(view_ci.format == vk::Format::eUndefined) { view_ci.format = texture.format; }
+        return texture.views.emplace_back(device.createImageView(view_ci)); 
     } catch(const std::runtime_error &error) {
         // errors: out of host/device memory, invalid opaque capture address khr
         std::cerr << fmt::format("Could not create image view");
@@ -166,4 +273,73 @@ vk::Image TextureManager::get(Handle<Texture> handle) const {
     return textures.at(handle).image;
 }
 
+Handle<Texture> TextureManager::acquire(Handle<Texture> handle) {
+    ++textures.at(handle).refcount;
+    return handle;
+}
+
+void TextureManager::release(Handle<Texture> handle, uint64_t frame) {
+    auto &texture = textures.at(handle);
+    assert(texture.refcount > 0);
+    texture.last_release = std::max(texture.last_release, frame);
+    if(--texture.refcount == 0 && std::find(released.begin(), released.end(), handle) == released.end()) {
+        released.push_back(handle);
+    }
+}
+
+void TextureManager::evict(uint64_t completed_frame) {
+    std::erase_if(released, [&](Handle<Texture> handle) {
+        // acquired again since, its next release to 0 queues it again
+        auto *texture = textures.get(handle);
+        if(!texture || texture->refcount > 0) { return true; }
+        // the frames of every release count, not only of the one that queued it
+        if(texture->last_release > completed_frame) { return false; }
+
+        _destroy(*texture);
+        textures.erase(handle);
+        std::erase_if(texture_paths, [&](const auto &p) { return p.second == handle; });
+        std::erase_if(texture_hashes, [&](const auto &p) { return p.second == handle; });
+        return true;
+    });
+}
+
+void TextureManager::_destroy(Texture &texture) {
+    for(auto &v : texture.views) {
+        device.destroyImageView(v);
+    }
+    texture.views.clear();
+    if(texture.image) {
+        vmaDestroyImage(allocator, texture.image, texture.allocation);
+        texture.image = nullptr;
+        texture.allocation = nullptr;
+    }
+}
+
+bool TextureManager::_supports(vk::Format format, vk::ImageUsageFlags usage) const {
+    if(format == vk::Format::eUndefined) { return false; }
+    const auto features = physical_device.getFormatProperties(format).optimalTilingFeatures;
+    vk::FormatFeatureFlags needed{};
+    if(usage & vk::ImageUsageFlagBits::eSampled) { needed |= vk::FormatFeatureFlagBits::eSampledImage; }
+    if(usage & vk::ImageUsageFlagBits::eTransferDst) { needed |= vk::FormatFeatureFlagBits::eTransferDst; }
+    if(usage & vk::ImageUsageFlagBits::eTransferSrc) { needed |= vk::FormatFeatureFlagBits::eTransferSrc; }
+    if(usage & vk::ImageUsageFlagBits::eStorage) { needed |= vk::FormatFeatureFlagBits::eStorageImage; }
+    if(usage & vk::ImageUsageFlagBits::eColorAttachment) { needed |= vk::FormatFeatureFlagBits::eColorAttachment; }
+    return (features & needed) == needed;
+}
+
+// only the header is read, the file is mapped once it's chosen
+bool TextureManager::_supports_cooked(const std::filesystem::path &cooked_file, vk::ImageUsageFlags usage) const {
+    CookedTextureHeader header;
+    std::ifstream stream{cooked_file, std::ios::binary};
+    if(!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != CookedTextureHeader::MAGIC || header.version != CookedTextureHeader::VERSION) {
+        std::cerr << fmt::format("Cooked texture \"{}\" is corrupted or was made with an incompatible version of texture_cooker, loading its source image.", cooked_file.string());
+        return false;
+    }
+    if(const auto format = cooked_format_to_vk(header); !_supports(format, usage)) {
+        std::cerr << fmt::format("Cooked texture \"{}\" is in format {}, which the device doesn't support, loading its source image.", cooked_file.string(), vk::to_string(format));
+        return false;
+    }
+    return true;
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+namespace eng {
+
+// the fastest of `runs` calls of f in milliseconds, the least disturbed by everything else on the machine
+template<typename F> double best_ms(int runs, F &&f) {
+    double best = 1e30;
+    for(int i=0; i<runs; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include <engine/bvh.hpp>
+#include "frustum_culling.hpp"
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <fmt/core.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace eng;
+
+int main(int argc, char **argv) {
+    const int runs = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 10;
+    constexpr size_t QUERIES = 1000;
+
+    // same scene as frustum_cull_bench, so the frustum numbers can be put next to each other
+    const auto clip_from_world = glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f) * glm::lookAt(glm::vec3{0.0f}, glm::vec3{0.0f, 0.0f, -1.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+    const auto frustum = Frustum::from_matrix(clip_from_world);
+    fmt::println("{} runs, best run of each, {} rays and boxes per query run", runs, QUERIES);
+
+    bool ok = true;
+    for(const size_t count : {10'000, 100'000, 1'000'000}) {
+        std::mt19937 rng{42};
+        std::uniform_real_distribution<float> position{-400.0f, 400.0f}, size{0.5f, 8.0f}, nudge{-1.0f, 1.0f};
+        std::vector<Aabb> boxes(count);
+        InstanceBounds bounds;
+        bounds.resize(count);
+        for(auto i=0u; i<count; ++i) {
+            const glm::vec3 center{position(rng), position(rng), position(rng)}, extent{size(rng), size(rng), size(rng)};
+            boxes[i] = Aabb{center - extent, center + extent};
+            bounds.set(i, boxes[i].min, boxes[i].max);
+        }
+        std::vector<Ray> rays(QUERIES);
+        std::vector<Aabb> areas(QUERIES);
+        for(auto i=0u; i<QUERIES; ++i) {
+            rays[i] = Ray{glm::vec3{position(rng), position(rng), -500.0f}, glm::normalize(glm::vec3{nudge(rng) * 0.2f, nudge(rng) * 0.2f, 1.0f})};
+            const glm::vec3 center{position(rng), position(rng), position(rng)};
+            areas[i] = Aabb{center - 20.0f, center + 20.0f};
+        }
+
+        Bvh bvh;
+        const auto build_ms = best_ms(runs, [&] { bvh.build(boxes); });
+        fmt::println("{} instances, {} nodes", count, bvh.node_count());
+        fmt::println("  {:<20} {:8.3f} ms", "build", build_ms);
+
+        // every box moves a little, like a scene where everything is animated
+        auto moved = boxes;
+        for(auto &b : moved) {
+            const glm::vec3 offset{nudge(rng), nudge(rng), nudge(rng)};
+            b.min += offset;
+            b.max += offset;
+        }
+        const auto update_ms = best_ms(runs, [&] { for(auto i=0u; i<count; ++i) { bvh.update(i, moved[i]); } });
+        const auto refit_ms = best_ms(1, [&] { bvh.refit(); });
+        fmt::println("  {:<20} {:8.3f} ms", "update all", update_ms);
+        fmt::println("  {:<20} {:8.3f} ms", "refit all", refit_ms);
+        bvh.build(boxes);
+
+        const auto churn = std::min<size_t>(count / 10, 10'000);
+        const auto remove_ms = best_ms(1, [&] { for(auto i=0u; i<churn; ++i) { bvh.remove(i * 7 % count); } });
+        const auto insert_ms = best_ms(1, [&] { for(auto i=0u; i<churn; ++i) { bvh.insert(i * 7 % count, boxes[i * 7 % count]); } });
+        fmt::println("  {:<20} {:8.3f} us each", "remove", remove_ms * 1e3 / churn);
+        fmt::println("  {:<20} {:8.3f} us each", "insert", insert_ms * 1e3 / churn);
+        bvh.build(boxes);
+
+        std::vector<uint32_t> reference, visible;
+        FrustumCuller::cull(frustum, bounds, reference);
+        const auto linear_ms = best_ms(runs, [&] { FrustumCuller::cull(frustum, bounds, visible); });
+        const auto frustum_ms = best_ms(runs, [&] {
+            visible.clear();
+            bvh.query(frustum, visible);
+        });
+        std::sort(visible.begin(), visible.end());
+        ok = ok && visible == reference;
+        fmt::println("  {:<20} {:8.3f} ms, linear cull {:.3f} ms, {} visible{}", "frustum query", frustum_ms, linear_ms, visible.size(), visible == reference ? "" : "  MISMATCH");
+
+        size_t hits = 0, overlaps = 0;
+        const auto ray_ms = best_ms(runs, [&] {
+            hits = 0;
+            for(const auto &r : rays) { hits += bvh.raycast(r).has_value(); }
+        });
+        const auto area_ms = best_ms(runs, [&] {
+            overlaps = 0;
+            for(const auto &a : areas) {
+                visible.clear();
+                bvh.query(a, visible);
+                overlaps += visible.size();
+            }
+        });
+        fmt::println("  {:<20} {:8.3f} us each, {} hit", "raycast", ray_ms * 1e3 / QUERIES, hits);
+        fmt::println("  {:<20} {:8.3f} us each, {:.1f} found on average", "aabb query", area_ms * 1e3 / QUERIES, (double)overlaps / QUERIES);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include <engine/ecs.hpp>
+#include <engine/bvh.hpp>
+#include <engine/components.hpp>
+#include <engine/handle.hpp>
+#include <engine/model.hpp>
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <fmt/core.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace eng;
+
+// what the renderer kept per instance before the registry, with the vulkan handles as plain integers
+struct OldMeshInstance {
+    uint64_t pipeline{0}, pipeline_layout{0}, material_descriptor{0};
+    uint32_t mesh_idx{0}, lod{0};
+    uint32_t meshlet_draw_slot{~0u}, first_meshlet_draw{0};
+    uint32_t instance_draw_slot{~0u}, first_instance_draw{0}, instance_draw_count{0};
+    int32_t instance_id{-1};
+    uint32_t node{0};
+};
+
+// GpuMesh, which has a copy of the levels now so the per instance loops don't go into the Mesh
+struct BenchMesh {
+    const Mesh *original{nullptr};
+    glm::vec3 aabb_min{-1.0f}, aabb_max{1.0f};
+    std::array<MeshLod, MESH_MAX_LODS> lods{};
+    uint32_t lod_count{1};
+};
+
+// renderer.hpp's Material with the vulkan handles as plain integers, the other components are the renderer's own
+namespace eng { struct Texture; }
+struct Material {
+    uint64_t pipeline{0}, pipeline_layout{0}, descriptor{0}, descriptor_pool{0};
+    Handle<Texture> texture{};
+};
+
+static float max_scale(const glm::mat4 &world) {
+    return std::max({glm::length(glm::vec3{world[0]}), glm::length(glm::vec3{world[1]}), glm::length(glm::vec3{world[2]})});
+}
+
+static uint32_t pick_lod(const Mesh &mesh, uint32_t current, float pixels) {
+    const auto lod_count = (uint32_t)mesh.lod_count();
+    auto lod = std::min(current, lod_count - 1);
+    while(lod > 0 && mesh.lod(lod).error * pixels > 1.25f) { --lod; }
+    while(lod + 1 < lod_count && mesh.lod(lod + 1).error * pixels < 0.75f) { ++lod; }
+    return lod;
+}
+
+static uint32_t pick_lod(const BenchMesh &mesh, uint32_t current, float pixels) {
+    auto lod = std::min(current, mesh.lod_count - 1);
+    while(lod > 0 && mesh.lods[lod].error * pixels > 1.25f) { --lod; }
+    while(lod + 1 < mesh.lod_count && mesh.lods[lod + 1].error * pixels < 0.75f) { ++lod; }
+    return lod;
+}
+
+static Aabb transform_box(const glm::mat4 &world, const BenchMesh &mesh) {
+    const auto center = glm::vec3{world * glm::vec4{(mesh.aabb_min + mesh.aabb_max) * 0.5f, 1.0f}};
+    const auto extent = glm::mat3{glm::abs(glm::vec3{world[0]}), glm::abs(glm::vec3{world[1]}), glm::abs(glm::vec3{world[2]})} * ((mesh.aabb_max - mesh.aabb_min) * 0.5f);
+    return Aabb{center - extent, center + extent};
+}
+
+int main(int argc, char **argv) {
+    const int runs = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 10;
+    constexpr uint32_t MESHES_PER_MODEL = 8;
+    constexpr float PIXELS_PER_UNIT = 384.0f;
+    fmt::println("{} runs, best run of each, {} meshes per model", runs, MESHES_PER_MODEL);
+
+    bool ok = true;
+    for(const size_t count : {10'000, 100'000, 1'000'000}) {
+        std::mt19937 rng{42};
+        std::uniform_real_distribution<float> position{-400.0f, 400.0f}, scale{0.001f, 0.05f};
+        std::uniform_int_distribution<uint64_t> pipeline{1, 8};
+
+        // every model as the drop handler made them, its own geometry behind two allocations
+        const auto model_count = count / MESHES_PER_MODEL;
+        std::vector<std::unique_ptr<Model>> models(model_count);
+        std::vector<glm::mat4> worlds(model_count);
+        for(auto m=0u; m<model_count; ++m) {
+            auto geometry = new Geometry{};
+            geometry->meshes.resize(MESHES_PER_MODEL);
+            for(auto &mesh : geometry->meshes) {
+                for(auto l=0u; l<4; ++l) { mesh.lods.push_back(MeshLod{0, 3000u >> l, 0.01f * (float)(1 << l)}); }
+            }
+            models[m] = std::make_unique<Model>(Model{geometry, glm::scale(glm::translate(glm::mat4{1.0f}, glm::vec3{position(rng), position(rng), position(rng)}), glm::vec3{scale(rng)})});
+            worlds[m] = models[m]->transform;
+        }
+
+        std::vector<BenchMesh> meshes;
+        std::vector<OldMeshInstance> instances;
+        EntityRegistry registry;
+        for(auto m=0u; m<model_count; ++m) {
+            for(const auto &mesh : models[m]->geometry->meshes) {
+                const auto mesh_idx = (uint32_t)meshes.size();
+                auto &bench_mesh = meshes.emplace_back(BenchMesh{.original = &mesh, .lod_count = (uint32_t)mesh.lod_count()});
+                std::copy(mesh.lods.begin(), mesh.lods.end(), bench_mesh.lods.begin());
+                const auto p = pipeline(rng);
+                instances.push_back(OldMeshInstance{.pipeline = p, .pipeline_layout = p, .mesh_idx = mesh_idx, .instance_id = (int32_t)instances.size(), .node = m});
+                const auto e = registry.create();
+                registry.add(e, Transform{m});
+                registry.add(e, MeshRef{mesh_idx, 0});
+                registry.add(e, Material{.pipeline = p, .pipeline_layout = p});
+                registry.add(e, WorldBounds{});
+                registry.add(e, Visibility{});
+            }
+        }
+        auto &renderables = *registry.find<Transform, MeshRef, Material, WorldBounds, Visibility>();
+        fmt::println("{} instances", instances.size());
+
+        // level of detail of everything: the models one by one, the instance structs, the registry's columns
+        size_t triangles = 0;
+        const auto models_ms = best_ms(runs, [&] {
+            triangles = 0;
+            for(const auto &model : models) {
+                const auto pixels = PIXELS_PER_UNIT * max_scale(model->transform);
+                for(const auto &mesh : model->geometry->meshes) { triangles += mesh.lod(pick_lod(mesh, 0, pixels)).index_count / 3; }
+            }
+        });
+        const auto models_triangles = triangles;
+        const auto instances_ms = best_ms(runs, [&] {
+            triangles = 0;
+            for(auto &mi : instances) {
+                const auto &mesh = *meshes[mi.mesh_idx].original;
+                mi.lod = pick_lod(mesh, mi.lod, PIXELS_PER_UNIT * max_scale(worlds[mi.node]));
+                triangles += mesh.lod(mi.lod).index_count / 3;
+            }
+        });
+        const auto instances_triangles = triangles;
+        const auto ecs_ms = best_ms(runs, [&] {
+            triangles = 0;
+            registry.each<Transform, MeshRef>([&](Entity, const Transform &transform, MeshRef &ref) {
+                const auto &mesh = meshes[ref.mesh_idx];
+                ref.lod = pick_lod(mesh, ref.lod, PIXELS_PER_UNIT * max_scale(worlds[transform.node]));
+                triangles += mesh.lods[ref.lod].index_count / 3;
+            });
+        });
+        if(triangles != models_triangles || triangles != instances_triangles) {
+            fmt::println("  triangle counts differ: {} {} {}", models_triangles, instances_triangles, triangles);
+            ok = false;
+        }
+        fmt::println("  {:<28} {:8.3f} ms", "lods, Model->Geometry->Mesh", models_ms);
+        fmt::println("  {:<28} {:8.3f} ms", "lods, MeshInstance structs", instances_ms);
+        fmt::println("  {:<28} {:8.3f} ms", "lods, registry query", ecs_ms);
+
+        // world boxes of everything after all nodes moved
+        std::vector<Aabb> boxes(instances.size());
+        const auto instance_bounds_ms = best_ms(runs, [&] {
+            for(auto i=0u; i<instances.size(); ++i) { boxes[i] = transform_box(worlds[instances[i].node], meshes[instances[i].mesh_idx]); }
+        });
+        const auto ecs_bounds_ms = best_ms(runs, [&] {
+            const auto transforms = renderables.column<Transform>();
+            const auto refs = renderables.column<MeshRef>();
+            const auto bounds = renderables.column<WorldBounds>();
+            for(auto row=0u; row<renderables.size(); ++row) { bounds[row].box = transform_box(worlds[transforms[row].node], meshes[refs[row].mesh_idx]); }
+        });
+        fmt::println("  {:<28} {:8.3f} ms", "bounds, MeshInstance structs", instance_bounds_ms);
+        fmt::println("  {:<28} {:8.3f} ms", "bounds, archetype columns", ecs_bounds_ms);
+
+        // how many pipeline binds a draw loop over everything does
+        size_t binds = 0;
+        const auto instance_binds_ms = best_ms(runs, [&] {
+            binds = 0;
+            uint64_t bound = 0;
+            for(const auto &mi : instances) {
+                if(mi.pipeline != bound) { ++binds; bound = mi.pipeline; }
+            }
+        });
+        const auto instance_binds = binds;
+        const auto ecs_binds_ms = best_ms(runs, [&] {
+            binds = 0;
+            uint64_t bound = 0;
+            for(const auto &material : renderables.column<Material>()) {
+                if(material.pipeline != bound) { ++binds; bound = material.pipeline; }
+            }
+        });
+        if(binds != instance_binds) {
+            fmt::println("  bind counts differ: {} {}", instance_binds, binds);
+            ok = false;
+        }
+        fmt::println("  {:<28} {:8.3f} ms", "binds, MeshInstance structs", instance_binds_ms);
+        fmt::println("  {:<28} {:8.3f} ms", "binds, archetype columns", ecs_binds_ms);
+
+        for(auto &model : models) { delete model->geometry; }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include <engine/frame_arena.hpp>
+#include <engine/alloc_counter.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <span>
+#include <vector>
+
+#include <fmt/core.h>
+
+using namespace eng;
+
+// the scratch update() makes per frame, without vulkan: the jobs of both culling passes, attachments and submits
+struct MeshletCullJob { uint32_t first_meshlet, meshlet_count, first_draw, draw_slot, instance, instance_id; };
+struct InstanceCullJob { float center[4]{}, extent[4]{}; uint32_t instance{0}, index_count{0}, first_index{0}, draw_slot{0}, first_draw{0}; int32_t vertex_offset{0}; };
+struct Attachment { uint64_t view; uint32_t layout, load_op, store_op; float clear[4]; };
+struct Submit { uint64_t wait, command_buffer, signal; };
+
+// every visible instance's level has this many groups of meshlets
+template<typename Vec> static uint64_t fill_meshlet_jobs(Vec &meshlet_jobs, std::span<const uint32_t> visible, std::span<const uint32_t> groups) {
+    uint64_t sum = 0;
+    for(const auto i : visible) {
+        for(auto m=0u; m<groups[i]; ++m) { meshlet_jobs.push_back(MeshletCullJob{m, 32, i, i, i, i}); }
+    }
+    for(const auto &job : meshlet_jobs) { sum += job.first_meshlet; }
+    return sum;
+}
+
+struct FrameStats {
+    double ms{0.0};
+    uint64_t allocations{0}; // over the measured frames, after the warm up
+    uint64_t checksum{0};
+};
+
+// frame f sees visible_sets[f % size], the warm up goes through all of them on every frame in flight
+template<typename Frame> static FrameStats run(int frames, int warmup, const std::vector<std::vector<uint32_t>> &visible_sets, Frame &&frame) {
+    FrameStats stats;
+    for(int f=0; f<warmup; ++f) { stats.checksum += frame(f, visible_sets[f % visible_sets.size()]); }
+    const auto allocations = heap_allocation_count();
+    const auto start = std::chrono::steady_clock::now();
+    for(int f=warmup; f<warmup+frames; ++f) { stats.checksum += frame(f, visible_sets[f % visible_sets.size()]); }
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+    stats.allocations = heap_allocation_count() - allocations;
+    return stats;
+}
+
+int main(int argc, char **argv) {
+    const int frames = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 1000;
+    constexpr size_t FRAMES_IN_FLIGHT = 3;
+    // a camera going around, each view sees 90 to 100% of the instances. coprime to the frames in flight
+    constexpr size_t VIEWS = 32;
+    constexpr int WARMUP = VIEWS * FRAMES_IN_FLIGHT;
+    fmt::println("{} frames after {} to warm up, {} frames in flight", frames, WARMUP, FRAMES_IN_FLIGHT);
+
+    bool steady = true;
+    for(const uint32_t instances : {100u, 1'000u, 10'000u}) {
+        fmt::println("{} instances", instances);
+        std::mt19937 rng{7};
+        std::uniform_int_distribution<uint32_t> group_count{1, 12};
+        std::vector<uint32_t> groups(instances);
+        for(auto &g : groups) { g = group_count(rng); }
+        std::bernoulli_distribution in_view{0.95};
+        std::vector<std::vector<uint32_t>> visible_sets(VIEWS);
+        for(auto &set : visible_sets) {
+            for(auto i=0u; i<instances; ++i) {
+                if(in_view(rng)) { set.push_back(i); }
+            }
+        }
+
+        // what update() did: new vectors every frame
+        const auto heap = run(frames, WARMUP, visible_sets, [&](int, std::span<const uint32_t> visible) -> uint64_t {
+            std::vector<Attachment> attachments{Attachment{1, 2, 1, 0, {}}, Attachment{2, 2, 1, 0, {}}};
+            std::vector<MeshletCullJob> meshlet_jobs;
+            const auto sum = fill_meshlet_jobs(meshlet_jobs, visible, groups);
+            std::vector<InstanceCullJob> instance_jobs;
+            for(const auto i : visible) { instance_jobs.push_back(InstanceCullJob{.instance = i}); }
+            std::vector<Submit> submits{Submit{1, 2, 3}};
+            return sum + attachments.size() + instance_jobs.size() + submits.size();
+        });
+
+        // now: arrays on the stack and the jobs in the frame's arena
+        std::array<std::unique_ptr<FrameArena>, FRAMES_IN_FLIGHT> arenas;
+        for(auto &arena : arenas) { arena = std::make_unique<FrameArena>(); }
+        const auto arena = run(frames, WARMUP, visible_sets, [&](int f, std::span<const uint32_t> visible) -> uint64_t {
+            auto &frame_arena = *arenas[f % FRAMES_IN_FLIGHT];
+            frame_arena.reset();
+            const std::array<Attachment, 2> attachments{Attachment{1, 2, 1, 0, {}}, Attachment{2, 2, 1, 0, {}}};
+            std::pmr::vector<MeshletCullJob> meshlet_jobs{frame_arena.resource()};
+            const auto sum = fill_meshlet_jobs(meshlet_jobs, visible, groups);
+            std::pmr::vector<InstanceCullJob> instance_jobs{frame_arena.resource()};
+            instance_jobs.reserve(visible.size());
+            for(const auto i : visible) { instance_jobs.push_back(InstanceCullJob{.instance = i}); }
+            const Submit submit{1, 2, 3};
+            return sum + attachments.size() + instance_jobs.size() + (submit.command_buffer > 0);
+        });
+        if(heap.checksum != arena.checksum) { fmt::println("  checksums differ: {} {}", heap.checksum, arena.checksum); }
+
+        size_t capacity = 0;
+        uint64_t blocks = 0;
+        for(const auto &a : arenas) {
+            capacity += a->capacity();
+            blocks += a->block_allocations();
+        }
+        fmt::println("  {:<14} {:8.4f} ms/frame {:8.2f} allocations/frame", "std::vector", heap.ms, (double)heap.allocations / frames);
+        fmt::println("  {:<14} {:8.4f} ms/frame {:8.2f} allocations/frame, {} KiB in {} blocks allocated", "frame arena", arena.ms, (double)arena.allocations / frames, capacity / 1024, blocks);
+        steady = steady && arena.allocations == 0;
+    }
+
+    if(!steady) {
+        fmt::println("the frame arena still allocated after the warm up");
+        return EXIT_FAILURE;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "frustum_culling.hpp"
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <fmt/core.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace eng;
+
+int main(int argc, char **argv) {
+    const int runs = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 20;
+
+    // camera in the middle of the boxes looking down -z with a 60 degree fov, about a tenth of them end up visible
+    const auto clip_from_world = glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f) * glm::lookAt(glm::vec3{0.0f}, glm::vec3{0.0f, 0.0f, -1.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+    const auto frustum = Frustum::from_matrix(clip_from_world);
+    fmt::println("{} runs, best run of each, avx2 {}", runs, FrustumCuller::best_kernel() == FrustumCuller::Kernel::AVX2 ? "available" : "not available");
+
+    bool ok = true;
+    for(const size_t count : {10'000, 100'000, 1'000'000}) {
+        InstanceBounds bounds;
+        bounds.resize(count);
+        std::mt19937 rng{42};
+        std::uniform_real_distribution<float> position{-400.0f, 400.0f}, size{0.5f, 8.0f};
+        for(auto i=0u; i<count; ++i) {
+            const glm::vec3 center{position(rng), position(rng), position(rng)}, extent{size(rng), size(rng), size(rng)};
+            bounds.set(i, center - extent, center + extent);
+        }
+
+        std::vector<uint32_t> reference(count), visible;
+        reference.resize(FrustumCuller::cull_scalar(frustum, bounds, 0, count, reference.data()));
+        fmt::println("{} instances, {} visible", count, reference.size());
+
+        const auto report = [&](const char *name, double ms) {
+            ok = ok && visible == reference;
+            fmt::println("  {:<16} {:8.3f} ms {:8.2f} M/s{}", name, ms, count / (ms * 1e3), visible == reference ? "" : "  MISMATCH");
+        };
+        visible.resize(count);
+        report("scalar", best_ms(runs, [&] { visible.resize(FrustumCuller::cull_scalar(frustum, bounds, 0, count, visible.data())); }));
+        if(FrustumCuller::best_kernel() == FrustumCuller::Kernel::AVX2) {
+            visible.resize(count);
+            report("avx2", best_ms(runs, [&] { visible.resize(FrustumCuller::cull_avx2(frustum, bounds, 0, count, visible.data())); }));
+        }
+        report("cull (parallel)", best_ms(runs, [&] { FrustumCuller::cull(frustum, bounds, visible); }));
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "frustum_culling.hpp"
+#include <engine/cpu_features.hpp>
+#include <engine/parallel_for.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace eng {
+
+namespace {
+
+// a box is outside once it is entirely behind any plane: its center's distance plus its extent projected on the normal is negative
+bool is_visible(const Frustum &frustum, const InstanceBounds &bounds, size_t i) {
+    for(const auto &p : frustum.planes) {
+        const auto distance = p.x * bounds.center_x[i] + p.y * bounds.center_y[i] + p.z * bounds.center_z[i] + p.w;
+        const auto radius = std::abs(p.x) * bounds.extent_x[i] + std::abs(p.y) * bounds.extent_y[i] + std::abs(p.z) * bounds.extent_z[i];
+        if(distance + radius < 0.0f) { return false; }
+    }
+    return true;
+}
+
+#ifdef ENG_CPU_X86
+
+__attribute__((target("avx2"))) size_t cull_avx2_impl(const Frustum &frustum, const InstanceBounds &bounds, size_t begin, size_t end, uint32_t *out) {
+    __m256 normal_x[6], normal_y[6], normal_z[6], offset[6], abs_x[6], abs_y[6], abs_z[6];
+    for(auto p=0u; p<6; ++p) {
+        const auto &plane = frustum.planes[p];
+        normal_x[p] = _mm256_set1_ps(plane.x);
+        normal_y[p] = _mm256_set1_ps(plane.y);
+        normal_z[p] = _mm256_set1_ps(plane.z);
+        offset[p] = _mm256_set1_ps(plane.w);
+        abs_x[p] = _mm256_set1_ps(std::abs(plane.x));
+        abs_y[p] = _mm256_set1_ps(std::abs(plane.y));
+        abs_z[p] = _mm256_set1_ps(std::abs(plane.z));
+    }
+
+    // no fma, the avx2 check doesn't cover it and the loop is bound by the loads anyway
+    size_t count = 0, i = begin;
+    for(; i + 8 <= end; i += 8) {
+        const auto cx = _mm256_loadu_ps(&bounds.center_x[i]), cy = _mm256_loadu_ps(&bounds.center_y[i]), cz = _mm256_loadu_ps(&bounds.center_z[i]);
+        const auto ex = _mm256_loadu_ps(&bounds.extent_x[i]), ey = _mm256_loadu_ps(&bounds.extent_y[i]), ez = _mm256_loadu_ps(&bounds.extent_z[i]);
+        auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for(auto p=0u; p<6; ++p) {
+            const auto distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normal_x[p], cx), _mm256_mul_ps(normal_y[p], cy)), _mm256_add_ps(_mm256_mul_ps(normal_z[p], cz), offset[p]));
+            const auto radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(abs_x[p], ex), _mm256_mul_ps(abs_y[p], ey)), _mm256_mul_ps(abs_z[p], ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        for(auto mask = (uint32_t)_mm256_movemask_ps(inside); mask; mask &= mask - 1) {
+            out[count++] = (uint32_t)(i + std::countr_zero(mask));
+        }
+    }
+    for(; i < end; ++i) {
+        if(is_visible(frustum, bounds, i)) { out[count++] = (uint32_t)i; }
+    }
+    return count;
+}
+
+#endif
+
+}
+
+void InstanceBounds::resize(size_t count) {
+    for(auto *v : {&center_x, &center_y, &center_z, &extent_x, &extent_y, &extent_z}) { v->resize(count); }
+}
+
+void InstanceBounds::set(size_t idx, const glm::vec3 &min, const glm::vec3 &max) {
+    const auto center = (min + max) * 0.5f, extent = (max - min) * 0.5f;
+    center_x[idx] = center.x;
+    center_y[idx] = center.y;
+    center_z[idx] = center.z;
+    extent_x[idx] = extent.x;
+    extent_y[idx] = extent.y;
+    extent_z[idx] = extent.z;
+}
+
+void FrustumCuller::cull(const Frustum &frustum, const InstanceBounds &bounds, std::vector<uint32_t> &visible) {
+    cull(best_kernel(), frustum, bounds, visible);
+}
+
+void FrustumCuller::cull(Kernel kernel, const Frustum &frustum, const InstanceBounds &bounds, std::vector<uint32_t> &visible) {
+    const auto run = kernel == Kernel::AVX2 ? &cull_avx2 : &cull_scalar;
+    const auto count = bounds.size();
+    visible.resize(count);
+    if(count <= PARALLEL_CHUNK) {
+        visible.resize(run(frustum, bounds, 0, count, visible.data()));
+        return;
+    }
+
+    // every chunk writes into its own part of `visible`, which are then moved together in order
+    const auto chunk_count = (count + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK;
+    std::vector<size_t> chunk_visible(chunk_count);
+    parallel_for(chunk_count, [&](size_t c) {
+        const auto begin = c * PARALLEL_CHUNK;
+        chunk_visible[c] = run(frustum, bounds, begin, std::min(begin + PARALLEL_CHUNK, count), visible.data() + begin);
+    });
+
+    size_t total = chunk_visible[0];
+    for(auto c=1u; c<chunk_count; ++c) {
+        const auto *chunk = visible.data() + c * PARALLEL_CHUNK;
+        std::copy(chunk, chunk + chunk_visible[c], visible.data() + total);
+        total += chunk_visible[c];
+    }
+    visible.resize(total);
+}
+
+FrustumCuller::Kernel FrustumCuller::best_kernel() {
+    static const auto kernel = cpu_has_avx2() ? Kernel::AVX2 : Kernel::Scalar;
+    return kernel;
+}
+
+size_t FrustumCuller::cull_scalar(const Frustum &frustum, const InstanceBounds &bounds, size_t begin, size_t end, uint32_t *out) {
+    size_t count = 0;
+    for(auto i=begin; i<end; ++i) {
+        if(is_visible(frustum, bounds, i)) { out[count++] = (uint32_t)i; }
+    }
+    return count;
+}
+
+size_t FrustumCuller::cull_avx2(const Frustum &frustum, const InstanceBounds &bounds, size_t begin, size_t end, uint32_t *out) {
+#ifdef ENG_CPU_X86
+    return cull_avx2_impl(frustum, bounds, begin, end, out);
+#else
+    return cull_scalar(frustum, bounds, begin, end, out);
+#endif
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <engine/frustum.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace eng {
+
+// World space boxes of the instances, as centers and half extents in separate arrays,
+// so the simd test can load 8 of each component at once.
+struct InstanceBounds {
+    size_t size() const { return center_x.size(); }
+    void resize(size_t count);
+    void set(size_t idx, const glm::vec3 &min, const glm::vec3 &max);
+
+    std::vector<float> center_x, center_y, center_z;
+    std::vector<float> extent_x, extent_y, extent_z;
+};
+
+// Linear culling of every box, the baseline the bvh benchmark measures Bvh::query against.
+// The renderer culls through the bvh.
+class FrustumCuller {
+public:
+    enum class Kernel : uint8_t { Scalar, AVX2 };
+    // below this many boxes the test runs on the calling thread only, above it in chunks of this size on all cores
+    static constexpr size_t PARALLEL_CHUNK = 1 << 14;
+
+    // replaces `visible` with the indices of the boxes at least partly inside the frustum, in increasing order.
+    // uses the widest kernel the cpu supports
+    static void cull(const Frustum &frustum, const InstanceBounds &bounds, std::vector<uint32_t> &visible);
+    static void cull(Kernel kernel, const Frustum &frustum, const InstanceBounds &bounds, std::vector<uint32_t> &visible);
+    static Kernel best_kernel();
+
+    // test the boxes in [begin, end) on the calling thread, `out` needs room for all of them. returns how many are visible
+    static size_t cull_scalar(const Frustum &frustum, const InstanceBounds &bounds, size_t begin, size_t end, uint32_t *out);
+    static size_t cull_avx2(const Frustum &frustum, const InstanceBounds &bounds, size_t begin, size_t end, uint32_t *out);
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include <engine/handle_pool.hpp>
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+
+using namespace eng;
+
+// what handles were before the pools: an id from a global counter, with the vptr of the virtual destructor
+struct MapHandle {
+    MapHandle() = default;
+    explicit MapHandle(size_t handle): handle(handle) { }
+    virtual ~MapHandle() = default;
+    MapHandle(const MapHandle&) = default;
+    MapHandle& operator=(const MapHandle&) = default;
+    bool operator==(const MapHandle &other) const { return handle == other.handle; }
+    size_t handle{0};
+};
+
+template<> struct std::hash<MapHandle> {
+    size_t operator()(const MapHandle &h) const noexcept { return h.handle; }
+};
+
+// about what BufferManager keeps per buffer
+struct Value {
+    uint64_t buffer{0}, allocation{0};
+    uint32_t usage{0};
+    size_t size{0}, capacity{0};
+    std::vector<uint32_t> queue_families{};
+};
+
+int main(int argc, char **argv) {
+    const int runs = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 10;
+    constexpr size_t LOOKUPS = 1'000'000;
+    fmt::println("{} runs, best run of each, {} lookups per run", runs, LOOKUPS);
+    fmt::println("handle size: map {} bytes, pool {} bytes", sizeof(MapHandle), sizeof(Handle<Value>));
+
+    bool ok = true;
+    for(const size_t count : {100, 10'000, 1'000'000}) {
+        std::mt19937 rng{42};
+        std::uniform_int_distribution<size_t> pick{0, count - 1};
+        std::vector<size_t> order(LOOKUPS);
+        for(auto &o : order) { o = pick(rng); }
+
+        std::unordered_map<MapHandle, Value> map;
+        std::vector<MapHandle> map_handles;
+        size_t next_id = 0;
+        const auto map_insert_ms = best_ms(1, [&] {
+            for(auto i=0u; i<count; ++i) {
+                map_handles.emplace_back(++next_id);
+                map.emplace(map_handles.back(), Value{.buffer = i, .size = i});
+            }
+        });
+        HandlePool<Value> pool;
+        std::vector<Handle<Value>> pool_handles;
+        const auto pool_insert_ms = best_ms(1, [&] {
+            for(auto i=0u; i<count; ++i) { pool_handles.push_back(pool.insert(Value{.buffer = i, .size = i})); }
+        });
+
+        // BufferManager::get and size, in random order
+        size_t sum = 0;
+        const auto map_get_ms = best_ms(runs, [&] {
+            sum = 0;
+            for(const auto o : order) { sum += map.at(map_handles[o]).size; }
+        });
+        const auto map_sum = sum;
+        const auto pool_get_ms = best_ms(runs, [&] {
+            sum = 0;
+            for(const auto o : order) { sum += pool.at(pool_handles[o]).size; }
+        });
+        if(sum != map_sum) {
+            fmt::println("  sums differ: {} {}", map_sum, sum);
+            ok = false;
+        }
+
+        // staging buffers come and go every frame
+        const auto churn = std::min<size_t>(count, 10'000);
+        const auto map_churn_ms = best_ms(runs, [&] {
+            for(auto i=0u; i<churn; ++i) {
+                auto &h = map_handles[i * 7 % count];
+                map.erase(h);
+                h = MapHandle{++next_id};
+                map.emplace(h, Value{.size = i});
+            }
+        });
+        const auto pool_churn_ms = best_ms(runs, [&] {
+            for(auto i=0u; i<churn; ++i) {
+                auto &h = pool_handles[i * 7 % count];
+                pool.erase(h);
+                h = pool.insert(Value{.size = i});
+            }
+        });
+
+        // the destructors go over all of them
+        const auto map_iterate_ms = best_ms(runs, [&] {
+            sum = 0;
+            for(const auto &[h, v] : map) { sum += v.capacity + v.buffer; }
+        });
+        const auto map_iterate_sum = sum;
+        const auto pool_iterate_ms = best_ms(runs, [&] {
+            sum = 0;
+            for(const auto &v : pool) { sum += v.capacity + v.buffer; }
+        });
+        if(sum != map_iterate_sum) {
+            fmt::println("  sums differ: {} {}", map_iterate_sum, sum);
+            ok = false;
+        }
+
+        fmt::println("{} values", count);
+        fmt::println("  {:<16} {:>10} {:>10}", "", "map", "pool");
+        fmt::println("  {:<16} {:8.3f}ms {:8.3f}ms", "insert all", map_insert_ms, pool_insert_ms);
+        fmt::println("  {:<16} {:8.3f}ms {:8.3f}ms", "lookups", map_get_ms, pool_get_ms);
+        fmt::println("  {:<16} {:8.3f}ms {:8.3f}ms", "erase+insert", map_churn_ms, pool_churn_ms);
+        fmt::println("  {:<16} {:8.3f}ms {:8.3f}ms", "iterate all", map_iterate_ms, pool_iterate_ms);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include <engine/model_loader.hpp>
+#include <engine/mesh_format.hpp>
+#include <engine/vertex_packing.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+using namespace eng;
+
+static uint32_t add_string(std::vector<char> &strings, const std::string &s) {
+    const auto offset = (uint32_t)strings.size();
+    strings.insert(strings.end(), s.begin(), s.end());
+    strings.push_back('\0');
+    return offset;
+}
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool write_cooked(const Geometry &geom, const VertexLayout &layout, const std::filesystem::path &output) {
+    const auto output_dir = std::filesystem::absolute(output).parent_path();
+    std::vector<CookedMeshEntry> entries;
+    std::vector<char> strings;
+    std::vector<std::byte> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<CookedMeshlet> meshlets;
+
+    const auto texture_path = [&](const Mesh &mesh, TextureType type) {
+        auto it = mesh.material.texture_paths.find(type);
+        if(it == mesh.material.texture_paths.end()) { return CookedMeshEntry::NO_STRING; }
+        return add_string(strings, std::filesystem::proximate(it->second, output_dir).generic_string());
+    };
+
+    for(const auto &mesh : geom.meshes) {
+        CookedMeshEntry e;
+        e.first_vertex = vertices.size() / layout.stride;
+        e.vertex_count = mesh.vertex_positions.size();
+        e.first_index = indices.size();
+        e.index_count = mesh.vertex_indices.size();
+        e.diffuse_texture = texture_path(mesh, TextureType::Diffuse);
+        e.normal_texture = texture_path(mesh, TextureType::Normal);
+        e.lod_count = mesh.lods.size();
+        for(auto l=0u; l<mesh.lods.size(); ++l) {
+            const auto &lod = mesh.lods[l];
+            e.lods[l] = CookedMeshLod{lod.first_index, lod.index_count, lod.error, lod.first_meshlet, lod.meshlet_count};
+        }
+        e.first_meshlet = meshlets.size();
+        e.meshlet_count = mesh.meshlets.size();
+        for(const auto &m : mesh.meshlets) {
+            CookedMeshlet cm;
+            std::copy_n(&m.center.x, 3, cm.center);
+            std::copy_n(&m.cone_axis.x, 3, cm.cone_axis);
+            cm.radius = m.radius;
+            cm.cone_cutoff = m.cone_cutoff;
+            cm.first_index = m.first_index;
+            cm.index_count = m.index_count;
+            meshlets.push_back(cm);
+        }
+
+        // exact bounds of the vertices instead of assimp's, the quantization is relative to them
+        const auto streams = VertexPacker::streams(mesh);
+        const auto bounds = VertexPacker::compute_bounds(streams);
+        vertices.resize(vertices.size() + mesh.vertex_positions.size() * layout.stride);
+        VertexPacker::pack(streams, layout, bounds, vertices.data() + (size_t)e.first_vertex * layout.stride);
+        std::copy_n(&bounds.position_min.x, 3, e.aabb_min);
+        std::copy_n(&bounds.position_max.x, 3, e.aabb_max);
+        std::copy_n(&bounds.uv_min.x, 2, e.uv_min);
+        std::copy_n(&bounds.uv_max.x, 2, e.uv_max);
+
+        indices.insert(indices.end(), mesh.vertex_indices.begin(), mesh.vertex_indices.end());
+        entries.push_back(e);
+    }
+
+    std::vector<CookedMeshNode> nodes;
+    for(const auto &n : geom.nodes) {
+        CookedMeshNode cn;
+        std::copy_n(&n.transform[0][0], 16, cn.transform);
+        cn.parent = n.parent;
+        cn.first_mesh = n.first_mesh;
+        cn.mesh_count = n.mesh_count;
+        nodes.push_back(cn);
+    }
+
+    CookedMeshHeader header;
+    header.mesh_count = entries.size();
+    header.vertex_stride = layout.stride;
+    std::copy(layout.formats.begin(), layout.formats.end(), header.vertex_formats);
+    header.strings_offset = sizeof(CookedMeshHeader) + entries.size() * sizeof(CookedMeshEntry);
+    header.strings_size = strings.size();
+    header.vertex_offset = align_up(header.strings_offset + header.strings_size, CookedMeshHeader::DATA_ALIGNMENT);
+    header.vertex_size = vertices.size();
+    header.index_offset = align_up(header.vertex_offset + header.vertex_size, CookedMeshHeader::DATA_ALIGNMENT);
+    header.index_size = indices.size() * sizeof(uint32_t);
+    header.meshlet_offset = align_up(header.index_offset + header.index_size, CookedMeshHeader::DATA_ALIGNMENT);
+    header.meshlet_size = meshlets.size() * sizeof(CookedMeshlet);
+    header.node_offset = align_up(header.meshlet_offset + header.meshlet_size, CookedMeshHeader::DATA_ALIGNMENT);
+    header.node_size = nodes.size() * sizeof(CookedMeshNode);
+
+    std::ofstream file{output, std::ios_base::binary | std::ios_base::trunc};
+    if(!file) { return false; }
+
+    static constexpr char padding[CookedMeshHeader::DATA_ALIGNMENT]{};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(CookedMeshEntry));
+    file.write(strings.data(), strings.size());
+    file.write(padding, header.vertex_offset - (header.strings_offset + header.strings_size));
+    file.write(reinterpret_cast<const char*>(vertices.data()), header.vertex_size);
+    file.write(padding, header.index_offset - (header.vertex_offset + header.vertex_size));
+    file.write(reinterpret_cast<const char*>(indices.data()), header.index_size);
+    file.write(padding, header.meshlet_offset - (header.index_offset + header.index_size));
+    file.write(reinterpret_cast<const char*>(meshlets.data()), header.meshlet_size);
+    file.write(padding, header.node_offset - (header.meshlet_offset + header.meshlet_size));
+    file.write(reinterpret_cast<const char*>(nodes.data()), header.node_size);
+    return !!file;
+}
+
+template<typename F> static double time_ms(int runs, F &&f) {
+    const auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<runs; ++i) { f(); }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+int main(int argc, char **argv) {
+    if(argc < 3) {
+        fmt::println("usage: mesh_cooker <input model> <output.emesh> [--positions float|unorm16] [--normals float|oct8|oct16] [--uvs float|half|unorm16] [--no-optimize] [--no-overdraw] [--lods <count>] [--lod-error <relative>] [--no-meshlets] [--bench <runs>]");
+        fmt::println("  --positions  unorm16 quantizes positions within each mesh's bounding box (default)");
+        fmt::println("  --normals    oct8/oct16 store octahedral encoded normals (default: oct16)");
+        fmt::println("  --uvs        half floats or unorm16 within each mesh's uv range (default: half)");
+        fmt::println("  --no-optimize  keeps the vertex and index order of the input, otherwise it's reordered for the vertex cache and fetch");
+        fmt::println("  --no-overdraw  skips the overdraw reordering, which trades a bit of vertex cache efficiency");
+        fmt::println("  --lods       levels of detail to generate, including the full one (default: 6, 1 disables them)");
+        fmt::println("  --lod-error  how far the coarsest level may deviate, relative to the mesh's size (default: 0.05)");
+        fmt::println("  --no-meshlets  leaves out the meshlets the renderer culls the meshes with");
+        fmt::println("  --bench      times loading the input through assimp and loading the cooked output");
+        return 1;
+    }
+
+    using enum VertexAttributeFormat;
+    auto formats = VertexLayout::compact().formats;
+    int bench_runs = 0;
+    bool optimize = true;
+    MeshOptimizerOptions optimizer_options;
+    for(int i=3; i<argc; ++i) {
+        const std::string_view arg = argv[i];
+        const std::string_view value = i + 1 < argc ? argv[i + 1] : "";
+        if(arg == "--no-optimize") { optimize = false; continue; }
+        if(arg == "--no-overdraw") { optimizer_options.overdraw = false; continue; }
+        if(arg == "--no-meshlets") { optimizer_options.meshlets = false; continue; }
+        if(arg == "--lods" && !value.empty()) { optimizer_options.lod_count = std::clamp(std::atoi(value.data()), 1, (int)MESH_MAX_LODS); ++i; continue; }
+        if(arg == "--lod-error" && !value.empty()) { optimizer_options.lod_max_error = std::max((float)std::atof(value.data()), 0.0f); ++i; continue; }
+        auto &position = formats[VertexLayout::Position], &normal = formats[VertexLayout::Normal], &uv = formats[VertexLayout::TextureCoords];
+        if(arg == "--bench" && !value.empty()) { bench_runs = std::max(std::atoi(value.data()), 1); }
+        else if(arg == "--positions" && value == "float") { position = Float3; }
+        else if(arg == "--positions" && value == "unorm16") { position = Unorm16x4; }
+        else if(arg == "--normals" && value == "float") { normal = Float3; }
+        else if(arg == "--normals" && value == "oct8") { normal = Snorm8x2; }
+        else if(arg == "--normals" && value == "oct16") { normal = Snorm16x2; }
+        else if(arg == "--uvs" && value == "float") { uv = Float2; }
+        else if(arg == "--uvs" && value == "half") { uv = Half2; }
+        else if(arg == "--uvs" && value == "unorm16") { uv = Unorm16x2; }
+        else {
+            fmt::println("Unknown option: {} {}", arg, value);
+            return 1;
+        }
+        ++i;
+    }
+    const auto layout = VertexLayout::make(formats[0], formats[1], formats[2]);
+
+    const std::filesystem::path input = argv[1], output = argv[2];
+    auto geom = GeometryImporter::import(input);
+    if(geom.meshes.empty()) {
+        fmt::println("\"{}\" could not be imported or has no meshes.", input.string());
+        return 1;
+    }
+    if(optimize) {
+        const auto report = GeometryImporter::optimize(geom, optimizer_options);
+        fmt::println("vertex cache ({} entries): ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, {} -> {} vertices",
+            MeshOptimizer::CACHE_SIZE, report.before.acmr(), report.after.acmr(), report.before.atvr(), report.after.atvr(), report.vertices_before, report.vertices_after);
+        std::string lods;
+        for(auto l=0u; l<MESH_MAX_LODS && report.lod_triangles[l] > 0; ++l) { lods += fmt::format(" {}", report.lod_triangles[l]); }
+        fmt::println("triangles per level of detail:{}", lods);
+        if(report.meshlets > 0) { fmt::println("{} meshlets", report.meshlets); }
+    }
+    if(!write_cooked(geom, layout, output)) {
+        fmt::println("Could not write \"{}\".", output.string());
+        return 1;
+    }
+
+    size_t vertex_count = 0, index_count = 0;
+    for(const auto &m : geom.meshes) {
+        vertex_count += m.vertex_count();
+        index_count += m.index_count();
+    }
+    fmt::println("{} meshes, {} vertices, {} indices -> {} ({} bytes)", geom.meshes.size(), vertex_count, index_count, output.string(), std::filesystem::file_size(output));
+
+    if(bench_runs > 0) {
+        // only the import is timed for assimp, its vertices still get interleaved on upload. the cooked load includes
+        // the copy out of the mapping that upload_meshes does into the staging buffer
+        size_t sink = 0;
+        std::vector<std::byte> staging;
+        const auto assimp_ms = time_ms(bench_runs, [&] { sink += GeometryImporter::import(input).meshes.size(); });
+        const auto cooked_ms = time_ms(bench_runs, [&] {
+            const auto cooked = GeometryImporter::import(output);
+            for(const auto &m : cooked.meshes) {
+                const auto indices = std::as_bytes(m.packed_indices);
+                staging.resize(std::max(staging.size(), m.packed_vertices.size() + indices.size()));
+                std::ranges::copy(indices, std::ranges::copy(m.packed_vertices, staging.data()).out);
+                sink += staging.size();
+            }
+        });
+        fmt::println("assimp import: {:.3f} ms, cooked load and copy: {:.3f} ms, averaged over {} runs [{}]", assimp_ms, cooked_ms, bench_runs, sink % 2);
+    }
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <engine/texture_format.hpp>
+#include <engine/bc_encoder.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+using namespace eng;
+
+static float srgb_to_linear(uint8_t v) {
+    const float c = v / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t linear_to_srgb(float c) {
+    c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    return (uint8_t)std::lround(std::clamp(c, 0.0f, 1.0f) * 255.0f);
+}
+
+// 2x2 box filter. color channels are averaged in linear space for srgb images, alpha is always linear.
+static std::vector<uint8_t> downsample(const std::vector<uint8_t> &src, uint32_t width, uint32_t height, bool srgb) {
+    const auto dw = std::max(width / 2, 1u), dh = std::max(height / 2, 1u);
+    std::vector<uint8_t> dst((size_t)dw * dh * 4);
+    for(auto y=0u; y<dh; ++y) {
+        for(auto x=0u; x<dw; ++x) {
+            const uint32_t xs[2]{std::min(x*2, width - 1), std::min(x*2 + 1, width - 1)};
+            const uint32_t ys[2]{std::min(y*2, height - 1), std::min(y*2 + 1, height - 1)};
+            for(auto c=0u; c<4; ++c) {
+                float sum = 0.0f;
+                for(auto sy : ys) {
+                    for(auto sx : xs) {
+                        const auto v = src[((size_t)sy * width + sx) * 4 + c];
+                        sum += (srgb && c < 3) ? srgb_to_linear(v) : v / 255.0f;
+                    }
+                }
+                sum *= 0.25f;
+                dst[((size_t)y * dw + x) * 4 + c] = (srgb && c < 3) ? linear_to_srgb(sum) : (uint8_t)std::lround(sum * 255.0f);
+            }
+        }
+    }
+    return dst;
+}
+
+static void print_usage() {
+    fmt::println("usage: texture_cooker <input image> <output.etex> [--format rgba8|bc1|bc3|bc5|bc7] [--linear] [--no-mips]");
+    fmt::println("  --format   block format of the cooked texture (default: bc7)");
+    fmt::println("  --linear   store texels as unorm instead of srgb (normal maps, masks)");
+    fmt::println("  --no-mips  store only the base level");
+}
+
+int main(int argc, char **argv) {
+    if(argc < 3) {
+        print_usage();
+        return 1;
+    }
+
+    CookedTextureFormat format = CookedTextureFormat::BC7;
+    bool srgb = true, mips = true;
+    for(int i=3; i<argc; ++i) {
+        const std::string_view arg = argv[i];
+        if(arg == "--linear") { srgb = false; }
+        else if(arg == "--no-mips") { mips = false; }
+        else if(arg == "--format" && i + 1 < argc) {
+            const std::string_view f = argv[++i];
+            if(f == "rgba8") { format = CookedTextureFormat::RGBA8; }
+            else if(f == "bc1") { format = CookedTextureFormat::BC1; }
+            else if(f == "bc3") { format = CookedTextureFormat::BC3; }
+            else if(f == "bc5") { format = CookedTextureFormat::BC5; }
+            else if(f == "bc7") { format = CookedTextureFormat::BC7; }
+            else { fmt::println("Unknown format: {}", f); return 1; }
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    // BC5 stores two unsigned normalized channels, srgb variants do not exist.
+    if(format == CookedTextureFormat::BC5) { srgb = false; }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    int x{}, y{}, ch{};
+    auto data = stbi_load(argv[1], &x, &y, &ch, 4);
+    if(!data) {
+        fmt::println("Image \"{}\" could not be loaded: {}", argv[1], stbi_failure_reason());
+        return 1;
+    }
+
+    std::vector<uint8_t> level(data, data + (size_t)x * y * 4);
+    stbi_image_free(data);
+
+    CookedTextureHeader header;
+    header.format = format;
+    header.srgb = srgb;
+    header.width = x;
+    header.height = y;
+
+    std::vector<CookedTextureLevel> levels;
+    std::vector<std::byte> level_data;
+    uint32_t w = x, h = y;
+    while(true) {
+        const auto blocks = BCEncoder::compress(format, level.data(), w, h);
+        levels.push_back(CookedTextureLevel{level_data.size(), blocks.size(), w, h});
+        level_data.insert(level_data.end(), blocks.begin(), blocks.end());
+
+        if(!mips || (w == 1 && h == 1)) { break; }
+        level = downsample(level, w, h, srgb);
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
+    }
+    header.mip_count = levels.size();
+
+    std::ofstream file{argv[2], std::ios_base::binary | std::ios_base::trunc};
+    if(!file) {
+        fmt::println("Output file \"{}\" cannot be opened.", argv[2]);
+        return 1;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(CookedTextureLevel));
+    file.write(reinterpret_cast<const char*>(level_data.data()), level_data.size());
+    if(!file) {
+        fmt::println("Could not write \"{}\".", argv[2]);
+        return 1;
+    }
+
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const auto rgba_size = (double)x * y * 4 * (mips ? 4.0 / 3.0 : 1.0);
+    fmt::println("{}x{}, {} mips: {} -> {} bytes ({:.1f}x smaller than rgba8) in {:.1f} ms",
+        x, y, levels.size(), (uint64_t)rgba_size, level_data.size(), rgba_size / level_data.size(), elapsed);
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <engine/vertex_packing.hpp>
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <fmt/core.h>
+
+using namespace eng;
+
+// what Renderer::upload_meshes used to do before the packer existed
+static std::vector<float> pack_push_back(const Mesh &mesh) {
+    std::vector<float> vertices;
+    for(auto i=0u; i<mesh.vertex_positions.size(); ++i) {
+        vertices.push_back(mesh.vertex_positions[i].x);
+        vertices.push_back(mesh.vertex_positions[i].y);
+        vertices.push_back(mesh.vertex_positions[i].z);
+        if(!mesh.vertex_normals.empty()) {
+            vertices.push_back(mesh.vertex_normals[i].x);
+            vertices.push_back(mesh.vertex_normals[i].y);
+            vertices.push_back(mesh.vertex_normals[i].z);
+        } else {
+            vertices.insert(vertices.end(), {0.0f, 0.0f, 0.0f});
+        }
+        if(!mesh.vertex_texture_coords.empty()) {
+            vertices.push_back(mesh.vertex_texture_coords[i].x);
+            vertices.push_back(mesh.vertex_texture_coords[i].y);
+        } else {
+            vertices.insert(vertices.end(), {0.0f, 0.0f});
+        }
+    }
+    return vertices;
+}
+
+int main(int argc, char **argv) {
+    const size_t vertex_count = argc > 1 ? std::max(std::atoll(argv[1]), 1ll) : 4'000'000;
+    const int runs = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 10;
+
+    Mesh mesh;
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<float> dist{-1.0f, 1.0f};
+    mesh.vertex_positions.resize(vertex_count);
+    mesh.vertex_normals.resize(vertex_count);
+    mesh.vertex_texture_coords.resize(vertex_count);
+    for(auto i=0u; i<vertex_count; ++i) {
+        mesh.vertex_positions[i] = {dist(rng), dist(rng), dist(rng)};
+        mesh.vertex_normals[i] = {dist(rng), dist(rng), dist(rng)};
+        mesh.vertex_texture_coords[i] = {dist(rng), dist(rng)};
+    }
+
+    const auto out_size = vertex_count * MESH_VERTEX_STRIDE;
+    const auto in_size = vertex_count * (sizeof(glm::vec3) * 2 + sizeof(glm::vec2));
+    // staging allocations are at least 64 byte aligned as well
+    auto out = std::unique_ptr<std::byte[]>{new (std::align_val_t{64}) std::byte[out_size]};
+    std::memset(out.get(), 0, out_size);
+    std::vector<std::byte> reference(out_size);
+    VertexPacker::pack_scalar(VertexPacker::streams(mesh), reference.data());
+
+    bool ok = true;
+    const auto report = [&](const char *name, double ms, bool matches) {
+        ok = ok && matches;
+        fmt::println("{:<10} {:8.3f} ms {:7.2f} GB/s{}", name, ms, (in_size + out_size) / (ms * 1e6), matches ? "" : "  MISMATCH");
+    };
+    fmt::println("{} vertices, {} runs, best run of each (GB/s counts bytes read + written)", vertex_count, runs);
+
+    size_t sink = 0;
+    report("push_back", best_ms(runs, [&] { sink += pack_push_back(mesh).size(); }), true);
+    report("memcpy", best_ms(runs, [&] { std::memcpy(out.get(), reference.data(), out_size); }), true);
+
+    using Kernel = VertexPacker::Kernel;
+    for(const auto &[kernel, name] : {std::pair{Kernel::Scalar, "scalar"}, std::pair{Kernel::SSE, "sse"}, std::pair{Kernel::AVX2, "avx2"}}) {
+        if(kernel == Kernel::AVX2 && VertexPacker::best_kernel() != Kernel::AVX2) { continue; }
+        std::memset(out.get(), 0, out_size);
+        const auto ms = best_ms(runs, [&] { VertexPacker::pack(kernel, VertexPacker::streams(mesh), out.get()); });
+        report(name, ms, std::memcmp(out.get(), reference.data(), out_size) == 0);
+    }
+    // the baseline's result has to be used, or the packing into it could be optimized away
+    return ok && sink > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
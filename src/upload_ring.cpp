@@ -0,0 +1,51 @@
+#include <engine/upload_ring.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace eng {
+
+namespace {
+    size_t align_up(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+}
+
+bool UploadRing::create(BufferManager &buffers, vk::BufferUsageFlags usage, size_t region_size, uint32_t region_count, size_t alignment) {
+    _alignment = std::max<size_t>(alignment, 1);
+    _region_size = align_up(region_size, _alignment);
+    _region_count = region_count;
+    // dynamic offsets are 32 bit
+    if(_region_count == 0 || _region_size * _region_count > std::numeric_limits<uint32_t>::max()) { return false; }
+
+    // host visible is required, device local preferred
+    const VmaAllocationCreateInfo vmaaci{
+        .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+        .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+    };
+    _handle = buffers.allocate(vk::BufferCreateInfo{{}, _region_size * _region_count, usage}, vmaaci);
+    if(!_handle) { return false; }
+    _buffers = &buffers;
+    _buffer = buffers.get(_handle);
+    _mapped = static_cast<std::byte*>(buffers.get_mapped_data(_handle));
+    _device_local = !!(buffers.memory_properties(_handle) & vk::MemoryPropertyFlagBits::eDeviceLocal);
+    begin_frame(0);
+    return _mapped != nullptr;
+}
+
+void UploadRing::begin_frame(uint32_t region) {
+    _region_begin = (region % std::max(_region_count, 1u)) * _region_size;
+    _offset = _region_begin;
+}
+
+UploadAllocation UploadRing::allocate(size_t size, size_t alignment) {
+    if(!_mapped) { return {}; }
+    const auto begin = align_up(_offset, std::max(alignment, _alignment));
+    if(begin + size > _region_begin + _region_size) { return {}; }
+    _offset = begin + size;
+    return UploadAllocation{_buffer, (uint32_t)begin, (uint32_t)size, _mapped + begin};
+}
+
+void UploadRing::flush() const {
+    if(_buffers && _offset > _region_begin) { _buffers->flush(_handle, _region_begin, _offset - _region_begin); }
+}
+
+}
\ No newline at end of file
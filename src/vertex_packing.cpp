@@ -0,0 +1,243 @@
+#include <engine/vertex_packing.hpp>
+#include <engine/cpu_features.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include <glm/gtc/packing.hpp>
+
+namespace eng {
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float) && sizeof(glm::vec2) == 2 * sizeof(float));
+static_assert(MESH_VERTEX_STRIDE == 8 * sizeof(float));
+
+namespace {
+
+void pack_range_scalar(const VertexStreams &src, size_t begin, size_t end, std::byte *dst) {
+    for(auto i=begin; i<end; ++i) {
+        const auto &p = src.positions[i];
+        const auto n = src.normals ? src.normals[i] : glm::vec3{0.0f};
+        const auto tc = src.texture_coords ? src.texture_coords[i] : glm::vec2{0.0f};
+        const float vertex[]{p.x, p.y, p.z, n.x, n.y, n.z, tc.x, tc.y};
+        memcpy(dst + i * MESH_VERTEX_STRIDE, vertex, MESH_VERTEX_STRIDE);
+    }
+}
+
+uint16_t quantize_unorm16(float v) { return (uint16_t)std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f); }
+
+// maps the unit sphere onto the [-1, 1] square: the upper hemisphere directly, the lower one folded over the diagonals
+glm::vec2 octahedral_encode(glm::vec3 n) {
+    const auto l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if(l1 == 0.0f) { return glm::vec2{0.0f}; }
+    n /= l1;
+    if(n.z >= 0.0f) { return {n.x, n.y}; }
+    return {(1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f)};
+}
+
+template<typename T> void write_snorm2(glm::vec2 v, std::byte *out) {
+    constexpr auto max = (float)std::numeric_limits<T>::max();
+    const T q[2]{(T)std::lround(std::clamp(v.x, -1.0f, 1.0f) * max), (T)std::lround(std::clamp(v.y, -1.0f, 1.0f) * max)};
+    memcpy(out, q, sizeof(q));
+}
+
+glm::vec3 safe_div(glm::vec3 a, glm::vec3 b) { return {b.x > 0.0f ? a.x / b.x : 0.0f, b.y > 0.0f ? a.y / b.y : 0.0f, b.z > 0.0f ? a.z / b.z : 0.0f}; }
+glm::vec2 safe_div(glm::vec2 a, glm::vec2 b) { return {b.x > 0.0f ? a.x / b.x : 0.0f, b.y > 0.0f ? a.y / b.y : 0.0f}; }
+
+#ifdef ENG_CPU_X86
+
+// 4-wide loads of a vec3 read the first float of the next vertex, so the simd loops stop one vertex early
+// and leave the last one to the scalar path. streaming stores skip reading the destination into the cache,
+// which is what uncached staging memory wants anyway, but need aligned addresses.
+
+template<bool NORMALS, bool TEXTURE_COORDS, bool STREAM> void pack_sse_impl(const VertexStreams &src, std::byte *dst) {
+    const auto *p = &src.positions[0].x;
+    const auto *n = NORMALS ? &src.normals[0].x : nullptr;
+    const auto *t = TEXTURE_COORDS ? &src.texture_coords[0].x : nullptr;
+    auto *out = reinterpret_cast<float*>(dst);
+
+    size_t i = 0;
+    for(; i + 1 < src.count; ++i) {
+        const auto pos = _mm_loadu_ps(p + i*3);
+        const auto nrm = NORMALS ? _mm_loadu_ps(n + i*3) : _mm_setzero_ps();
+        const auto tc = TEXTURE_COORDS ? _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(t + i*2))) : _mm_setzero_ps();
+        const auto pz_nx = _mm_shuffle_ps(pos, nrm, _MM_SHUFFLE(0, 0, 2, 2));
+        const auto lo = _mm_shuffle_ps(pos, pz_nx, _MM_SHUFFLE(2, 0, 1, 0)); // px py pz nx
+        const auto hi = _mm_shuffle_ps(nrm, tc, _MM_SHUFFLE(1, 0, 2, 1));    // ny nz u v
+        if constexpr (STREAM) {
+            _mm_stream_ps(out + i*8, lo);
+            _mm_stream_ps(out + i*8 + 4, hi);
+        } else {
+            _mm_storeu_ps(out + i*8, lo);
+            _mm_storeu_ps(out + i*8 + 4, hi);
+        }
+    }
+    if constexpr (STREAM) { _mm_sfence(); }
+    pack_range_scalar(src, i, src.count, dst);
+}
+
+template<bool NORMALS, bool TEXTURE_COORDS, bool STREAM> __attribute__((target("avx2"))) void pack_avx2_impl(const VertexStreams &src, std::byte *dst) {
+    const auto *p = &src.positions[0].x;
+    const auto *n = NORMALS ? &src.normals[0].x : nullptr;
+    const auto *t = TEXTURE_COORDS ? &src.texture_coords[0].x : nullptr;
+    auto *out = reinterpret_cast<float*>(dst);
+
+    // px py pz _ nx ny nz _ -> px py pz nx ny nz _ _, the last two lanes are replaced by the texture coords
+    const auto compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 6, 7);
+    size_t i = 0;
+    for(; i + 1 < src.count; ++i) {
+        const auto pos = _mm_loadu_ps(p + i*3);
+        const auto nrm = NORMALS ? _mm_loadu_ps(n + i*3) : _mm_setzero_ps();
+        const auto tc = TEXTURE_COORDS ? _mm256_castpd_ps(_mm256_broadcast_sd(reinterpret_cast<const double*>(t + i*2))) : _mm256_setzero_ps();
+        const auto v = _mm256_blend_ps(_mm256_permutevar8x32_ps(_mm256_set_m128(nrm, pos), compact), tc, 0b11000000);
+        if constexpr (STREAM) { _mm256_stream_ps(out + i*8, v); }
+        else { _mm256_storeu_ps(out + i*8, v); }
+    }
+    if constexpr (STREAM) { _mm_sfence(); }
+    pack_range_scalar(src, i, src.count, dst);
+}
+
+#endif
+
+using KernelFn = void(*)(const VertexStreams&, std::byte*);
+
+// picks the instantiation matching the present attributes and the destination alignment,
+// so none of the loops above branch on them per vertex
+template<bool NORMALS, bool TEXTURE_COORDS, template<bool, bool, bool> typename IMPL> KernelFn select_alignment(uintptr_t dst, uintptr_t alignment) {
+    if(dst % alignment == 0) { return &IMPL<NORMALS, TEXTURE_COORDS, true>::run; }
+    return &IMPL<NORMALS, TEXTURE_COORDS, false>::run;
+}
+
+template<template<bool, bool, bool> typename IMPL> void pack_dispatch(const VertexStreams &src, std::byte *dst, uintptr_t alignment) {
+    if(src.count == 0) { return; }
+    const auto d = reinterpret_cast<uintptr_t>(dst);
+    KernelFn fn{};
+    if(src.normals && src.texture_coords) { fn = select_alignment<true, true, IMPL>(d, alignment); }
+    else if(src.normals) { fn = select_alignment<true, false, IMPL>(d, alignment); }
+    else if(src.texture_coords) { fn = select_alignment<false, true, IMPL>(d, alignment); }
+    else { fn = select_alignment<false, false, IMPL>(d, alignment); }
+    fn(src, dst);
+}
+
+#ifdef ENG_CPU_X86
+template<bool N, bool T, bool S> struct SSEKernel { static void run(const VertexStreams &src, std::byte *dst) { pack_sse_impl<N, T, S>(src, dst); } };
+template<bool N, bool T, bool S> struct AVX2Kernel { static void run(const VertexStreams &src, std::byte *dst) { pack_avx2_impl<N, T, S>(src, dst); } };
+#endif
+
+}
+
+VertexStreams VertexPacker::streams(const Mesh &mesh) {
+    return VertexStreams{
+        .positions = mesh.vertex_positions.data(),
+        .normals = mesh.vertex_normals.empty() ? nullptr : mesh.vertex_normals.data(),
+        .texture_coords = mesh.vertex_texture_coords.empty() ? nullptr : mesh.vertex_texture_coords.data(),
+        .count = mesh.vertex_positions.size()
+    };
+}
+
+VertexBounds VertexPacker::compute_bounds(const VertexStreams &src) {
+    VertexBounds bounds;
+    if(src.count == 0) { return bounds; }
+    bounds.position_min = bounds.position_max = src.positions[0];
+    for(auto i=1u; i<src.count; ++i) {
+        bounds.position_min = glm::min(bounds.position_min, src.positions[i]);
+        bounds.position_max = glm::max(bounds.position_max, src.positions[i]);
+    }
+    if(src.texture_coords) {
+        bounds.uv_min = bounds.uv_max = src.texture_coords[0];
+        for(auto i=1u; i<src.count; ++i) {
+            bounds.uv_min = glm::min(bounds.uv_min, src.texture_coords[i]);
+            bounds.uv_max = glm::max(bounds.uv_max, src.texture_coords[i]);
+        }
+    }
+    return bounds;
+}
+
+void VertexPacker::pack(const VertexStreams &src, const VertexLayout &layout, const VertexBounds &bounds, std::byte *dst) {
+    if(layout == VertexLayout::full()) { pack(src, dst); }
+    else { pack_quantized(src, layout, bounds, dst); }
+}
+
+void VertexPacker::pack_quantized(const VertexStreams &src, const VertexLayout &layout, const VertexBounds &bounds, std::byte *dst) {
+    using enum VertexAttributeFormat;
+    const auto position_extent = bounds.position_max - bounds.position_min;
+    const auto uv_extent = bounds.uv_max - bounds.uv_min;
+    const auto &formats = layout.formats;
+    const auto &off = layout.offsets;
+    const auto used = off[VertexLayout::TextureCoords] + vertex_attribute_size(formats[VertexLayout::TextureCoords]);
+
+    for(auto i=0u; i<src.count; ++i) {
+        auto *out = dst + (size_t)i * layout.stride;
+
+        const auto p = src.positions[i];
+        if(formats[VertexLayout::Position] == Float3) { memcpy(out + off[VertexLayout::Position], &p, sizeof(p)); }
+        else if(formats[VertexLayout::Position] == Unorm16x4) {
+            const auto t = safe_div(p - bounds.position_min, position_extent);
+            const uint16_t q[4]{quantize_unorm16(t.x), quantize_unorm16(t.y), quantize_unorm16(t.z), 0};
+            memcpy(out + off[VertexLayout::Position], q, sizeof(q));
+        }
+
+        const auto n = src.normals ? src.normals[i] : glm::vec3{0.0f};
+        if(formats[VertexLayout::Normal] == Float3) { memcpy(out + off[VertexLayout::Normal], &n, sizeof(n)); }
+        else if(formats[VertexLayout::Normal] == Snorm8x2) { write_snorm2<int8_t>(octahedral_encode(n), out + off[VertexLayout::Normal]); }
+        else if(formats[VertexLayout::Normal] == Snorm16x2) { write_snorm2<int16_t>(octahedral_encode(n), out + off[VertexLayout::Normal]); }
+
+        const auto tc = src.texture_coords ? src.texture_coords[i] : glm::vec2{0.0f};
+        if(formats[VertexLayout::TextureCoords] == Float2) { memcpy(out + off[VertexLayout::TextureCoords], &tc, sizeof(tc)); }
+        else if(formats[VertexLayout::TextureCoords] == Half2) {
+            const auto h = glm::packHalf2x16(tc);
+            memcpy(out + off[VertexLayout::TextureCoords], &h, sizeof(h));
+        } else if(formats[VertexLayout::TextureCoords] == Unorm16x2) {
+            const auto t = safe_div(tc - bounds.uv_min, uv_extent);
+            const uint16_t q[2]{quantize_unorm16(t.x), quantize_unorm16(t.y)};
+            memcpy(out + off[VertexLayout::TextureCoords], q, sizeof(q));
+        }
+
+        if(used < layout.stride) { memset(out + used, 0, layout.stride - used); }
+    }
+}
+
+void VertexPacker::pack(const VertexStreams &src, std::byte *dst) {
+    pack(best_kernel(), src, dst);
+}
+
+void VertexPacker::pack(Kernel kernel, const VertexStreams &src, std::byte *dst) {
+    switch(kernel) {
+        case Kernel::AVX2: pack_avx2(src, dst); break;
+        case Kernel::SSE: pack_sse(src, dst); break;
+        default: pack_scalar(src, dst); break;
+    }
+}
+
+VertexPacker::Kernel VertexPacker::best_kernel() {
+#ifdef ENG_CPU_X86
+    static const auto kernel = cpu_has_avx2() ? Kernel::AVX2 : Kernel::SSE;
+    return kernel;
+#else
+    return Kernel::Scalar;
+#endif
+}
+
+void VertexPacker::pack_scalar(const VertexStreams &src, std::byte *dst) {
+    pack_range_scalar(src, 0, src.count, dst);
+}
+
+void VertexPacker::pack_sse(const VertexStreams &src, std::byte *dst) {
+#ifdef ENG_CPU_X86
+    pack_dispatch<SSEKernel>(src, dst, 16);
+#else
+    pack_scalar(src, dst);
+#endif
+}
+
+void VertexPacker::pack_avx2(const VertexStreams &src, std::byte *dst) {
+#ifdef ENG_CPU_X86
+    pack_dispatch<AVX2Kernel>(src, dst, 32);
+#else
+    pack_scalar(src, dst);
+#endif
+}
+
+}
\ No newline at end of file